@@ -0,0 +1,236 @@
+/*****************************************************
+ * Banc de mesure des pipelines d'ensishell          *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+/*
+ * Lance ensishell avec stdin et stdout sur des pipes, puis envoie des lignes
+ * "cat FICHIER | cat | ... | cat" de 1, 8 et 64 étapes. Pour chaque ligne on
+ * mesure :
+ *  - le temps entre l'envoi de la ligne (Entrée) et l'arrivée du premier
+ *    octet produit par le pipeline (marqueur ENSIBENCH contenu dans FICHIER) ;
+ *  - le temps total jusqu'à la fin du pipeline, détectée par la sortie d'une
+ *    commande témoin "printf 'FIN%dBENCH\n' 0" envoyée juste derrière (le
+ *    shell ne lit la ligne suivante qu'une fois le pipeline terminé).
+ * Le coût de la commande témoin seule est affiché en ligne "base".
+ *
+ * usage : bench_pipeline chemin/ensishell [iterations] [etapes...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#define MARQUEUR "ENSIBENCH"
+#define MARQUEUR_FIN "FIN0BENCH"
+#define DELAI_MS 10000
+
+static int shell_in = -1;   // On écrit les commandes ici
+static int shell_out = -1;  // On lit la sortie du shell ici
+
+static char tampon[1 << 16];
+static size_t tampon_len = 0;
+
+static double maintenant_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* Lit la sortie du shell jusqu'à trouver motif, qui est ensuite consommé
+   avec tout ce qui le précède. Renvoie -1 en cas de délai dépassé ou de fin. */
+static int attendre(const char *motif)
+{
+	size_t lm = strlen(motif);
+
+	while (1) {
+		tampon[tampon_len] = '\0';
+		char *trouve = strstr(tampon, motif);
+		if (trouve != NULL) {
+			size_t fin = trouve - tampon + lm;
+			memmove(tampon, tampon + fin, tampon_len - fin);
+			tampon_len -= fin;
+			return 0;
+		}
+		// Garder la fin du tampon au cas où le motif serait coupé en deux
+		if (tampon_len > sizeof(tampon) / 2) {
+			memmove(tampon, tampon + tampon_len - lm, lm);
+			tampon_len = lm;
+		}
+
+		struct pollfd pfd = { .fd = shell_out, .events = POLLIN };
+		if (poll(&pfd, 1, DELAI_MS) <= 0)
+			return -1;
+		ssize_t n = read(shell_out, tampon + tampon_len,
+				 sizeof(tampon) - 1 - tampon_len);
+		if (n <= 0)
+			return -1;
+		tampon_len += n;
+	}
+}
+
+static void envoyer(const char *ligne)
+{
+	size_t len = strlen(ligne);
+	while (len > 0) {
+		ssize_t n = write(shell_in, ligne, len);
+		if (n <= 0) {
+			perror("write");
+			exit(EXIT_FAILURE);
+		}
+		ligne += n;
+		len -= n;
+	}
+}
+
+static pid_t lancer_shell(const char *chemin)
+{
+	int in[2], out[2];
+	if (pipe(in) == -1 || pipe(out) == -1) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+	pid_t pid = fork();
+	if (pid == -1) {
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+	if (pid == 0) {
+		dup2(in[0], STDIN_FILENO);
+		dup2(out[1], STDOUT_FILENO);
+		close(in[0]); close(in[1]);
+		close(out[0]); close(out[1]);
+		execl(chemin, chemin, (char *) NULL);
+		perror("execl");
+		_exit(EXIT_FAILURE);
+	}
+	close(in[0]);
+	close(out[1]);
+	shell_in = in[1];
+	shell_out = out[0];
+	return pid;
+}
+
+static int comparer(const void *a, const void *b)
+{
+	double x = *(const double *) a, y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+static double mediane(double *v, int n)
+{
+	qsort(v, n, sizeof(double), comparer);
+	return (n % 2) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+/* Mesure un pipeline de 'etapes' cat (0 : commande témoin seule) */
+static int mesurer(const char *fichier, int etapes, int iterations, int afficher)
+{
+	size_t taille = strlen(fichier) + 16 + 6 * (size_t) etapes + 64;
+	char *ligne = malloc(taille);
+	double *premier = calloc(iterations, sizeof(double));
+	double *total = malloc(iterations * sizeof(double));
+	if (!ligne || !premier || !total) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+
+	ligne[0] = '\0';
+	if (etapes > 0) {
+		snprintf(ligne, taille, "cat %s", fichier);
+		for (int i = 1; i < etapes; i++)
+			strcat(ligne, " | cat");
+		strcat(ligne, "\n");
+	}
+	strcat(ligne, "printf 'FIN%dBENCH\\n' 0\n");
+
+	for (int it = 0; it < iterations; it++) {
+		double t0 = maintenant_us();
+		envoyer(ligne);
+		if (etapes > 0) {
+			if (attendre(MARQUEUR) == -1)
+				goto erreur;
+			premier[it] = maintenant_us() - t0;
+		}
+		if (attendre(MARQUEUR_FIN) == -1)
+			goto erreur;
+		total[it] = maintenant_us() - t0;
+	}
+
+	// Le premier essai est gardé à part : mediane() trie les mesures
+	double premier0 = premier[0], total0 = total[0];
+	if (afficher && etapes > 0)
+		printf("%6d %12.1f %12.1f %12.1f %12.1f\n", etapes,
+		       premier0, mediane(premier, iterations),
+		       total0, mediane(total, iterations));
+	else if (afficher)
+		printf("  base %12s %12s %12.1f %12.1f\n", "-", "-",
+		       total0, mediane(total, iterations));
+	fflush(stdout);
+	free(ligne);
+	free(premier);
+	free(total);
+	return 0;
+erreur:
+	fprintf(stderr, "bench: pas de réponse du shell pour %d étapes\n", etapes);
+	free(ligne);
+	free(premier);
+	free(total);
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage : %s chemin/ensishell [iterations] [etapes...]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	int iterations = (argc > 2) ? atoi(argv[2]) : 20;
+	if (iterations <= 0)
+		iterations = 20;
+
+	char fichier[] = "/tmp/ensibench.XXXXXX";
+	int fd = mkstemp(fichier);
+	if (fd == -1) {
+		perror("mkstemp");
+		return EXIT_FAILURE;
+	}
+	if (write(fd, MARQUEUR "\n", sizeof(MARQUEUR)) != sizeof(MARQUEUR)) {
+		perror("write");
+		unlink(fichier);
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	signal(SIGPIPE, SIG_IGN);
+	pid_t shell = lancer_shell(argv[1]);
+
+	// Première mesure à blanc pour attendre que le shell soit prêt
+	int ret = mesurer(fichier, 0, 1, 0);
+
+	printf("%6s %12s %12s %12s %12s   (us, %d iterations)\n", "etapes",
+	       "1er essai", "1er octet", "1er essai", "total", iterations);
+	if (ret == 0)
+		ret = mesurer(fichier, 0, iterations, 1);
+	if (argc > 3) {
+		for (int i = 3; i < argc && ret == 0; i++)
+			ret = mesurer(fichier, atoi(argv[i]), iterations, 1);
+	} else {
+		int etapes[] = { 1, 8, 64 };
+		for (size_t i = 0; i < sizeof(etapes) / sizeof(etapes[0]) && ret == 0; i++)
+			ret = mesurer(fichier, etapes[i], iterations, 1);
+	}
+
+	envoyer("exit\n");
+	close(shell_in);
+	waitpid(shell, NULL, 0);
+	unlink(fichier);
+	return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
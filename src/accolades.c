@@ -0,0 +1,466 @@
+/*****************************************************
+ * Ensishell : expansion des accolades               *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour memmem
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "accolades.h"
+
+// Un mot est analysé en une suite de parties : texte, groupe d'alternatives
+// (chacune est elle-même une suite) ou intervalle. Les textes désignent
+// directement les caractères du mot, rien n'est recopié.
+enum { TEXTE, GROUPE, NOMBRES, LETTRES };
+
+typedef struct Suite Suite;
+
+typedef struct {
+    int type;
+    const char *texte;      // TEXTE
+    size_t len;
+    Suite *alternatives;    // GROUPE
+    size_t nb_alt;
+    long long debut, pas;   // NOMBRES, LETTRES : valeur j = debut + j * pas
+    size_t n;
+    int largeur;            // Largeur minimale (zéros en tête), NOMBRES
+} Partie;
+
+struct Suite {
+    Partie *parties;
+    size_t nb, cap;
+    size_t nombre;          // Nombre de mots produits (saturé à SIZE_MAX)
+    size_t total;           // Caractères produits, sans les '\0' (saturé)
+    size_t max;             // Longueur du plus long mot produit
+};
+
+// Les bornes des intervalles numériques restent loin des débordements
+#define BORNE_MAX 100000000000000000LL
+
+
+// ================================================================================================
+// Arithmétique saturée : un dépassement donne SIZE_MAX, donc E2BIG
+
+static size_t sat_add(size_t a, size_t b) {
+    return (a > SIZE_MAX - b) ? SIZE_MAX : a + b;
+}
+
+static size_t sat_mul(size_t a, size_t b) {
+    return (a != 0 && b > SIZE_MAX / a) ? SIZE_MAX : a * b;
+}
+
+static long long div_bas(long long a, long long b) {
+    return a / b - ((a % b != 0) && (a < 0));
+}
+
+static long long div_haut(long long a, long long b) {
+    return a / b + ((a % b != 0) && (a > 0));
+}
+
+static int chiffres(long long v) {
+    int n = (v < 0) ? 2 : 1;
+    for (unsigned long long u = (v < 0) ? -(unsigned long long)v : (unsigned long long)v;
+         u >= 10; u /= 10) {
+        n++;
+    }
+    return n;
+}
+
+
+// ================================================================================================
+// Analyse
+
+static void liberer_suite(Suite *s) {
+    for (size_t i = 0; i < s->nb; i++) {
+        Partie *p = &s->parties[i];
+        if (p->type == GROUPE) {
+            for (size_t a = 0; a < p->nb_alt; a++) {
+                liberer_suite(&p->alternatives[a]);
+            }
+            free(p->alternatives);
+        }
+    }
+    free(s->parties);
+}
+
+static Partie *nouvelle_partie(Suite *s, int type) {
+    if (s->nb == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 4;
+        Partie *p = realloc(s->parties, cap * sizeof(Partie));
+        if (p == NULL) {
+            return NULL;
+        }
+        s->parties = p;
+        s->cap = cap;
+    }
+    Partie *p = &s->parties[s->nb++];
+    memset(p, 0, sizeof(*p));
+    p->type = type;
+    return p;
+}
+
+static int ajouter_texte(Suite *s, const char *texte, size_t len) {
+    if (len == 0) {
+        return 0;
+    }
+    Partie *p = nouvelle_partie(s, TEXTE);
+    if (p == NULL) {
+        return -1;
+    }
+    p->texte = texte;
+    p->len = len;
+    return 0;
+}
+
+// Entier de s[0..len[, au plus BORNE_MAX en valeur absolue
+static int lire_entier(const char *s, size_t len, long long *v) {
+    char tampon[24];
+    char *fin;
+    if (len == 0 || len >= sizeof(tampon)) {
+        return -1;
+    }
+    memcpy(tampon, s, len);
+    tampon[len] = '\0';
+    if (!isdigit((unsigned char)tampon[tampon[0] == '-' || tampon[0] == '+'])) {
+        return -1;
+    }
+    errno = 0;
+    *v = strtoll(tampon, &fin, 10);
+    if (*fin != '\0' || errno != 0 || *v > BORNE_MAX || *v < -BORNE_MAX) {
+        return -1;
+    }
+    return 0;
+}
+
+static int zero_en_tete(const char *s, size_t len) {
+    if (len > 0 && *s == '-') {
+        s++;
+        len--;
+    }
+    return len > 1 && s[0] == '0';
+}
+
+// "x..y" ou "x..y..pas", entiers ou lettres. Renvoie 0 si p est rempli,
+// -1 si ce n'est pas un intervalle.
+static int analyser_intervalle(Partie *p, const char *s, size_t len) {
+    const char *points = memmem(s, len, "..", 2);
+    if (points == NULL) {
+        return -1;
+    }
+    const char *x = s, *y = points + 2;
+    size_t lx = points - s;
+    size_t ly = s + len - y;
+    long long pas = 1;
+    const char *points2 = memmem(y, ly, "..", 2);
+    if (points2 != NULL) {
+        if (lire_entier(points2 + 2, s + len - points2 - 2, &pas) == -1) {
+            return -1;
+        }
+        ly = points2 - y;
+        pas = (pas < 0) ? -pas : (pas == 0 ? 1 : pas);
+    }
+
+    long long debut, fin;
+    if (lire_entier(x, lx, &debut) == 0 && lire_entier(y, ly, &fin) == 0) {
+        p->type = NOMBRES;
+        if (zero_en_tete(x, lx) || zero_en_tete(y, ly)) {
+            p->largeur = (int)(lx > ly ? lx : ly);
+        }
+    } else if (lx == 1 && ly == 1 && isalpha((unsigned char)*x) && isalpha((unsigned char)*y)) {
+        p->type = LETTRES;
+        debut = (unsigned char)*x;
+        fin = (unsigned char)*y;
+    } else {
+        return -1;
+    }
+    p->debut = debut;
+    p->pas = (fin >= debut) ? pas : -pas;
+    p->n = (size_t)(((fin >= debut) ? fin - debut : debut - fin) / pas) + 1;
+    return 0;
+}
+
+// Caractères produits par un intervalle numérique, sans parcourir ses
+// valeurs : on compte ses termes dans chaque tranche de même longueur
+static size_t total_nombres(const Partie *p, size_t *max) {
+    long long s = (p->pas < 0) ? -p->pas : p->pas;
+    long long dernier = p->debut + (long long)(p->n - 1) * p->pas;
+    long long m = (dernier < p->debut) ? dernier : p->debut;
+    size_t total = 0;
+
+    *max = p->largeur;
+    int lmax = chiffres(p->debut) > chiffres(dernier) ? chiffres(p->debut) : chiffres(dernier);
+    if ((size_t)lmax > *max) {
+        *max = lmax;
+    }
+
+    // Tranches [lo, hi] : 0, puis ±[10^(k-1), 10^k - 1]
+    long long bas = 1;
+    for (int k = 0; k <= 18; k++) {
+        for (int signe = (k == 0) ? 1 : -1; signe <= 1; signe += 2) {
+            long long lo, hi;
+            if (k == 0) {
+                lo = hi = 0;
+            } else if (signe > 0) {
+                lo = bas;
+                hi = bas * 10 - 1;
+            } else {
+                lo = -(bas * 10 - 1);
+                hi = -bas;
+            }
+            long long jlo = div_haut(lo - m, s), jhi = div_bas(hi - m, s);
+            if (jlo < 0) {
+                jlo = 0;
+            }
+            if (jhi > (long long)p->n - 1) {
+                jhi = (long long)p->n - 1;
+            }
+            if (jhi >= jlo) {
+                size_t l = chiffres(lo);
+                if (l < (size_t)p->largeur) {
+                    l = p->largeur;
+                }
+                total = sat_add(total, sat_mul((size_t)(jhi - jlo + 1), l));
+            }
+        }
+        if (k > 0) {
+            bas *= 10;
+        }
+    }
+    return total;
+}
+
+// Ajoute la partie p à la suite s et met à jour ses comptes :
+// nombre' = nombre * c, total' = total * c + t * nombre
+static void compter(Suite *s, size_t c, size_t t, size_t max) {
+    s->total = sat_add(sat_mul(s->total, c), sat_mul(t, s->nombre));
+    s->nombre = sat_mul(s->nombre, c);
+    s->max = sat_add(s->max, max);
+}
+
+static int analyser(Suite *s, const char *mot, size_t len);
+
+// Groupe d'alternatives séparées par les virgules de premier niveau de
+// mot[0..len[. Les alternatives ne sont confiées à p qu'une fois toutes
+// analysées : en cas d'échec, celles déjà construites sont libérées ici.
+static int analyser_groupe(Partie *p, const char *mot, size_t len) {
+    size_t nb = 1;
+    int prof = 0;
+    for (size_t i = 0; i < len; i++) {
+        prof += (mot[i] == '{') - (mot[i] == '}');
+        nb += (mot[i] == ',' && prof == 0);
+    }
+    Suite *alternatives = calloc(nb, sizeof(Suite));
+    if (alternatives == NULL) {
+        return -1;
+    }
+    size_t nb_alt = 0, debut = 0;
+    prof = 0;
+    for (size_t i = 0; i <= len; i++) {
+        if (i < len) {
+            prof += (mot[i] == '{') - (mot[i] == '}');
+        }
+        if (i == len || (mot[i] == ',' && prof == 0)) {
+            if (analyser(&alternatives[nb_alt++], mot + debut, i - debut) == -1) {
+                for (size_t a = 0; a < nb_alt; a++) {
+                    liberer_suite(&alternatives[a]);
+                }
+                free(alternatives);
+                return -1;
+            }
+            debut = i + 1;
+        }
+    }
+    p->alternatives = alternatives;
+    p->nb_alt = nb_alt;
+    return 0;
+}
+
+static int analyser(Suite *s, const char *mot, size_t len) {
+    size_t texte = 0;  // Début du texte en cours
+
+    s->nombre = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (mot[i] != '{') {
+            continue;
+        }
+        // Accolade fermante associée, et virgule de premier niveau
+        size_t j;
+        int prof = 0, virgule = 0;
+        for (j = i + 1; j < len; j++) {
+            if (mot[j] == '{') {
+                prof++;
+            } else if (mot[j] == '}' && prof-- == 0) {
+                break;
+            } else if (mot[j] == ',' && prof == 0) {
+                virgule = 1;
+            }
+        }
+        if (j == len) {
+            break;  // Pas d'accolade fermante : le reste est du texte
+        }
+
+        Partie partie = {0};
+        if (virgule) {
+            partie.type = GROUPE;
+        } else if (analyser_intervalle(&partie, mot + i + 1, j - i - 1) == -1) {
+            continue;  // "{...}" sans virgule ni intervalle : texte
+        }
+
+        if (ajouter_texte(s, mot + texte, i - texte) == -1) {
+            return -1;
+        }
+        compter(s, 1, i - texte, i - texte);
+        Partie *p = nouvelle_partie(s, partie.type);
+        if (p == NULL) {
+            return -1;
+        }
+        *p = partie;
+        if (p->type == GROUPE) {
+            if (analyser_groupe(p, mot + i + 1, j - i - 1) == -1) {
+                return -1;
+            }
+            size_t c = 0, t = 0, m = 0;
+            for (size_t a = 0; a < p->nb_alt; a++) {
+                c = sat_add(c, p->alternatives[a].nombre);
+                t = sat_add(t, p->alternatives[a].total);
+                if (p->alternatives[a].max > m) {
+                    m = p->alternatives[a].max;
+                }
+            }
+            compter(s, c, t, m);
+        } else if (p->type == NOMBRES) {
+            size_t m;
+            size_t t = total_nombres(p, &m);
+            compter(s, p->n, t, m);
+        } else {
+            compter(s, p->n, p->n, 1);
+        }
+        texte = j + 1;
+        i = j;
+    }
+    if (ajouter_texte(s, mot + texte, len - texte) == -1) {
+        return -1;
+    }
+    compter(s, 1, len - texte, len - texte);
+    return 0;
+}
+
+
+// ================================================================================================
+// Génération
+
+// Suite englobante à reprendre quand une alternative est terminée
+typedef struct Reprise {
+    const Suite *suite;
+    size_t i;
+    const struct Reprise *suivante;
+} Reprise;
+
+typedef struct {
+    char **mots;
+    size_t n;
+    char *sortie;           // Prochain caractère libre du bloc résultat
+    char *tampon;           // Mot en cours de construction
+} Generateur;
+
+static void generer(Generateur *g, const Suite *s, size_t i, const Reprise *r, size_t l) {
+    while (i == s->nb) {
+        if (r == NULL) {
+            memcpy(g->sortie, g->tampon, l);
+            g->sortie[l] = '\0';
+            g->mots[g->n++] = g->sortie;
+            g->sortie += l + 1;
+            return;
+        }
+        s = r->suite;
+        i = r->i;
+        r = r->suivante;
+    }
+
+    const Partie *p = &s->parties[i];
+    switch (p->type) {
+    case TEXTE:
+        memcpy(g->tampon + l, p->texte, p->len);
+        generer(g, s, i + 1, r, l + p->len);
+        break;
+    case GROUPE: {
+        Reprise suite = {s, i + 1, r};
+        for (size_t a = 0; a < p->nb_alt; a++) {
+            generer(g, &p->alternatives[a], 0, &suite, l);
+        }
+        break;
+    }
+    case NOMBRES:
+        for (size_t j = 0; j < p->n; j++) {
+            int lv = sprintf(g->tampon + l, "%0*lld", p->largeur, p->debut + (long long)j * p->pas);
+            generer(g, s, i + 1, r, l + lv);
+        }
+        break;
+    case LETTRES:
+        for (size_t j = 0; j < p->n; j++) {
+            g->tampon[l] = (char)(p->debut + (long long)j * p->pas);
+            generer(g, s, i + 1, r, l + 1);
+        }
+        break;
+    }
+}
+
+char **developper_accolades(char **mots) {
+    size_t nb = 0;
+    while (mots[nb] != NULL) {
+        nb++;
+    }
+    Suite *suites = calloc(nb ? nb : 1, sizeof(Suite));
+    if (suites == NULL) {
+        return NULL;
+    }
+
+    size_t nombre = 0, total = 0, max = 0;
+    int err = 0;
+    for (size_t i = 0; i < nb && err == 0; i++) {
+        err = analyser(&suites[i], mots[i], strlen(mots[i]));
+        nombre = sat_add(nombre, suites[i].nombre);
+        total = sat_add(total, suites[i].total);
+        if (suites[i].max > max) {
+            max = suites[i].max;
+        }
+    }
+
+    char **resultat = NULL;
+    char *tampon = NULL;
+    if (err == -1) {
+        errno = ENOMEM;
+    } else if (nombre > MAX_MOTS_ACCOLADES || total == SIZE_MAX) {
+        errno = E2BIG;
+    } else {
+        size_t taille = sat_add(sat_mul(nombre + 1, sizeof(char *)), sat_add(total, nombre));
+        resultat = (taille == SIZE_MAX) ? NULL : malloc(taille);
+        tampon = malloc(max + 1);
+        if (resultat == NULL || tampon == NULL) {
+            free(resultat);
+            resultat = NULL;
+            errno = ENOMEM;
+        }
+    }
+
+    if (resultat != NULL) {
+        Generateur g = {resultat, 0, (char *)(resultat + nombre + 1), tampon};
+        for (size_t i = 0; i < nb; i++) {
+            generer(&g, &suites[i], 0, NULL, 0);
+        }
+        resultat[g.n] = NULL;
+    }
+    free(tampon);
+    for (size_t i = 0; i < nb; i++) {
+        liberer_suite(&suites[i]);
+    }
+    free(suites);
+    return resultat;
+}
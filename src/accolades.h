@@ -0,0 +1,24 @@
+/*****************************************************
+ * Ensishell : expansion des accolades               *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __ACCOLADES_H
+#define __ACCOLADES_H
+
+/* Développe les accolades de tous les mots (tableau terminé par NULL),
+   comme bash : alternatives "{a,b}" imbriquées ou non, plusieurs groupes
+   par mot (produit cartésien, le premier groupe variant le moins vite),
+   intervalles "{1..10}", "{01..10..3}", "{z..a}". Une accolade qui ne forme
+   pas un groupe valide reste telle quelle.
+   Le nombre de mots et leur taille totale sont calculés avant toute
+   écriture : le résultat est alloué d'un seul bloc (pointeurs puis
+   caractères, à libérer avec liberer_mots) et rempli directement.
+   Renvoie NULL si la mémoire manque (errno ENOMEM) ou si l'expansion
+   dépasse MAX_MOTS_ACCOLADES mots (errno E2BIG). */
+char **developper_accolades(char **mots);
+
+#define MAX_MOTS_ACCOLADES (1UL << 26)
+
+#endif
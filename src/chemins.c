@@ -0,0 +1,301 @@
+/*****************************************************
+ * Ensishell : cache des chemins des commandes       *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "chemins.h"
+
+// PATH par défaut d'execvp (confstr(_CS_PATH) de la glibc)
+#define PATH_DEFAUT "/bin:/usr/bin"
+
+// Un répertoire du PATH, avec sa date de modification lors du dernier examen
+typedef struct {
+    char *chemin;
+    int connu;              // Déjà examiné depuis le découpage du PATH
+    int existe;
+    struct timespec mtime;
+    unsigned epoque;        // Époque du dernier examen
+} Repertoire;
+
+// Une commande trouvée : nom NULL pour une case vide
+typedef struct {
+    char *nom;
+    char *chemin;
+    int rep;                // Indice du répertoire où elle a été trouvée
+    unsigned succes;        // Nombre d'utilisations
+} Commande;
+
+static char *path_courant = NULL;
+static Repertoire *reps = NULL;
+static int nb_reps = 0;
+static unsigned epoque = 0;
+
+// Adressage ouvert à sondage linéaire, taille en puissance de 2. On ne
+// retire jamais une entrée seule : la table est vidée en entier.
+static Commande *table = NULL;
+static size_t taille_table = 0;
+static size_t occupes = 0;
+
+
+// ================================================================================================
+// Table des commandes
+
+static size_t hacher(const char *nom) {
+    uint32_t h = 2166136261u;  // FNV-1a
+    for (; *nom; nom++) {
+        h = (h ^ (unsigned char)*nom) * 16777619u;
+    }
+    return h & (taille_table - 1);
+}
+
+static Commande *trouver(const char *nom) {
+    if (occupes == 0) {
+        return NULL;
+    }
+    size_t i = hacher(nom);
+    while (table[i].nom != NULL) {
+        if (strcmp(table[i].nom, nom) == 0) {
+            return &table[i];
+        }
+        i = (i + 1) & (taille_table - 1);
+    }
+    return NULL;
+}
+
+static int agrandir(void) {
+    size_t ancienne_taille = taille_table;
+    Commande *ancienne = table;
+    size_t nouvelle_taille = ancienne_taille ? ancienne_taille * 2 : 64;
+
+    Commande *nouvelle = calloc(nouvelle_taille, sizeof(Commande));
+    if (nouvelle == NULL) {
+        return -1;
+    }
+    table = nouvelle;
+    taille_table = nouvelle_taille;
+    for (size_t i = 0; i < ancienne_taille; i++) {
+        if (ancienne[i].nom != NULL) {
+            size_t j = hacher(ancienne[i].nom);
+            while (table[j].nom != NULL) {
+                j = (j + 1) & (taille_table - 1);
+            }
+            table[j] = ancienne[i];
+        }
+    }
+    free(ancienne);
+    return 0;
+}
+
+static Commande *inserer(const char *nom, char *chemin, int rep) {
+    if ((occupes + 1) * 2 > taille_table && agrandir() == -1) {
+        return NULL;
+    }
+    char *copie = strdup(nom);
+    if (copie == NULL) {
+        return NULL;
+    }
+    size_t i = hacher(nom);
+    while (table[i].nom != NULL) {
+        i = (i + 1) & (taille_table - 1);
+    }
+    table[i].nom = copie;
+    table[i].chemin = chemin;
+    table[i].rep = rep;
+    table[i].succes = 0;
+    occupes++;
+    return &table[i];
+}
+
+void vider_chemins(void) {
+    for (size_t i = 0; i < taille_table && occupes > 0; i++) {
+        if (table[i].nom != NULL) {
+            free(table[i].nom);
+            free(table[i].chemin);
+            table[i].nom = NULL;
+            occupes--;
+        }
+    }
+}
+
+
+// ================================================================================================
+// Répertoires du PATH
+
+static void decouper_path(const char *path) {
+    for (int d = 0; d < nb_reps; d++) {
+        free(reps[d].chemin);
+    }
+    free(reps);
+    free(path_courant);
+    reps = NULL;
+    nb_reps = 0;
+    path_courant = strdup(path);
+    if (path_courant == NULL) {
+        return;
+    }
+
+    int n = 1;
+    for (const char *p = path; *p; p++) {
+        n += (*p == ':');
+    }
+    reps = calloc(n, sizeof(Repertoire));
+    if (reps == NULL) {
+        return;
+    }
+    const char *debut = path;
+    while (1) {
+        size_t len = strcspn(debut, ":");
+        // Un élément vide désigne le répertoire courant
+        reps[nb_reps].chemin = len ? strndup(debut, len) : strdup(".");
+        if (reps[nb_reps].chemin == NULL) {
+            break;
+        }
+        nb_reps++;
+        if (debut[len] == '\0') {
+            break;
+        }
+        debut += len + 1;
+    }
+}
+
+void revalider_chemins(void) {
+    const char *path = getenv("PATH");
+    if (path == NULL) {
+        path = PATH_DEFAUT;
+    }
+    if (path_courant == NULL || strcmp(path, path_courant) != 0) {
+        vider_chemins();
+        decouper_path(path);
+    }
+    epoque++;
+}
+
+// Examine le répertoire d (au plus une fois par époque). Renvoie 1 si son
+// contenu a pu changer depuis l'examen précédent.
+static int rep_modifie(int d) {
+    Repertoire *r = &reps[d];
+    if (r->connu && r->epoque == epoque) {
+        return 0;
+    }
+    struct stat st;
+    int existe = (stat(r->chemin, &st) == 0);
+    struct timespec mtime = existe ? st.st_mtim : (struct timespec){0, 0};
+    int modifie = r->connu && (existe != r->existe
+                               || mtime.tv_sec != r->mtime.tv_sec
+                               || mtime.tv_nsec != r->mtime.tv_nsec);
+    r->connu = 1;
+    r->existe = existe;
+    r->mtime = mtime;
+    r->epoque = epoque;
+    return modifie;
+}
+
+
+// ================================================================================================
+// Recherche
+
+const char *chercher_commande(const char *nom) {
+    if (nom == NULL || nom[0] == '\0' || strchr(nom, '/') != NULL) {
+        return NULL;
+    }
+    if (path_courant == NULL) {
+        revalider_chemins();
+    }
+
+    Commande *c = trouver(nom);
+    if (c != NULL) {
+        for (int d = 0; d <= c->rep; d++) {
+            if (rep_modifie(d)) {
+                vider_chemins();
+                c = NULL;
+                break;
+            }
+        }
+        if (c != NULL) {
+            c->succes++;
+            return c->chemin;
+        }
+    }
+
+    size_t lnom = strlen(nom);
+    for (int d = 0; d < nb_reps; d++) {
+        if (rep_modifie(d)) {
+            vider_chemins();
+        }
+        if (reps[d].chemin[0] != '/') {
+            // Le résultat dépendrait du répertoire courant
+            return NULL;
+        }
+        if (!reps[d].existe) {
+            continue;
+        }
+        size_t lrep = strlen(reps[d].chemin);
+        char *chemin = malloc(lrep + lnom + 2);
+        if (chemin == NULL) {
+            return NULL;
+        }
+        memcpy(chemin, reps[d].chemin, lrep);
+        chemin[lrep] = '/';
+        memcpy(chemin + lrep + 1, nom, lnom + 1);
+
+        struct stat st;
+        if (stat(chemin, &st) == 0 && S_ISREG(st.st_mode) && access(chemin, X_OK) == 0) {
+            c = inserer(nom, chemin, d);
+            if (c == NULL) {
+                free(chemin);
+                return NULL;
+            }
+            c->succes++;
+            return c->chemin;
+        }
+        free(chemin);
+    }
+    return NULL;
+}
+
+
+// ================================================================================================
+// Commande interne
+
+int commande_hash(char **cmd) {
+    revalider_chemins();
+
+    if (cmd[1] == NULL) {
+        if (occupes == 0) {
+            printf("hash : table vide\n");
+            return 0;
+        }
+        printf("succès\tcommande\n");
+        for (size_t i = 0; i < taille_table; i++) {
+            if (table[i].nom != NULL) {
+                printf("%6u\t%s\n", table[i].succes, table[i].chemin);
+            }
+        }
+        return 0;
+    }
+
+    if (strcmp(cmd[1], "-r") == 0 && cmd[2] == NULL) {
+        vider_chemins();
+        return 0;
+    }
+
+    int retour = 0;
+    for (int i = 1; cmd[i] != NULL; i++) {
+        Commande *c;
+        if (chercher_commande(cmd[i]) == NULL) {
+            fprintf(stderr, "hash : %s : introuvable\n", cmd[i]);
+            retour = 1;
+        } else if ((c = trouver(cmd[i])) != NULL) {
+            c->succes--;  // Retenir n'est pas utiliser
+        }
+    }
+    return retour;
+}
@@ -0,0 +1,31 @@
+/*****************************************************
+ * Ensishell : cache des chemins des commandes       *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __CHEMINS_H
+#define __CHEMINS_H
+
+/* Début d'une ligne de commande : relit PATH (la table est vidée s'il a
+   changé) et ouvre une nouvelle époque, pendant laquelle chaque répertoire
+   du PATH est examiné au plus une fois. */
+void revalider_chemins(void);
+
+/* Chemin de l'exécutable nom, cherché dans le PATH comme le ferait execvp,
+   puis gardé en table. Une entrée est abandonnée si l'un des répertoires
+   qui la précèdent dans le PATH (ou le sien) a changé de date de
+   modification. Renvoie NULL si nom contient un '/', s'il est introuvable
+   ou si le PATH contient un répertoire relatif avant lui : l'appelant s'en
+   remet alors à execvp. La chaîne reste valide jusqu'au prochain appel. */
+const char *chercher_commande(const char *nom);
+
+/* Vide la table */
+void vider_chemins(void);
+
+/* Commande interne "hash" : sans argument, affiche la table ; "hash -r" la
+   vide ; "hash noms..." cherche et retient les commandes.
+   Renvoie le code de retour de la commande. */
+int commande_hash(char **cmd);
+
+#endif
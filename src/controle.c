@@ -0,0 +1,796 @@
+/*****************************************************
+ * Ensishell : structures de contrôle et variables   *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour strndup
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "controle.h"
+#include "jokers.h"
+#include "variables.h"
+
+// Programmes gardés, par empreinte de leur texte
+#define TAILLE_CACHE 32
+
+// Code de retour d'une commande interrompue par Ctrl-C
+#define STATUT_INTERRUPTION (128 + SIGINT)
+
+int dernier_statut = 0;
+
+
+// ================================================================================================
+// Lecture du texte
+// Le texte est découpé en éléments : séparateurs (';', fin de ligne), '&&',
+// '||', mots-clés en position de commande, et commandes. Une commande va
+// jusqu'au prochain séparateur hors guillemets ; elle garde son '&' final,
+// que parsecmd lira. Un '#' en début de mot commente la fin de la ligne.
+
+typedef enum { E_FIN, E_SEPARATEUR, E_ET, E_OU, E_COMMANDE, E_MOT_CLE } TypeElement;
+
+enum {
+    MC_IF, MC_THEN, MC_ELIF, MC_ELSE, MC_FI, MC_WHILE, MC_UNTIL, MC_DO, MC_DONE, MC_FOR,
+    MC_BREAK, MC_CONTINUE
+};
+static const char *const mots_cles[] = {
+    "if", "then", "elif", "else", "fi", "while", "until", "do", "done", "for",
+    "break", "continue", NULL
+};
+#define BIT(mc) (1u << (mc))
+
+typedef struct {
+    TypeElement type;
+    int mot_cle;            // E_MOT_CLE : indice dans mots_cles
+    const char *debut;      // Texte de l'élément
+    size_t lg;
+} Element;
+
+// Après la partie protégée qui commence en p ('...', "..." ou \c)
+static const char *sauter_protection(const char *p) {
+    if (*p == '\'') {
+        const char *f = strchr(p + 1, '\'');
+        return f ? f + 1 : p + strlen(p);
+    }
+    if (*p == '"') {
+        for (p++; *p != '\0' && *p != '"'; p++) {
+            if (*p == '\\' && p[1] != '\0') {
+                p++;
+            }
+        }
+        return *p ? p + 1 : p;
+    }
+    return p[1] ? p + 2 : p + 1;
+}
+
+// Fin de la commande qui commence en c
+static const char *fin_commande(const char *c) {
+    const char *f = c;
+    int debut_mot = 1;
+    while (*f != '\0' && *f != '\n' && *f != ';' && !(*f == '#' && debut_mot)) {
+        if (*f == '&' && f[1] == '&') {
+            break;
+        }
+        if (*f == '&' && f[1] != '>' && (f == c || f[-1] != '>')) {
+            return f + 1;   // Arrière-plan (pas &>, ni 2>&1)
+        }
+        if (*f == '|' && f[1] == '|') {
+            break;
+        }
+        if (*f == '\'' || *f == '"' || *f == '\\') {
+            f = sauter_protection(f);
+            debut_mot = 0;
+            continue;
+        }
+        debut_mot = strchr(" \t|<>", *f) != NULL;
+        f++;
+    }
+    return f;
+}
+
+// Lit l'élément qui commence en *p, en position de commande, et avance *p
+static void lire_element(const char **p, Element *e) {
+    const char *c = *p;
+    while (1) {
+        c += strspn(c, " \t\r");
+        if (*c != '#') {
+            break;
+        }
+        c += strcspn(c, "\n");
+    }
+    e->debut = c;
+    e->lg = 1;
+    if (*c == '\0') {
+        e->type = E_FIN;
+        e->lg = 0;
+    } else if (*c == '\n' || *c == ';') {
+        e->type = E_SEPARATEUR;
+    } else if ((c[0] == '&' && c[1] == '&') || (c[0] == '|' && c[1] == '|')) {
+        e->type = c[0] == '&' ? E_ET : E_OU;
+        e->lg = 2;
+    } else {
+        size_t lg = strcspn(c, " \t\r\n;&|<>");
+        e->type = E_COMMANDE;
+        for (int k = 0; mots_cles[k] != NULL; k++) {
+            if (strlen(mots_cles[k]) == lg && strncmp(c, mots_cles[k], lg) == 0) {
+                e->type = E_MOT_CLE;
+                e->mot_cle = k;
+                e->lg = lg;
+                break;
+            }
+        }
+        if (e->type == E_COMMANDE) {
+            e->lg = fin_commande(c) - c;
+        }
+    }
+    *p = c + e->lg;
+}
+
+
+// ================================================================================================
+// Compilation
+// Un programme est une suite d'instructions sur un code de retour courant :
+//   a && b   devient   a ; SAUT_SI_ECHEC L ; b ; L:
+//   while c; do b; done   devient
+//     STATUT_NUL ; GARDER r ; D: c ; SAUT_SI_ECHEC F ; b ; GARDER r ; SAUT D ; F: RENDRE r
+// (le registre r garde le code du dernier corps exécuté, celui de la boucle)
+//   for x in m; do b; done   devient
+//     STATUT_NUL ; POUR m i ; S: SUIVANT i F ; b ; SAUT S ; F:
+
+typedef enum {
+    OP_EXECUTER,        // a : pipeline
+    OP_SAUT,            // a : cible
+    OP_SAUT_SI_ECHEC,
+    OP_SAUT_SI_SUCCES,
+    OP_STATUT_NUL,
+    OP_GARDER,          // a : registre <- code courant
+    OP_RENDRE,          // code courant <- registre a
+    OP_POUR,            // a : ligne "nom in mots...", b : itération (liste développée)
+    OP_SUIVANT,         // a : itération, b : cible quand la liste est épuisée
+} Operation;
+
+typedef struct {
+    Operation op;
+    int a;
+    int b;
+} Instruction;
+
+struct Programme {
+    Instruction *code;
+    int nb_code, cap_code;
+    struct cmdline **lignes;    // Pipelines analysés (copycmd)
+    int nb_lignes, cap_lignes;
+    int nb_registres;
+    int nb_iterations;
+    uint64_t empreinte;
+    char *texte;
+};
+
+// Boucle en cours de compilation, pour break et continue
+typedef struct Boucle {
+    struct Boucle *englobante;
+    int reprise;            // Cible de continue
+    int registre;           // while, until : registre du code ; for : -1
+    int sorties;            // Chaîne des sauts de break, liés par leur champ a
+} Boucle;
+
+enum { COMPILE, INCOMPLET, ERREUR };
+
+typedef struct {
+    const char *p;
+    Element courant;
+    Programme *prog;
+    int verifier;           // Structure seulement : pipelines non analysés, pas de message
+    int etat;
+    int arriere_plan;       // La dernière commande finit par '&'
+    Boucle *boucle;
+} Compilation;
+
+static void liberer_programme(Programme *p) {
+    if (p == NULL) {
+        return;
+    }
+    for (int i = 0; i < p->nb_lignes; i++) {
+        free(p->lignes[i]);
+    }
+    free(p->lignes);
+    free(p->code);
+    free(p->texte);
+    free(p);
+}
+
+static void avancer(Compilation *c) {
+    lire_element(&c->p, &c->courant);
+}
+
+static int erreur_syntaxe(Compilation *c) {
+    const Element *e = &c->courant;
+    if (!c->verifier && c->etat == COMPILE) {
+        if (e->type == E_FIN) {
+            fprintf(stderr, "syntaxe : fin du texte inattendue\n");
+        } else if (e->type == E_SEPARATEUR && e->debut[0] == '\n') {
+            fprintf(stderr, "syntaxe : fin de ligne inattendue\n");
+        } else {
+            int lg = (int)strcspn(e->debut, " \t\n");
+            fprintf(stderr, "syntaxe : « %.*s » inattendu\n", lg < 32 ? lg : 32, e->debut);
+        }
+    }
+    if (c->etat == COMPILE) {
+        c->etat = ERREUR;
+    }
+    return -1;
+}
+
+// Fin du texte au milieu d'une structure
+static int incomplet(Compilation *c) {
+    erreur_syntaxe(c);
+    c->etat = INCOMPLET;
+    return -1;
+}
+
+static int emettre(Compilation *c, Operation op, int a, int b) {
+    Programme *p = c->prog;
+    if (p->nb_code == p->cap_code) {
+        int cap = p->cap_code ? 2 * p->cap_code : 32;
+        Instruction *code = realloc(p->code, cap * sizeof(Instruction));
+        if (code == NULL) {
+            perror("compilation");
+            exit(EXIT_FAILURE);
+        }
+        p->code = code;
+        p->cap_code = cap;
+    }
+    p->code[p->nb_code] = (Instruction){op, a, b};
+    return p->nb_code++;
+}
+
+// Donne la cible à tous les sauts de la chaîne qui commence en j
+static void lier(Compilation *c, int j, int cible) {
+    while (j != -1) {
+        int suivant = c->prog->code[j].a;
+        c->prog->code[j].a = cible;
+        j = suivant;
+    }
+}
+
+// Analyse la commande courante et la range dans le programme. Renvoie son
+// indice, -1 après un message si elle est erronée (ou en vérification).
+static int ranger_ligne(Compilation *c) {
+    if (c->verifier) {
+        return -1;
+    }
+    char *tampon = strndup(c->courant.debut, c->courant.lg);
+    if (tampon == NULL) {
+        perror("compilation");
+        exit(EXIT_FAILURE);
+    }
+    struct cmdline *l = parsecmd_line(tampon);
+    if (l->err) {
+        printf("error: %s\n", l->err);
+        free(tampon);
+        c->etat = ERREUR;
+        return -1;
+    }
+    struct cmdline *copie = copycmd(l);
+    free(tampon);
+    Programme *p = c->prog;
+    if (copie != NULL && p->nb_lignes == p->cap_lignes) {
+        int cap = p->cap_lignes ? 2 * p->cap_lignes : 16;
+        struct cmdline **lignes = realloc(p->lignes, cap * sizeof(struct cmdline *));
+        if (lignes == NULL) {
+            free(copie);
+            copie = NULL;
+        } else {
+            p->lignes = lignes;
+            p->cap_lignes = cap;
+        }
+    }
+    if (copie == NULL) {
+        perror("compilation");
+        exit(EXIT_FAILURE);
+    }
+    p->lignes[p->nb_lignes] = copie;
+    return p->nb_lignes++;
+}
+
+static int compiler_liste(Compilation *c, unsigned fins);
+
+// if liste; then liste; [elif liste; then liste;]... [else liste;] fi
+static int compiler_if(Compilation *c) {
+    int vers_fi = -1;
+    do {
+        avancer(c);
+        if (compiler_liste(c, BIT(MC_THEN)) == -1) {
+            return -1;
+        }
+        avancer(c);
+        int sinon = emettre(c, OP_SAUT_SI_ECHEC, -1, 0);
+        if (compiler_liste(c, BIT(MC_ELIF) | BIT(MC_ELSE) | BIT(MC_FI)) == -1) {
+            return -1;
+        }
+        vers_fi = emettre(c, OP_SAUT, vers_fi, 0);
+        c->prog->code[sinon].a = c->prog->nb_code;
+    } while (c->courant.mot_cle == MC_ELIF);
+
+    if (c->courant.mot_cle == MC_ELSE) {
+        avancer(c);
+        if (compiler_liste(c, BIT(MC_FI)) == -1) {
+            return -1;
+        }
+    } else {
+        emettre(c, OP_STATUT_NUL, 0, 0);    // Aucune branche : code 0
+    }
+    lier(c, vers_fi, c->prog->nb_code);
+    return 0;
+}
+
+// while|until liste; do liste; done
+static int compiler_while(Compilation *c) {
+    Operation sortie = c->courant.mot_cle == MC_WHILE ? OP_SAUT_SI_ECHEC : OP_SAUT_SI_SUCCES;
+    int r = c->prog->nb_registres++;
+    emettre(c, OP_STATUT_NUL, 0, 0);
+    emettre(c, OP_GARDER, r, 0);
+    Boucle b = {c->boucle, c->prog->nb_code, r, -1};
+
+    avancer(c);
+    if (compiler_liste(c, BIT(MC_DO)) == -1) {
+        return -1;
+    }
+    avancer(c);
+    int fin = emettre(c, sortie, -1, 0);
+    c->boucle = &b;
+    int ret = compiler_liste(c, BIT(MC_DONE));
+    c->boucle = b.englobante;
+    if (ret == -1) {
+        return -1;
+    }
+    emettre(c, OP_GARDER, r, 0);
+    emettre(c, OP_SAUT, b.reprise, 0);
+    c->prog->code[fin].a = c->prog->nb_code;
+    emettre(c, OP_RENDRE, r, 0);
+    lier(c, b.sorties, c->prog->nb_code);
+    return 0;
+}
+
+// for nom in mots...; do liste; done
+static int compiler_for(Compilation *c) {
+    avancer(c);
+    if (c->courant.type == E_FIN) {
+        return incomplet(c);
+    }
+    if (c->courant.type != E_COMMANDE) {
+        return erreur_syntaxe(c);
+    }
+    int ligne = ranger_ligne(c);
+    if (ligne != -1) {
+        const struct cmdline *l = c->prog->lignes[ligne];
+        char **mots = l->seq[0];
+        int nom_valide = isalpha((unsigned char)mots[0][0]) || mots[0][0] == '_';
+        for (const char *k = mots[0]; *k && nom_valide; k++) {
+            nom_valide = isalnum((unsigned char)*k) || *k == '_';
+        }
+        if (!nom_valide || mots[1] == NULL || strcmp(mots[1], "in") != 0
+            || l->seq[1] != NULL || l->in || l->out || l->errout || l->errdup || l->bg) {
+            fprintf(stderr, "for : « nom in mots... » attendu\n");
+            c->etat = ERREUR;
+            return -1;
+        }
+    } else if (!c->verifier) {
+        return -1;
+    }
+    avancer(c);
+    while (c->courant.type == E_SEPARATEUR) {
+        avancer(c);
+    }
+    if (c->courant.type == E_FIN) {
+        return incomplet(c);
+    }
+    if (c->courant.type != E_MOT_CLE || c->courant.mot_cle != MC_DO) {
+        return erreur_syntaxe(c);
+    }
+    avancer(c);
+
+    int i = c->prog->nb_iterations++;
+    emettre(c, OP_STATUT_NUL, 0, 0);
+    emettre(c, OP_POUR, ligne, i);
+    int suivant = emettre(c, OP_SUIVANT, i, -1);
+    Boucle b = {c->boucle, suivant, -1, -1};
+    c->boucle = &b;
+    int ret = compiler_liste(c, BIT(MC_DONE));
+    c->boucle = b.englobante;
+    if (ret == -1) {
+        return -1;
+    }
+    emettre(c, OP_SAUT, suivant, 0);
+    c->prog->code[suivant].b = c->prog->nb_code;
+    lier(c, b.sorties, c->prog->nb_code);
+    return 0;
+}
+
+// break, continue : code 0, puis sortie ou reprise de la boucle englobante
+static int compiler_rupture(Compilation *c) {
+    Boucle *b = c->boucle;
+    if (b == NULL) {
+        if (!c->verifier) {
+            fprintf(stderr, "%s : en dehors d'une boucle\n", mots_cles[c->courant.mot_cle]);
+        }
+        c->etat = ERREUR;
+        return -1;
+    }
+    emettre(c, OP_STATUT_NUL, 0, 0);
+    if (c->courant.mot_cle == MC_BREAK) {
+        b->sorties = emettre(c, OP_SAUT, b->sorties, 0);
+    } else {
+        if (b->registre != -1) {
+            emettre(c, OP_GARDER, b->registre, 0);
+        }
+        emettre(c, OP_SAUT, b->reprise, 0);
+    }
+    avancer(c);
+    return 0;
+}
+
+// Pipeline ou structure
+static int compiler_commande(Compilation *c) {
+    int ret;
+    c->arriere_plan = 0;
+    switch (c->courant.type) {
+    case E_COMMANDE:
+        ret = ranger_ligne(c);
+        if (ret == -1 && !c->verifier) {
+            return -1;
+        }
+        c->arriere_plan = c->courant.debut[c->courant.lg - 1] == '&';
+        emettre(c, OP_EXECUTER, ret, 0);
+        avancer(c);
+        return 0;
+    case E_FIN:
+        return incomplet(c);
+    case E_MOT_CLE:
+        break;
+    default:
+        return erreur_syntaxe(c);
+    }
+
+    switch (c->courant.mot_cle) {
+    case MC_IF:
+        ret = compiler_if(c);
+        break;
+    case MC_WHILE:
+    case MC_UNTIL:
+        ret = compiler_while(c);
+        break;
+    case MC_FOR:
+        ret = compiler_for(c);
+        break;
+    case MC_BREAK:
+    case MC_CONTINUE:
+        return compiler_rupture(c);
+    default:
+        return erreur_syntaxe(c);
+    }
+    if (ret == 0) {
+        avancer(c);     // fi, done
+    }
+    return ret;
+}
+
+// commande [&& commande | || commande]...
+static int compiler_et_ou(Compilation *c) {
+    if (compiler_commande(c) == -1) {
+        return -1;
+    }
+    while (c->courant.type == E_ET || c->courant.type == E_OU) {
+        if (c->arriere_plan) {
+            return erreur_syntaxe(c);
+        }
+        Operation op = c->courant.type == E_ET ? OP_SAUT_SI_ECHEC : OP_SAUT_SI_SUCCES;
+        int saut = emettre(c, op, -1, 0);
+        avancer(c);
+        // La commande suivante peut être sur la ligne suivante
+        while (c->courant.type == E_SEPARATEUR && c->courant.debut[0] == '\n') {
+            avancer(c);
+        }
+        if (compiler_commande(c) == -1) {
+            return -1;
+        }
+        c->prog->code[saut].a = c->prog->nb_code;
+    }
+    return 0;
+}
+
+// Commandes séparées par ';', des fins de ligne ou '&', jusqu'à un des
+// mots-clés de fins (au moins une commande avant), ou la fin du texte si fins
+// est vide
+static int compiler_liste(Compilation *c, unsigned fins) {
+    int commandes = 0;
+    while (1) {
+        while (c->courant.type == E_SEPARATEUR) {
+            avancer(c);
+        }
+        if (c->courant.type == E_FIN) {
+            return fins ? incomplet(c) : 0;
+        }
+        if (c->courant.type == E_MOT_CLE && (fins & BIT(c->courant.mot_cle))) {
+            return commandes > 0 ? 0 : erreur_syntaxe(c);
+        }
+        if (compiler_et_ou(c) == -1) {
+            return -1;
+        }
+        commandes++;
+        // Après une commande en arrière-plan, la suivante peut suivre directement
+        if (c->courant.type != E_SEPARATEUR && c->courant.type != E_FIN && !c->arriere_plan) {
+            return erreur_syntaxe(c);
+        }
+    }
+}
+
+// Compile texte. Renvoie le programme, NULL avec *etat INCOMPLET ou ERREUR.
+static Programme *compiler(const char *texte, int verifier, int *etat) {
+    Compilation c = {.p = texte, .verifier = verifier, .etat = COMPILE};
+    c.prog = calloc(1, sizeof(Programme));
+    if (c.prog == NULL) {
+        perror("compilation");
+        exit(EXIT_FAILURE);
+    }
+    avancer(&c);
+    compiler_liste(&c, 0);
+    *etat = c.etat;
+    if (c.etat != COMPILE) {
+        liberer_programme(c.prog);
+        return NULL;
+    }
+    return c.prog;
+}
+
+int besoin_controle(const char *texte) {
+    Element e;
+    int commandes = 0;
+    for (lire_element(&texte, &e); e.type != E_FIN; lire_element(&texte, &e)) {
+        if (e.type == E_MOT_CLE || e.type == E_ET || e.type == E_OU
+            || (e.type == E_COMMANDE && ++commandes > 1)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int texte_incomplet(const char *texte) {
+    int etat;
+    liberer_programme(compiler(texte, 1, &etat));
+    return etat == INCOMPLET;
+}
+
+
+// ================================================================================================
+// Cache des programmes
+
+static Programme *cache[TAILLE_CACHE];
+
+static uint64_t empreinte_texte(const char *texte) {
+    uint64_t h = 0xcbf29ce484222325ULL;     // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)texte; *c; c++) {
+        h = (h ^ *c) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+const Programme *compiler_programme(const char *texte) {
+    uint64_t h = empreinte_texte(texte);
+    Programme **place = &cache[h % TAILLE_CACHE];
+    if (*place != NULL && (*place)->empreinte == h && (*place)->texte != NULL
+        && strcmp((*place)->texte, texte) == 0) {
+        return *place;
+    }
+    int etat;
+    Programme *p = compiler(texte, 0, &etat);
+    if (p == NULL) {
+        return NULL;
+    }
+    p->empreinte = h;
+    p->texte = strdup(texte);   // NULL : pas retrouvé, simplement
+    liberer_programme(*place);
+    *place = p;
+    return p;
+}
+
+
+// ================================================================================================
+// Exécution
+
+// Liste d'un for en cours de parcours
+typedef struct {
+    char **mots;
+    int suivant;
+    const char *nom;
+} Iteration;
+
+int executer_programme(const Programme *p, int (*executer)(struct cmdline *l),
+                       char **(*developper)(char **mots, char **proteges)) {
+    int statut = 0;
+    int *registres = calloc(p->nb_registres + 1, sizeof(int));
+    Iteration *iterations = calloc(p->nb_iterations + 1, sizeof(Iteration));
+    if (registres == NULL || iterations == NULL) {
+        perror("programme");
+        free(registres);
+        free(iterations);
+        return 1;
+    }
+
+    for (int pc = 0; pc < p->nb_code; pc++) {
+        const Instruction *i = &p->code[pc];
+        Iteration *it;
+        switch (i->op) {
+        case OP_EXECUTER:
+            dernier_statut = statut;    // $? : code de ce qui précède, structures comprises
+            statut = dernier_statut = executer(p->lignes[i->a]);
+            if (statut == STATUT_INTERRUPTION) {
+                pc = p->nb_code;    // Ctrl-C : tout le programme s'arrête
+            }
+            break;
+        case OP_SAUT:
+            pc = i->a - 1;
+            break;
+        case OP_SAUT_SI_ECHEC:
+            if (statut != 0) {
+                pc = i->a - 1;
+            }
+            break;
+        case OP_SAUT_SI_SUCCES:
+            if (statut == 0) {
+                pc = i->a - 1;
+            }
+            break;
+        case OP_STATUT_NUL:
+            statut = 0;
+            break;
+        case OP_GARDER:
+            registres[i->a] = statut;
+            break;
+        case OP_RENDRE:
+            statut = registres[i->a];
+            break;
+        case OP_POUR:
+            it = &iterations[i->b];
+            liberer_mots(it->mots);     // break d'un parcours précédent
+            it->nom = p->lignes[i->a]->seq[0][0];
+            it->mots = developper(p->lignes[i->a]->seq[0] + 2, p->lignes[i->a]->quoted);
+            it->suivant = 0;
+            if (it->mots == NULL) {
+                perror("for");
+                statut = 1;
+                pc = p->nb_code;
+            }
+            break;
+        case OP_SUIVANT:
+            it = &iterations[i->a];
+            if (it->mots[it->suivant] == NULL) {
+                liberer_mots(it->mots);
+                it->mots = NULL;
+                pc = i->b - 1;
+            } else if (definir_variable(it->nom, it->mots[it->suivant++]) == -1) {
+                perror("for");
+                statut = 1;
+                pc = p->nb_code;
+            }
+            break;
+        }
+    }
+
+    for (int k = 0; k < p->nb_iterations; k++) {
+        liberer_mots(iterations[k].mots);
+    }
+    free(iterations);
+    free(registres);
+    return dernier_statut = statut;
+}
+
+
+// ================================================================================================
+// Variables
+
+// Vrai si d (un '$') a été protégé par des apostrophes ou '\'
+static int protege(const char *d, char **proteges) {
+    for (int i = 0; proteges != NULL && proteges[i] != NULL; i++) {
+        if (proteges[i] == d) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int contient_variables(char **mots, char **proteges) {
+    for (int i = 0; mots[i] != NULL; i++) {
+        for (const char *d = strchr(mots[i], '$'); d != NULL; d = strchr(d + 1, '$')) {
+            if (!protege(d, proteges)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Valeur de la variable dont le nom commence en s (juste après '$'), *lg
+// recevant la longueur du nom. NULL si ce n'est pas un nom : '$' reste tel quel.
+static const char *valeur_dollar(const char *s, size_t *lg, char tampon[32]) {
+    if (*s == '?' || *s == '$') {
+        snprintf(tampon, 32, "%d", *s == '?' ? dernier_statut : (int)getpid());
+        *lg = 1;
+        return tampon;
+    }
+    int accolade = *s == '{';
+    const char *nom = s + accolade;
+    size_t n = 0;
+    if (isalpha((unsigned char)nom[0]) || nom[0] == '_') {
+        while (isalnum((unsigned char)nom[n]) || nom[n] == '_') {
+            n++;
+        }
+    }
+    char copie[256];
+    if (n == 0 || n >= sizeof(copie) || (accolade && nom[n] != '}')) {
+        return NULL;
+    }
+    memcpy(copie, nom, n);
+    copie[n] = '\0';
+    *lg = n + 2 * accolade;
+    const char *valeur = valeur_variable(copie);
+    return valeur ? valeur : "";
+}
+
+// Écrit mot développé en dst (sauf si dst est NULL). Renvoie sa longueur.
+static size_t developper_mot(const char *mot, char **proteges, char *dst) {
+    size_t n = 0;
+    const char *p = mot;
+    while (1) {
+        const char *dollar = strchr(p, '$');
+        size_t avant = dollar ? (size_t)(dollar - p) : strlen(p);
+        if (dst != NULL) {
+            memcpy(dst + n, p, avant);
+        }
+        n += avant;
+        if (dollar == NULL) {
+            return n;
+        }
+        size_t lg;
+        char tampon[32];
+        const char *valeur = protege(dollar, proteges) ? NULL
+                                                       : valeur_dollar(dollar + 1, &lg, tampon);
+        if (valeur == NULL) {
+            valeur = "$";
+            lg = 0;
+        }
+        size_t lv = strlen(valeur);
+        if (dst != NULL) {
+            memcpy(dst + n, valeur, lv);
+        }
+        n += lv;
+        p = dollar + 1 + lg;
+    }
+}
+
+char **developper_variables(char **mots, char **proteges) {
+    size_t nb, total = 0;
+    for (nb = 0; mots[nb] != NULL; nb++) {
+        total += developper_mot(mots[nb], proteges, NULL) + 1;
+    }
+    char **resultat = malloc((nb + 1) * sizeof(char *) + total);
+    if (resultat == NULL) {
+        return NULL;
+    }
+    char *texte = (char *)(resultat + nb + 1);
+    for (size_t i = 0; i < nb; i++) {
+        size_t lg = developper_mot(mots[i], proteges, texte);
+        texte[lg] = '\0';
+        resultat[i] = texte;
+        texte += lg + 1;
+    }
+    resultat[nb] = NULL;
+    return resultat;
+}
@@ -0,0 +1,58 @@
+/*****************************************************
+ * Ensishell : structures de contrôle et variables   *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __CONTROLE_H
+#define __CONTROLE_H
+
+#include "readcmd.h"
+
+/* Texte compilé : chaque pipeline est analysé une seule fois par parsecmd et
+   gardé (copycmd) ; le contrôle (;, &&, ||, if, while, until, for, break,
+   continue) devient des sauts entre ces pipelines. Un corps de boucle n'est
+   donc jamais réanalysé d'une itération à l'autre. */
+typedef struct Programme Programme;
+
+/* Code de retour de la dernière commande, valeur de $? */
+extern int dernier_statut;
+
+/* Vrai si la ligne a besoin des structures de contrôle : plusieurs commandes
+   (;, &&, ||, & suivi d'une commande) ou un mot-clé en tête. Une ligne
+   simple garde le chemin habituel. */
+int besoin_controle(const char *texte);
+
+/* Vrai si le texte s'arrête au milieu d'une structure (if sans fi, boucle
+   sans done, && ou || en fin de texte) : la suite est sur les lignes
+   suivantes. Un texte erroné n'est pas incomplet. */
+int texte_incomplet(const char *texte);
+
+/* Programme du texte (lignes séparées par '\n'), repris du cache si le même
+   texte a déjà été compilé (empreinte FNV-1a puis comparaison). Le pointeur
+   reste valable jusqu'au prochain appel. Renvoie NULL après un message en
+   cas d'erreur de syntaxe. */
+const Programme *compiler_programme(const char *texte);
+
+/* Exécute p : executer(l) lance chaque pipeline et renvoie son code de
+   retour, developper(mots, proteges) expanse la liste d'un for (tableau à
+   libérer avec liberer_mots). Un pipeline interrompu par Ctrl-C arrête tout
+   le programme. Renvoie le code de retour de la dernière commande exécutée.
+   La variable d'un for est une variable du shell, qui n'est pas exportée
+   (sauf si elle l'était déjà). */
+int executer_programme(const Programme *p, int (*executer)(struct cmdline *l),
+                       char **(*developper)(char **mots, char **proteges));
+
+/* Vrai si un des mots contient un '$' qui n'est pas dans proteges (champ
+   quoted de la ligne, NULL : aucun) */
+int contient_variables(char **mots, char **proteges);
+
+/* Remplace $NOM, ${NOM} (variables du shell ou d'environnement, vides si
+   absentes), $? et $$ dans tous les mots. Les guillemets ont déjà été
+   retirés ; les '$' venus d'apostrophes ou de '\' sont dans proteges et
+   restent tels quels. Un mot vide reste un argument. Renvoie un tableau
+   alloué d'un seul bloc (à libérer avec liberer_mots), NULL si la mémoire
+   manque. */
+char **developper_variables(char **mots, char **proteges);
+
+#endif
@@ -5,18 +5,43 @@
  * Ce code est distribué sous la licence GPLv3+.     *
  *****************************************************/
 
+#define _GNU_SOURCE // Pour pipe2
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h> // Pour INT_MAX
 
 #include <unistd.h> // Pour execvp et fork
 #include <sys/wait.h> // Pour waitpid et wait
+#include <sys/resource.h> // Pour wait4 et struct rusage
+#include <sys/time.h> // Pour timeradd
 #include <fcntl.h> //Pour la manipulation de mes fichiers au niveau de la question 6
+#include <spawn.h> // Pour posix_spawnp (lancement sans recopie de l'espace d'adressage)
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h> // Pour la boucle d'évènements (terminal + SIGCHLD)
+#include <sys/signalfd.h>
+#include <termios.h> // Pour tcsetpgrp et les modes du terminal
+#include <sys/mman.h> // Pour la projection des scripts
+#include <sys/stat.h>
 
 #include "variante.h"
 #include "readcmd.h"
+#include "transfert.h"
+#include "jobs.h"
+#include "chemins.h"
+#include "jokers.h"
+#include "accolades.h"
+#include "limites.h"
+#include "trace.h"
+#include "historique.h"
+#include "reserve.h"
+#include "internes.h"
+#include "controle.h"
+#include "redirections.h"
 
-#include <glob.h> // Pour l'expansion des jokers
 
 #ifndef VARIANTE
 #error "Variante non défini !!"
@@ -35,59 +60,435 @@
 // QUESTION 4 : Lister les processus en tâches de fond
 
 
+extern char **environ;
+
+// Masque de signaux du shell au démarrage, rendu aux enfants (voir Question 10)
+extern sigset_t masque_origine;
+
+// Contrôle des tâches : chaque pipeline dans son groupe de processus, qui
+// reçoit le terminal au premier plan. Actif seulement en interactif sur un
+// terminal (voir Question 11).
+int controle_jobs = 0;
+
+// Limites (préfixes timeout et limit) de la commande en cours de lancement,
+// posées par chaque enfant avant l'exec, et échéances des tâches (voir
+// Question 11)
+static Limites limites_commande = {.fd_procs = -1};
+int delai_echeances();
+int traiter_echeances(FILE *sortie);
+
+
+// ================================================================================================
+// Options du shell, modifiables à l'exécution avec la commande interne 'option'
+// et initialisées au démarrage depuis les variables d'environnement ENSISHELL_<NOM>
 
+// Moteur de lancement des étapes d'un pipeline
+enum { LANCEUR_SPAWN, LANCEUR_FORK };
+static const char *const valeurs_lanceur[] = {"spawn", "fork", NULL};
+int option_lanceur = LANCEUR_SPAWN;
 
-#define MAX_JOBS 100
+static const char *const valeurs_on_off[] = {"off", "on", NULL};
+
+// Étapes cat/tee assurées par le shell avec splice/tee/copy_file_range
+int option_transfert = 1;
+
+// Commande trop longue pour execve (ARG_MAX) lancée en plusieurs lots, comme
+// xargs, et nombre de lots lancés en même temps
+int option_decoupage = 0;
+int option_paralleles = 1;
+
+// Limites cpus et mem du préfixe limit appliquées aussi par un cgroupe v2
+int option_cgroupes = 0;
+
+// Sortie '>' écrite dans un fichier anonyme, qui ne remplace la cible qu'une
+// fois la commande réussie (voir redirections.h)
+int option_atomique = 0;
+
+// Commandes courantes (echo, test, cd...) exécutées par le shell (voir internes.h)
+int option_internes = 1;
 
 typedef struct {
-    pid_t pid;
-    char *command;
-} Job;
+    const char *nom;
+    const char *const *valeurs; // Valeurs possibles, l'indice choisi est rangé dans *choix
+    int *choix;                 // (valeurs NULL : entier strictement positif)
+} Option;
+
+Option options[] = {
+    {"lanceur", valeurs_lanceur, &option_lanceur},
+    {"transfert", valeurs_on_off, &option_transfert},
+    {"decoupage", valeurs_on_off, &option_decoupage},
+    {"paralleles", NULL, &option_paralleles},
+    {"cgroupes", valeurs_on_off, &option_cgroupes},
+    {"atomique", valeurs_on_off, &option_atomique},
+    {"internes", valeurs_on_off, &option_internes},
+    {NULL, NULL, NULL}
+};
+
+// Change la valeur d'une option, renvoie -1 si le nom ou la valeur est inconnu
+int modifier_option(const char *nom, const char *valeur) {
+    for (int i = 0; options[i].nom != NULL; i++) {
+        if (strcmp(options[i].nom, nom) != 0) {
+            continue;
+        }
+        if (options[i].valeurs == NULL) {
+            char *fin;
+            long v = strtol(valeur, &fin, 10);
+            if (fin == valeur || *fin != '\0' || v < 1 || v > 4096) {
+                return -1;
+            }
+            *options[i].choix = (int)v;
+            return 0;
+        }
+        for (int j = 0; options[i].valeurs[j] != NULL; j++) {
+            if (strcmp(options[i].valeurs[j], valeur) == 0) {
+                *options[i].choix = j;
+                return 0;
+            }
+        }
+        return -1;
+    }
+    return -1;
+}
 
+// Lit les variables d'environnement ENSISHELL_<NOM> au démarrage
+void initialiser_options() {
+    for (int i = 0; options[i].nom != NULL; i++) {
+        char variable[64] = "ENSISHELL_";
+        size_t n = strlen(variable);
+        for (const char *c = options[i].nom; *c && n < sizeof(variable) - 1; c++) {
+            variable[n++] = toupper((unsigned char)*c);
+        }
+        variable[n] = '\0';
 
-Job jobs[MAX_JOBS];
-int job_count = 0;
+        char *valeur = getenv(variable);
+        if (valeur != NULL && modifier_option(options[i].nom, valeur) == -1) {
+            fprintf(stderr, "%s: valeur '%s' invalide\n", variable, valeur);
+        }
+    }
+}
 
+// Commande interne : "option" liste les options, "option nom valeur" en change une
+void commande_option(char **cmd) {
+    if (cmd[1] == NULL) {
+        for (int i = 0; options[i].nom != NULL; i++) {
+            if (options[i].valeurs == NULL) {
+                printf("%s %d\n", options[i].nom, *options[i].choix);
+            } else {
+                printf("%s %s\n", options[i].nom, options[i].valeurs[*options[i].choix]);
+            }
+        }
+        return;
+    }
+    if (cmd[2] == NULL || cmd[3] != NULL) {
+        fprintf(stderr, "usage : option [nom valeur]\n");
+        return;
+    }
+    if (modifier_option(cmd[1], cmd[2]) == -1) {
+        fprintf(stderr, "option: '%s %s' inconnue\n", cmd[1], cmd[2]);
+    }
+}
 
 // ================================================================================================
-// Ajoute un nouveau processus en tâche de fond à la liste des jobs.
-void ajouter_job(pid_t pid, char *command) {
-    if (job_count < MAX_JOBS) {
-        jobs[job_count].pid = pid;
-        jobs[job_count].command = strdup(command);  // Allouer une nouvelle chaîne pour la commande
-        job_count++;
+// Commande time : durée et ressources du pipeline, et temps passé par le shell
+// lui-même dans chaque phase du lancement (horloge CLOCK_MONOTONIC). Les
+// repères sont posés pour chaque ligne, time ou non : un appel vDSO chacun.
+
+enum { PHASE_ANALYSE, PHASE_EXPANSION, PHASE_PIPES, PHASE_LANCEMENT, PHASE_EXEC,
+       PHASE_ATTENTE, NB_PHASES };
+static const char *const noms_phases[NB_PHASES] = {
+    "analyse", "expansion", "pipes", "lancement", "exec", "attente"
+};
+
+// Formats du rapport : texte, POSIX (time -p) ou JSON sur une ligne (time -j)
+enum { TIME_AUCUN, TIME_TEXTE, TIME_POSIX, TIME_JSON };
+
+typedef struct {
+    int format;                 // TIME_AUCUN : pas de préfixe time
+    struct timespec debut;      // Début de la ligne, avant l'analyse
+    struct timespec repere;     // Fin de la phase précédente
+    double phases[NB_PHASES];   // Secondes
+    struct rusage usage;        // Cumul des processus du pipeline au premier plan
+} Chrono;
+
+static Chrono chrono;
+
+static double ecart(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+// Début d'une ligne : remise à zéro des phases
+void debuter_chrono() {
+    clock_gettime(CLOCK_MONOTONIC, &chrono.debut);
+    chrono.repere = chrono.debut;
+    memset(chrono.phases, 0, sizeof(chrono.phases));
+    memset(&chrono.usage, 0, sizeof(chrono.usage));
+    chrono.format = TIME_AUCUN;
+}
+
+// Le temps écoulé depuis le repère précédent est compté dans phase
+void marquer(int phase) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    chrono.phases[phase] += ecart(&chrono.repere, &t);
+    chrono.repere = t;
+}
+
+// Le temps écoulé depuis le repère précédent n'est compté nulle part
+void ignorer_phase() {
+    clock_gettime(CLOCK_MONOTONIC, &chrono.repere);
+}
+
+// Préfixe "time [-p|-j]" : renvoie le nombre de mots lus
+int lire_time(char **mots) {
+    if (strcmp(mots[0], "time") != 0) {
+        return 0;
+    }
+    int i = 1;
+    chrono.format = TIME_TEXTE;
+    for (; mots[i] != NULL && mots[i][0] == '-'; i++) {
+        if (strcmp(mots[i], "-p") == 0) {
+            chrono.format = TIME_POSIX;
+        } else if (strcmp(mots[i], "-j") == 0) {
+            chrono.format = TIME_JSON;
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+// Rapport de time sur la sortie d'erreur, comme sh
+void afficher_time(int retour) {
+    struct timespec fin;
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+    double reel = ecart(&chrono.debut, &fin);
+    double user = chrono.usage.ru_utime.tv_sec + chrono.usage.ru_utime.tv_usec / 1e6;
+    double sys = chrono.usage.ru_stime.tv_sec + chrono.usage.ru_stime.tv_usec / 1e6;
+
+    if (chrono.format == TIME_POSIX) {
+        fprintf(stderr, "real %.2f\nuser %.2f\nsys %.2f\n", reel, user, sys);
+    } else if (chrono.format == TIME_JSON) {
+        fprintf(stderr, "{\"reel\":%.6f,\"user\":%.6f,\"sys\":%.6f,\"maxrss_ko\":%ld,"
+                "\"commutations_volontaires\":%ld,\"commutations_forcees\":%ld,\"code\":%d,"
+                "\"phases_us\":{", reel, user, sys, chrono.usage.ru_maxrss,
+                chrono.usage.ru_nvcsw, chrono.usage.ru_nivcsw, retour);
+        for (int i = 0; i < NB_PHASES; i++) {
+            fprintf(stderr, "%s\"%s\":%.1f", i ? "," : "", noms_phases[i], chrono.phases[i] * 1e6);
+        }
+        fprintf(stderr, "}}\n");
     } else {
-        printf("Erreur : trop de tâches en arrière-plan.\n");
+        fprintf(stderr, "réel %.3fs  user %.3fs  sys %.3fs  maxrss %ld Ko  "
+                "commutations %ld volontaires, %ld forcées\n", reel, user, sys,
+                chrono.usage.ru_maxrss, chrono.usage.ru_nvcsw, chrono.usage.ru_nivcsw);
+        fprintf(stderr, "shell :");
+        for (int i = 0; i < NB_PHASES; i++) {
+            fprintf(stderr, " %s %.1fµs", noms_phases[i], chrono.phases[i] * 1e6);
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+// ================================================================================================
+// Trace des commandes (commande interne trace, voir trace.h) : l'enregistrement
+// d'un pipeline est commencé à son lancement, suit sa tâche, et part dans
+// l'anneau de trace à sa fin
+
+typedef struct {
+    EnregistrementTrace e;
+    char sortie[];              // Fichier de '>', "" sans redirection
+} TraceEnCours;
+
+// Enregistrement de la commande en cours de lancement, NULL sans trace
+static TraceEnCours *trace_commande = NULL;
+
+static int64_t horloge_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static TraceEnCours *commencer_trace(struct cmdline *l) {
+    TraceEnCours *t = calloc(1, sizeof(TraceEnCours) + (l->out ? strlen(l->out) + 1 : 1));
+    if (t == NULL) {
+        return NULL;
+    }
+    t->e.debut_ns = horloge_ns();
+    t->e.empreinte = EMPREINTE_INITIALE;
+    for (int i = 0; l->seq[i] != NULL; i++) {
+        t->e.empreinte = empreinte_mots(l->seq[i], t->e.empreinte);
     }
+    strncpy(t->e.commande, l->seq[0][0], sizeof(t->e.commande) - 1);
+    struct stat st;
+    t->e.octets_entree = (l->in && stat(l->in, &st) == 0) ? st.st_size : -1;
+    if (l->out) {
+        strcpy(t->sortie, l->out);
+    }
+    return t;
 }
 
+static void noter_pids(TraceEnCours *t, const pid_t *pids, int nb) {
+    t->e.nb_etapes = nb;
+    for (int i = 0; i < nb && i < TRACE_MAX_ETAPES; i++) {
+        t->e.pids[i] = pids[i];
+    }
+}
+
+// Fin du pipeline : statut, consommation, taille écrite par '>', puis publication
+static void finir_trace(TraceEnCours *t, int statut, const struct rusage *u) {
+    struct stat st;
+    t->e.fin_ns = horloge_ns();
+    t->e.statut = statut;
+    t->e.user_us = u->ru_utime.tv_sec * 1000000LL + u->ru_utime.tv_usec;
+    t->e.sys_us = u->ru_stime.tv_sec * 1000000LL + u->ru_stime.tv_usec;
+    t->e.maxrss_ko = u->ru_maxrss;
+    t->e.minflt = u->ru_minflt;
+    t->e.majflt = u->ru_majflt;
+    t->e.nvcsw = u->ru_nvcsw;
+    t->e.nivcsw = u->ru_nivcsw;
+    t->e.inblock = u->ru_inblock;
+    t->e.oublock = u->ru_oublock;
+    t->e.octets_sortie = (t->sortie[0] && stat(t->sortie, &st) == 0) ? st.st_size : -1;
+    if (trace_active) {
+        publier_trace(&t->e);
+    }
+    free(t);
+}
+
+// Fin d'une tâche suivie par la trace
+static void finir_trace_job(Job *job, int statut) {
+    if (job->trace != NULL) {
+        finir_trace(job->trace, statut, &job->usage);
+        job->trace = NULL;
+    }
+}
+
+// Fin d'une tâche : sa sortie atomique est publiée, puis l'enregistrement de
+// trace (qui mesure le fichier de sortie)
+static void finir_job(Job *job, int statut) {
+    if (job->ecriture != NULL) {
+        publier_redirections(job->ecriture, statut);
+        free(job->ecriture);
+        job->ecriture = NULL;
+    }
+    finir_trace_job(job, statut);
+}
 
 // ================================================================================================
-// Fonction pour vérifier les jobs en tâche de fond
-void verifier_jobs() {
-    for (int i = 0; i < job_count; i++) {
-        int status;
-        pid_t result = waitpid(jobs[i].pid, &status, WNOHANG);
-        if (result == -1) {
-            perror("waitpid error");
-        } else if (result > 0) {
-            printf("Processus %d terminé.\n", jobs[i].pid);
-            free(jobs[i].command);
-            for (int j = i; j < job_count - 1; j++) {
-                jobs[j] = jobs[j + 1];
-            }
-            job_count--;
-            i--;  // Vérifier à nouveau l'indice car la liste est décalée
+// Code de retour façon shell : code de sortie, ou 128 + numéro du signal
+int code_retour(int status) {
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+static double secondes(struct timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// Affiche le bilan d'une tâche terminée : statut, temps CPU, mémoire, durée
+void afficher_fin_job(FILE *sortie, Job *job) {
+    fprintf(sortie, "[%d] Processus %d terminé", job->id, job->pid);
+    if (WIFSIGNALED(job->statut)) {
+        fprintf(sortie, " (signal %d, %s)", WTERMSIG(job->statut), strsignal(WTERMSIG(job->statut)));
+    } else {
+        fprintf(sortie, " (code %d)", WEXITSTATUS(job->statut));
+    }
+    fprintf(sortie, " user %.3fs sys %.3fs maxrss %ld Ko durée %.3fs : %s\n",
+            secondes(job->usage.ru_utime), secondes(job->usage.ru_stime),
+            job->usage.ru_maxrss, duree_job(job), job->command);
+}
+
+// Changement d'état d'un fils signalé par wait4 : arrêt, reprise ou fin d'un
+// processus d'une tâche. Quand une tâche s'arrête, reprend ou se termine (fin
+// de son dernier processus), l'affiche et renvoie 1 ; renvoie 0 sinon.
+int recuperer_job(pid_t pid, int status, struct rusage *usage, FILE *sortie) {
+    Job *job = chercher_job_pid(pid);
+    if (job == NULL) {
+        return 0;
+    }
+    if (WIFSTOPPED(status)) {
+        if (job->etat == JOB_ARRETE) {
+            return 0;  // Déjà signalé pour un autre processus du pipeline
         }
+        arreter_job(job);
+        fprintf(sortie, "[%d] Arrêté (%s) : %s\n", job->id, strsignal(WSTOPSIG(status)), job->command);
+        return 1;
+    }
+    if (WIFCONTINUED(status)) {
+        if (job->etat != JOB_ARRETE) {
+            return 0;
+        }
+        reprendre_job(job);
+        fprintf(sortie, "[%d] Relancé : %s\n", job->id, job->command);
+        return 1;
+    }
+    if (!terminer_pid(job, pid, status, usage)) {
+        return 0;
+    }
+    finir_job(job, job->depasse ? 124 : code_retour(job->statut));
+    afficher_fin_job(sortie, job);
+    retirer_job(job);
+    return 1;
+}
+
+// ================================================================================================
+// Fonction pour vérifier les jobs en tâche de fond : chaque fils terminé est
+// récupéré avec wait4, qui donne aussi sa consommation de ressources, puis
+// retrouvé dans la table par son pid, sans parcourir la liste.
+// Appelée uniquement depuis la boucle principale, jamais dans un gestionnaire de
+// signal. Les terminaisons sont écrites dans sortie ; renvoie leur nombre.
+int verifier_jobs(FILE *sortie) {
+    int status;
+    struct rusage usage;
+    pid_t pid;
+    int affichees = 0;
+
+    while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0) {
+        affichees += recuperer_job(pid, status, &usage, sortie);
+    }
+    fflush(sortie);
+    return affichees;
+}
+
+// Temps CPU (secondes) et mémoire résidente (Ko) d'un processus encore en
+// cours, lus dans /proc/<pid>/stat. Renvoie -1 si indisponible.
+static int lire_usage_en_cours(pid_t pid, double *user, double *sys, long *rss) {
+    char chemin[64], ligne[1024];
+    snprintf(chemin, sizeof(chemin), "/proc/%d/stat", pid);
+    FILE *f = fopen(chemin, "r");
+    if (f == NULL) {
+        return -1;
+    }
+    char *ok = fgets(ligne, sizeof(ligne), f);
+    fclose(f);
+    // Le nom de la commande (2e champ) peut contenir des espaces : repartir du ')'
+    char *p = ok ? strrchr(ligne, ')') : NULL;
+    unsigned long utime, stime;
+    long pages;
+    if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu "
+                            "%*d %*d %*d %*d %*d %*d %*u %*u %ld", &utime, &stime, &pages) != 3) {
+        return -1;
     }
+    long ticks = sysconf(_SC_CLK_TCK);
+    *user = (double)utime / ticks;
+    *sys = (double)stime / ticks;
+    *rss = pages * (sysconf(_SC_PAGESIZE) / 1024);
+    return 0;
 }
 
 // ================================================================================================
 // Fonction pour afficher les jobs en tâche de fond
 void lister_jobs() {
     printf("Liste des processus en tâche de fond :\n");
-    for (int i = 0; i < job_count; i++) {
-        printf("PID: %d, Commande: %s\n", jobs[i].pid, jobs[i].command);
+    for (Job *job = job_suivant(NULL); job != NULL; job = job_suivant(job)) {
+        double user, sys;
+        long rss;
+        printf("[%d] PID: %d, Commande: %s (depuis %.3fs", job->id, job->pid, job->command, duree_job(job));
+        if (lire_usage_en_cours(job->pid, &user, &sys, &rss) == 0) {
+            printf(", user %.3fs sys %.3fs rss %ld Ko", user, sys, rss);
+        }
+        printf(")%s\n", job->etat == JOB_ARRETE ? " [Arrêté]" : "");
     }
 }
 
@@ -95,273 +496,1449 @@ void lister_jobs() {
 // ================================================================================================
 // Question 6  : Redirection
 
-// Fonction pour gérer les redirections d'entrée et de sortie
-void gerer_redirections(struct cmdline *l, int i, int input_fd, int pipefd[2]) {
+// Début d'un enfant créé par fork, avant l'exec : masque de signaux d'origine,
+// groupe de processus pgid (0 : nouveau groupe, -1 : celui du shell), signaux
+// du terminal rétablis avec le contrôle des tâches, et limites de la commande
+void preparer_enfant(pid_t pgid) {
+    sigprocmask(SIG_SETMASK, &masque_origine, NULL);
+    if (pgid != -1) {
+        setpgid(0, pgid);
+    }
+    if (controle_jobs) {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL);
+        signal(SIGTTOU, SIG_DFL);
+    }
+    appliquer_limites(&limites_commande);
+}
 
-    // Gestion des redirections et des pipes
-    if (input_fd != -1) {
-        // Rediriger l'entrée depuis le pipe précédent
-        if (dup2(input_fd, STDIN_FILENO) == -1) {
-            perror("dup2 (input)");
-            exit(EXIT_FAILURE);
+// Fonction pour gérer les redirections d'entrée et de sortie, dans un enfant
+// créé par fork. entree, sortie et erreur sont des extrémités de pipe ou des
+// fichiers ouverts par le shell (voir redirections.h), tous en O_CLOEXEC :
+// -1 laisse le descripteur du shell, ERREUR_SUR_SORTIE suit la sortie.
+void gerer_redirections(int entree, int sortie, int erreur) {
+    if (entree != -1 && dup2(entree, STDIN_FILENO) == -1) {
+        perror("dup2 (input)");
+        exit(EXIT_FAILURE);
+    }
+    if (sortie != -1 && dup2(sortie, STDOUT_FILENO) == -1) {
+        perror("dup2 (output)");
+        exit(EXIT_FAILURE);
+    }
+    if (erreur == ERREUR_SUR_SORTIE) {
+        erreur = STDOUT_FILENO;
+    }
+    if (erreur != -1 && dup2(erreur, STDERR_FILENO) == -1) {
+        perror("dup2 (error)");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// ================================================================================================
+// Lancement d'une étape avec posix_spawnp : la glibc utilise clone(CLONE_VM|CLONE_VFORK),
+// l'enfant ne recopie donc pas les tables de pages du shell (Guile, readline).
+// Les dup2 de gerer_redirections deviennent des file actions, appliquées dans
+// le même ordre. chemin est l'exécutable trouvé par le cache des
+// commandes (NULL : recherche dans le PATH par posix_spawnp). pgid est le groupe
+// de processus à rejoindre (0 : nouveau groupe, -1 : celui du shell).
+// Renvoie le pid, ou -1 si le lancement a échoué.
+pid_t lancer_spawn(const char *chemin, char **cmd, int entree, int sortie, int erreur,
+                   pid_t pgid) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributs;
+    pid_t pid;
+    short drapeaux = POSIX_SPAWN_SETSIGMASK;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attributs);
+    posix_spawnattr_setsigmask(&attributs, &masque_origine);
+    if (pgid != -1) {
+        drapeaux |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attributs, pgid);
+    }
+    if (controle_jobs) {
+        // Le shell ignore les signaux du terminal, pas ses enfants
+        sigset_t defaut;
+        sigemptyset(&defaut);
+        sigaddset(&defaut, SIGINT);
+        sigaddset(&defaut, SIGQUIT);
+        sigaddset(&defaut, SIGTSTP);
+        sigaddset(&defaut, SIGTTIN);
+        sigaddset(&defaut, SIGTTOU);
+        drapeaux |= POSIX_SPAWN_SETSIGDEF;
+        posix_spawnattr_setsigdefault(&attributs, &defaut);
+    }
+    posix_spawnattr_setflags(&attributs, drapeaux);
+
+    // Les originaux, en O_CLOEXEC, se ferment à l'exec
+    if (entree != -1) {
+        posix_spawn_file_actions_adddup2(&actions, entree, STDIN_FILENO);
+    }
+    if (sortie != -1) {
+        posix_spawn_file_actions_adddup2(&actions, sortie, STDOUT_FILENO);
+    }
+    if (erreur == ERREUR_SUR_SORTIE) {
+        posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO);
+    } else if (erreur != -1) {
+        posix_spawn_file_actions_adddup2(&actions, erreur, STDERR_FILENO);
+    }
+
+    int err;
+    if (chemin != NULL) {
+        err = posix_spawn(&pid, chemin, &actions, &attributs, cmd, environ);
+    } else {
+        err = posix_spawnp(&pid, cmd[0], &actions, &attributs, cmd, environ);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributs);
+
+    if (err != 0) {
+        fprintf(stderr, "%s: %s: %s\n", chemin ? "posix_spawn" : "posix_spawnp",
+                cmd[0], strerror(err));
+        return -1;
+    }
+    return pid;
+}
+
+
+// Lancement d'une étape par un processus de la réserve (commande interne pool,
+// voir reserve.h), qui reçoit les descripteurs comme avec gerer_redirections.
+// Renvoie le pid, -1 si la réserve ne peut pas la lancer (lancement normal).
+static pid_t lancer_par_reserve(const char *chemin, char **cmd, int entree, int sortie,
+                                int erreur, pid_t pgid) {
+    int fds[3] = {entree != -1 ? entree : STDIN_FILENO,
+                  sortie != -1 ? sortie : STDOUT_FILENO, STDERR_FILENO};
+    if (erreur == ERREUR_SUR_SORTIE) {
+        fds[2] = fds[1];
+    } else if (erreur != -1) {
+        fds[2] = erreur;
+    }
+    return lancer_reserve(chemin, cmd, fds, pgid);
+}
+
+
+// ================================================================================================
+// Fonction pour exécuter une commande enfant
+void executer_enfant(char **cmd) {
+    execvp(cmd[0], cmd);
+    perror("execvp");
+    exit(EXIT_FAILURE);
+}
+
+
+// =================================================================================================
+// Question 8  : Jokers étendus (Jocker en glob)
+
+
+// Fonction pour gérer l'expansion des jokers et des accolades dans une commande.
+// proteges : champ quoted de sa ligne, les '$' à laisser tels quels.
+// Renvoie un nouveau tableau à libérer avec liberer_mots, NULL en cas d'erreur (errno).
+char **expand_command(char **cmd, char **proteges) {
+    // Les variables ($NOM, $?) d'abord, seulement si un mot en contient
+    char **variables = NULL;
+    if (contient_variables(cmd, proteges)) {
+        variables = developper_variables(cmd, proteges);
+        if (variables == NULL) {
+            return NULL;
         }
-        close(input_fd);
+        cmd = variables;
+    }
+
+    // Puis les accolades : elles sont écrites directement dans un tableau
+    // alloué d'un bloc à la bonne taille, sans recopie ni réallocation
+    char **mots = developper_accolades(cmd);
+    liberer_mots(variables);
+    if (mots == NULL) {
+        return NULL;
+    }
+
+    // Expansion des jokers de tous les arguments en une passe : un répertoire
+    // parcouru par plusieurs motifs n'est lu qu'une fois. Sans joker ni
+    // tilde, le résultat des accolades sert tel quel.
+    int jokers = 0;
+    for (int i = 0; mots[i] != NULL && !jokers; i++) {
+        jokers = (mots[i][0] == '~' || contient_jokers(mots[i]));
+    }
+    if (!jokers) {
+        return mots;
+    }
+    char **resultat = developper_jokers(mots);
+    liberer_mots(mots);
+    return resultat;
+}
+
+
+
+// ================================================================================================
+// Question 10  : Signaux
+
+// SIGCHLD reste bloqué dans le shell et arrive sur un signalfd, surveillé avec
+// l'entrée du terminal par poll() : les fils sont récupérés dans la boucle
+// principale, sans printf ni free dans un gestionnaire de signal. Les enfants
+// retrouvent le masque d'origine avant l'exec.
+
+int fd_sigchld = -1;
+sigset_t masque_origine;
+
+void initialiser_sigchld() {
+    sigset_t masque;
+    sigemptyset(&masque);
+    sigaddset(&masque, SIGCHLD);
+    if (sigprocmask(SIG_BLOCK, &masque, &masque_origine) == -1) {
+        perror("sigprocmask");
+        exit(EXIT_FAILURE);
     }
+    fd_sigchld = signalfd(-1, &masque, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd_sigchld == -1) {
+        perror("signalfd");
+        exit(EXIT_FAILURE);
+    }
+}
 
-    if (l->seq[i + 1] != NULL) {
-        // Si une commande suit, rediriger la sortie vers le pipe
-        close(pipefd[0]); // Fermer le côté lecture du pipe
-        if (dup2(pipefd[1], STDOUT_FILENO) == -1) {
-            perror("dup2 (output)");
+// Vide le signalfd (plusieurs fins de fils peuvent ne donner qu'un SIGCHLD)
+// puis récupère tous les fils terminés ; sans SIGCHLD en attente, rien à faire
+int traiter_sigchld(FILE *sortie) {
+    struct signalfd_siginfo info;
+    int recu = 0;
+    while (read(fd_sigchld, &info, sizeof(info)) == sizeof(info)) {
+        recu = 1;
+    }
+    return recu ? verifier_jobs(sortie) : 0;
+}
+
+#if USE_GNU_READLINE == 1
+static char *ligne_lue = NULL;
+static int ligne_prete = 0;
+
+static void recevoir_ligne(char *line) {
+    ligne_lue = line;
+    ligne_prete = 1;
+    rl_callback_handler_remove();
+}
+#endif
+
+// Lit une ligne comme readline(prompt), en signalant les fins de tâches dès
+// qu'elles arrivent, même pendant la saisie
+char *lire_ligne(char *prompt) {
+#if USE_GNU_READLINE == 1
+    ligne_prete = 0;
+    rl_callback_handler_install(prompt, recevoir_ligne);
+#else
+    printf("%s", prompt);
+    fflush(stdout);
+#endif
+
+    while (1) {
+        struct pollfd fds[2] = {
+            {.fd = STDIN_FILENO, .events = POLLIN},
+            {.fd = fd_sigchld, .events = POLLIN},
+        };
+        int prets = poll(fds, 2, delai_echeances());
+        if (prets == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
             exit(EXIT_FAILURE);
         }
-        close(pipefd[1]);
+
+        // Fins de tâches ou échéance atteinte (délai de poll écoulé)
+        if ((fds[1].revents & POLLIN) || prets == 0) {
+#if USE_GNU_READLINE == 1
+            // Effacer la saisie en cours, afficher, puis la redessiner
+            char *notes = NULL;
+            size_t taille = 0;
+            FILE *tampon = open_memstream(&notes, &taille);
+            if (tampon != NULL) {
+                int n = traiter_echeances(tampon) + traiter_sigchld(tampon);
+                fclose(tampon);
+                if (n > 0) {
+                    rl_clear_visible_line();
+                    fputs(notes, stdout);
+                    fflush(stdout);
+                    rl_forced_update_display();
+                }
+                free(notes);
+            }
+#else
+            if (traiter_echeances(stdout) + traiter_sigchld(stdout) > 0) {
+                printf("%s", prompt);
+                fflush(stdout);
+            }
+#endif
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+#if USE_GNU_READLINE == 1
+            rl_callback_read_char();
+            if (ligne_prete) {
+                return ligne_lue;
+            }
+#else
+            return readline("");
+#endif
+        }
     }
+}
 
-    // Gestion des redirections d'entrée et de sortie depuis/vers des fichiers
-    if (l->in != NULL && i == 0) {
-        // Redirection de l'entrée pour la première commande
-        int fd_in = open(l->in, O_RDONLY);
-        if (fd_in == -1) {
-            perror("open (input file)");
-            exit(EXIT_FAILURE);
+
+// ================================================================================================
+// Question 11  : Contrôle des tâches
+
+// En interactif sur un terminal, le shell prend son propre groupe de processus
+// et ignore les signaux du terminal (Ctrl-C, Ctrl-\, Ctrl-Z) ; chaque pipeline est lancé dans un
+// nouveau groupe, à qui le terminal est donné tant qu'il est au premier plan.
+// Ctrl-Z arrête alors tout le pipeline, que fg et bg relancent.
+
+static pid_t pgid_shell = 0;
+static struct termios modes_shell;
+
+void initialiser_controle_jobs() {
+    if (!isatty(STDIN_FILENO)) {
+        return;
+    }
+    // Lancé en arrière-plan par un autre shell : attendre d'être au premier plan
+    while (tcgetpgrp(STDIN_FILENO) != (pgid_shell = getpgrp())) {
+        kill(-pgid_shell, SIGTTIN);
+    }
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    // Un leader de session (shell de connexion) a déjà son groupe
+    if (getpgrp() != getpid() && setpgid(0, 0) == -1) {
+        perror("setpgid");
+        return;
+    }
+    pgid_shell = getpgrp();
+    if (tcsetpgrp(STDIN_FILENO, pgid_shell) == -1 || tcgetattr(STDIN_FILENO, &modes_shell) == -1) {
+        perror("tcsetpgrp");
+        return;
+    }
+    controle_jobs = 1;
+}
+
+// Texte d'un pipeline pour jobs, fg et les messages : étapes séparées par " | "
+static char *texte_commande(struct cmdline *l) {
+    char *texte = NULL;
+    size_t taille = 0;
+    FILE *f = open_memstream(&texte, &taille);
+    if (f == NULL) {
+        return NULL;
+    }
+    for (int i = 0; l->seq[i] != NULL; i++) {
+        for (int j = 0; l->seq[i][j] != NULL; j++) {
+            fprintf(f, "%s%s", (i > 0 && j == 0) ? " | " : (j > 0 ? " " : ""), l->seq[i][j]);
         }
-        if (dup2(fd_in, STDIN_FILENO) == -1) {
-            perror("dup2 (input file)");
-            exit(EXIT_FAILURE);
+    }
+    fclose(f);
+    return texte;
+}
+
+// Envoie sig à toute la tâche : à son groupe s'il lui est propre, sinon à
+// chacun de ses processus vivants
+static int signaler_job(Job *job, int sig) {
+    if (job->pgid > 0) {
+        return killpg(job->pgid, sig);
+    }
+    int retour = 0;
+    for (int i = 0; i < job->nb_pids; i++) {
+        if (job->pids[i] != 0 && kill(job->pids[i], sig) == -1) {
+            retour = -1;
+        }
+    }
+    return retour;
+}
+
+// Échéances des préfixes timeout : le shell surveille lui-même la durée des
+// tâches, depuis sa boucle d'évènements (poll avec délai) ou pendant l'attente
+// du premier plan. À l'échéance, SIGTERM, puis SIGKILL après DELAI_GRACE.
+
+#define DELAI_GRACE 2.0
+
+static void armer_echeance(Job *job, const struct timespec *depart, double secondes) {
+    struct timespec echeance;
+    echeance.tv_sec = depart->tv_sec + (time_t)secondes;
+    echeance.tv_nsec = depart->tv_nsec + (long)((secondes - (time_t)secondes) * 1e9);
+    if (echeance.tv_nsec >= 1000000000L) {
+        echeance.tv_sec++;
+        echeance.tv_nsec -= 1000000000L;
+    }
+    if (fixer_echeance(job, echeance) == -1) {
+        perror("timeout");
+    }
+}
+
+// Millisecondes (arrondies au-dessus) avant l'échéance de la tâche, 0 si elle
+// est passée, -1 sans échéance
+static int delai_echeance(const Job *job) {
+    if (job->echeance.tv_sec == 0) {
+        return -1;
+    }
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    long long ns = (job->echeance.tv_sec - t.tv_sec) * 1000000000LL + (job->echeance.tv_nsec - t.tv_nsec);
+    if (ns <= 0) {
+        return 0;
+    }
+    return ns / 1000000 >= INT_MAX ? INT_MAX : (int)((ns + 999999) / 1000000);
+}
+
+// Délai de poll jusqu'à la prochaine échéance, -1 s'il n'y en a pas. Temps
+// constant : seule la tête du tas des échéances est regardée.
+int delai_echeances() {
+    Job *job = prochaine_echeance();
+    return job ? delai_echeance(job) : -1;
+}
+
+// Interrompt la tâche si son échéance est passée. Renvoie 1 si un message a
+// été écrit dans sortie.
+static int verifier_echeance(Job *job, FILE *sortie) {
+    if (delai_echeance(job) != 0) {
+        return 0;
+    }
+    if (job->depasse) {
+        signaler_job(job, SIGKILL);
+        fixer_echeance(job, (struct timespec){0, 0});
+        return 0;
+    }
+    fprintf(sortie, "[%d] Délai dépassé : %s\n", job->id, job->command);
+    job->depasse = 1;
+    signaler_job(job, SIGTERM);
+    if (job->etat == JOB_ARRETE) {
+        reprendre_job(job);
+        signaler_job(job, SIGCONT);
+    }
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    armer_echeance(job, &t, DELAI_GRACE);
+    return 1;
+}
+
+// Traite toutes les échéances passées, prises en tête du tas : chaque tâche
+// traitée repart plus loin (délai de grâce) ou en sort. Renvoie le nombre de
+// messages écrits.
+int traiter_echeances(FILE *sortie) {
+    int affichees = 0;
+    Job *job;
+    while ((job = prochaine_echeance()) != NULL && delai_echeance(job) == 0) {
+        affichees += verifier_echeance(job, sortie);
+    }
+    fflush(sortie);
+    return affichees;
+}
+
+// Attend la tâche au premier plan (en lui donnant le terminal), jusqu'à sa fin
+// ou son arrêt. relancer : la tâche était arrêtée, lui envoyer SIGCONT.
+// Renvoie le code de retour de sa dernière étape (la tâche est alors retirée),
+// 124 si elle a été interrompue à son échéance, ou 128 + le signal d'arrêt
+// (*arrete vaut alors 1, la tâche reste).
+int attendre_premier_plan(Job *job, int relancer, int *arrete) {
+    int terminal = controle_jobs && job->pgid > 0;
+    *arrete = 0;
+    if (terminal) {
+        tcsetpgrp(STDIN_FILENO, job->pgid);
+    }
+    if (relancer) {
+        reprendre_job(job);
+        signaler_job(job, SIGCONT);
+    }
+
+    int retour = 0;
+    int sigchld_vide = 0;
+    while (1) {
+        pid_t cible = job->pgid > 0 ? -job->pgid : 0;
+        for (int i = 0; cible == 0 && i < job->nb_pids; i++) {
+            cible = job->pids[i];
+        }
+        int status;
+        struct rusage usage;
+        // Avec des échéances (de cette tâche ou de tâches de fond), attente
+        // sur le signalfd limitée à la plus proche
+        int delai = delai_echeances();
+        pid_t pid = wait4(cible, &status, WUNTRACED | (delai != -1 ? WNOHANG : 0), &usage);
+        if (pid == 0) {
+            struct pollfd pfd = {.fd = fd_sigchld, .events = POLLIN};
+            if (poll(&pfd, 1, delai) > 0) {
+                struct signalfd_siginfo info;
+                while (read(fd_sigchld, &info, sizeof(info)) == sizeof(info)) {
+                    sigchld_vide = 1;
+                }
+            } else {
+                traiter_echeances(stdout);
+            }
+            continue;
+        }
+        if (pid == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            retour = 127;   // Plus rien à attendre (ECHILD)
+            finir_job(job, retour);
+            retirer_job(job);
+            break;
+        }
+        if (WIFSTOPPED(status)) {
+            arreter_job(job);
+            printf("\n[%d] Arrêté (%s) : %s\n", job->id, strsignal(WSTOPSIG(status)), job->command);
+            retour = 128 + WSTOPSIG(status);
+            *arrete = 1;
+            break;
+        }
+        if (terminer_pid(job, pid, status, &usage)) {
+            retour = job->depasse ? 124 : code_retour(job->statut);
+            chrono.usage = job->usage;
+            finir_job(job, retour);
+            retirer_job(job);
+            break;
+        }
+    }
+    if (sigchld_vide) {
+        // Les fins des tâches de fond signalées pendant l'attente
+        verifier_jobs(stdout);
+    }
+
+    if (terminal) {
+        tcsetpgrp(STDIN_FILENO, pgid_shell);
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &modes_shell);
+    }
+    return retour;
+}
+
+// Tâche désignée par "%n" ou "n", ou la plus récente (numéro le plus grand)
+// sans désignation. Affiche un message et renvoie NULL si absente.
+static Job *designer_job(const char *commande, const char *designation) {
+    Job *job = NULL;
+    if (designation != NULL) {
+        job = chercher_job(designation);
+    } else {
+        for (Job *j = job_suivant(NULL); j != NULL; j = job_suivant(j)) {
+            job = j;
+        }
+    }
+    if (job == NULL) {
+        fprintf(stderr, "%s: %s : tâche inexistante\n", commande, designation ? designation : "%+");
+    }
+    return job;
+}
+
+// Commande interne 'fg [%n]' : remet la tâche au premier plan
+int commande_fg(char **cmd) {
+    Job *job = designer_job(cmd[0], cmd[1]);
+    if (job == NULL) {
+        return 1;
+    }
+    int arrete;
+    printf("%s\n", job->command);
+    fflush(stdout);
+    return attendre_premier_plan(job, job->etat == JOB_ARRETE, &arrete);
+}
+
+// Commande interne 'bg [%n]' : relance en arrière-plan une tâche arrêtée
+int commande_bg(char **cmd) {
+    Job *job = designer_job(cmd[0], cmd[1]);
+    if (job == NULL) {
+        return 1;
+    }
+    if (job->etat == JOB_ARRETE) {
+        reprendre_job(job);
+        if (signaler_job(job, SIGCONT) == -1) {
+            perror("bg");
+            return 1;
+        }
+    }
+    printf("[%d] %s &\n", job->id, job->command);
+    return 0;
+}
+
+// Numéro de signal d'après "9", "KILL" ou "SIGKILL", -1 si inconnu
+static int numero_signal(const char *nom) {
+    char *fin;
+    long n = strtol(nom, &fin, 10);
+    if (fin != nom && *fin == '\0') {
+        return (n > 0 && n < NSIG) ? (int)n : -1;
+    }
+    if (strncasecmp(nom, "SIG", 3) == 0) {
+        nom += 3;
+    }
+    for (int s = 1; s < NSIG; s++) {
+        const char *abrege = sigabbrev_np(s);
+        if (abrege != NULL && strcasecmp(abrege, nom) == 0) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+// Commande interne 'kill [-SIGNAL] %n|pid...' : le signal (SIGTERM par défaut)
+// est envoyé à tous les processus de la tâche. Une tâche arrêtée est aussi
+// relancée, sinon elle ne verrait le signal qu'à sa reprise.
+int commande_kill(char **cmd) {
+    int sig = SIGTERM;
+    int i = 1;
+    if (cmd[i] != NULL && cmd[i][0] == '-') {
+        if ((sig = numero_signal(cmd[i] + 1)) == -1) {
+            fprintf(stderr, "kill: %s : signal inconnu\n", cmd[i] + 1);
+            return 1;
+        }
+        i++;
+    }
+    if (cmd[i] == NULL) {
+        fprintf(stderr, "usage : kill [-SIGNAL] %%tâche|pid...\n");
+        return 1;
+    }
+
+    int retour = 0;
+    for (; cmd[i] != NULL; i++) {
+        if (cmd[i][0] == '%') {
+            Job *job = designer_job(cmd[0], cmd[i]);
+            if (job == NULL) {
+                retour = 1;
+                continue;
+            }
+            if (signaler_job(job, sig) == -1) {
+                perror(cmd[i]);
+                retour = 1;
+            } else if (job->etat == JOB_ARRETE && sig != SIGSTOP && sig != SIGTSTP
+                       && sig != SIGCONT) {
+                reprendre_job(job);
+                signaler_job(job, SIGCONT);
+            }
+            continue;
+        }
+        char *fin;
+        long pid = strtol(cmd[i], &fin, 10);
+        if (fin == cmd[i] || *fin != '\0' || pid <= 0 || kill((pid_t)pid, sig) == -1) {
+            fprintf(stderr, "kill: %s : %s\n", cmd[i], fin == cmd[i] || *fin != '\0' || pid <= 0
+                    ? "argument invalide" : strerror(errno));
+            retour = 1;
+        }
+    }
+    return retour;
+}
+
+
+// ================================================================================================
+// Lancements répétés d'une commande simple (lots de l'option decoupage, parallel)
+// Les redirections sont ouvertes une seule fois : tous les lancements écrivent
+// à la suite dans le même fichier.
+
+// Lance cmd avec les redirections r, par le lanceur choisi. Renvoie le pid,
+// -1 en cas d'échec.
+static pid_t lancer_simple(char **cmd, const Redirections *r) {
+    const char *chemin = chercher_commande(cmd[0]);
+
+    if (option_lanceur == LANCEUR_SPAWN && limites_vides(&limites_commande)) {
+        return lancer_spawn(chemin, cmd, r->entree, r->sortie, r->erreur, -1);
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+    }
+    if (pid == 0) {
+        preparer_enfant(-1);
+        gerer_redirections(r->entree, r->sortie, r->erreur);
+        if (chemin != NULL) {
+            execve(chemin, cmd, environ);
+        }
+        execvp(cmd[0], cmd);
+        perror("execvp");
+        exit(EXIT_FAILURE);
+    }
+    return pid;
+}
+
+// Attend la fin d'au moins un des actifs, par le signalfd de SIGCHLD comme
+// la boucle principale : chaque réveil récupère tous les fils terminés. Pour
+// un actif, fin(pid, status, usage, contexte) est appelée et il est retiré du
+// tableau ; les tâches de fond sont traitées comme d'habitude.
+static void attendre_actifs(pid_t *actifs, int *nb_actifs,
+                            void (*fin)(pid_t, int, struct rusage *, void *), void *contexte) {
+    int termines = 0;
+    while (termines == 0 && *nb_actifs > 0) {
+        int status;
+        struct rusage usage;
+        pid_t pid;
+
+        while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+            int k = 0;
+            while (k < *nb_actifs && actifs[k] != pid) {
+                k++;
+            }
+            if (k < *nb_actifs) {
+                actifs[k] = actifs[--*nb_actifs];
+                fin(pid, status, &usage, contexte);
+                termines++;
+            } else {
+                recuperer_job(pid, status, &usage, stdout);
+            }
+        }
+        if (pid == -1 && errno == ECHILD) {
+            *nb_actifs = 0;  // Plus aucun fils : ne pas attendre indéfiniment
+            return;
+        }
+        if (termines > 0) {
+            return;
+        }
+
+        struct pollfd pfd = {.fd = fd_sigchld, .events = POLLIN};
+        if (poll(&pfd, 1, -1) == -1 && errno != EINTR) {
+            perror("poll");
+            return;
+        }
+        struct signalfd_siginfo info;
+        while (read(fd_sigchld, &info, sizeof(info)) == sizeof(info)) {
+            continue;
+        }
+    }
+}
+
+
+// ================================================================================================
+// Découpage des commandes trop longues (option decoupage)
+// execve échoue avec E2BIG quand les arguments et l'environnement dépassent
+// ARG_MAX, ce qui arrive vite avec "rm *.tmp" dans un grand répertoire. La
+// commande est alors lancée plusieurs fois, comme avec xargs : les mots fixes
+// du début et de la fin (ceux sans joker ni accolade) sont répétés à chaque
+// lot, la liste produite par l'expansion est répartie entre les lots.
+
+// Place prise par un mot dans la zone des arguments d'execve
+static size_t place_mot(const char *mot) {
+    return strlen(mot) + 1 + sizeof(char *);
+}
+
+// Place disponible pour les arguments : ARG_MAX moins l'environnement, avec la
+// marge de 2048 octets que se garde aussi xargs
+size_t place_arguments() {
+    long arg_max = sysconf(_SC_ARG_MAX);
+    size_t env = sizeof(char *);
+    for (char **e = environ; *e != NULL; e++) {
+        env += place_mot(*e);
+    }
+    size_t limite = (arg_max > 0) ? (size_t)arg_max : 131072;
+    return (env + 2048 < limite) ? limite - env - 2048 : 0;
+}
+
+// Mot qui ne change pas à l'expansion
+static int mot_fixe(const char *mot) {
+    return !contient_jokers(mot) && strchr(mot, '{') == NULL;
+}
+
+// Le code de retour est celui du premier lot en échec
+static void fin_lot(pid_t pid, int status, struct rusage *usage, void *contexte) {
+    int *retour = contexte;
+    (void)pid;
+    (void)usage;
+    if (*retour == 0) {
+        *retour = code_retour(status);
+    }
+}
+
+// Lance la commande simple l (au premier plan) par lots de cmd tenant chacun
+// dans place, avec au plus option_paralleles lots en même temps. Renvoie le
+// code de retour du premier lot en échec, 0 si tous ont réussi.
+int executer_par_lots(struct cmdline *l, char **cmd, size_t place) {
+    int nb = 0, debut = 0, fin = 0;
+    while (cmd[nb] != NULL) {
+        nb++;
+    }
+    // Mots fixes en tête (la commande et ses options) et en queue
+    while (l->seq[0][debut] != NULL && mot_fixe(l->seq[0][debut])) {
+        debut++;
+    }
+    if (l->seq[0][debut] != NULL) {
+        int total = debut;
+        while (l->seq[0][total] != NULL) {
+            total++;
+        }
+        while (fin < total - debut && mot_fixe(l->seq[0][total - 1 - fin])) {
+            fin++;
+        }
+    }
+    size_t fixe = sizeof(char *);
+    for (int i = 0; i < debut; i++) {
+        fixe += place_mot(cmd[i]);
+    }
+    for (int i = nb - fin; i < nb; i++) {
+        fixe += place_mot(cmd[i]);
+    }
+    if (debut == 0 || debut + fin >= nb || fixe >= place) {
+        fprintf(stderr, "%s: liste d'arguments trop longue, découpage impossible\n", cmd[0]);
+        return 126;
+    }
+
+    Redirections redir;
+    if (ouvrir_redirections(l, option_atomique, &redir) == -1) {
+        return 1;
+    }
+    char **lot = malloc((nb + 1) * sizeof(char *));
+    pid_t *actifs = malloc(option_paralleles * sizeof(pid_t));
+    int nb_actifs = 0, retour = 0;
+    if (lot == NULL || actifs == NULL) {
+        perror("malloc");
+        retour = 1;
+    } else {
+        memcpy(lot, cmd, debut * sizeof(char *));
+    }
+
+    for (int i = debut; i < nb - fin && lot != NULL && actifs != NULL; ) {
+        // Lot suivant : autant de mots que la place le permet
+        int n = debut;
+        size_t utilise = fixe;
+        while (i < nb - fin && (n == debut || utilise + place_mot(cmd[i]) <= place)) {
+            utilise += place_mot(cmd[i]);
+            lot[n++] = cmd[i++];
+        }
+        memcpy(lot + n, cmd + nb - fin, fin * sizeof(char *));
+        lot[n + fin] = NULL;
+
+        if (nb_actifs == option_paralleles) {
+            attendre_actifs(actifs, &nb_actifs, fin_lot, &retour);
+        }
+        pid_t pid = lancer_simple(lot, &redir);
+        if (pid == -1) {
+            retour = (retour != 0) ? retour : 127;
+            break;
+        }
+        actifs[nb_actifs++] = pid;
+    }
+    while (nb_actifs > 0) {
+        attendre_actifs(actifs, &nb_actifs, fin_lot, &retour);
+    }
+
+    free(lot);
+    free(actifs);
+    publier_redirections(&redir, retour);
+    return retour;
+}
+
+
+// ================================================================================================
+// Commande interne parallel : "parallel [-j N] commande... ::: arguments..."
+// Lance la commande une fois par argument, qui remplace chaque {} de la
+// commande (ou s'ajoute à la fin s'il n'y en a pas), avec au plus N tâches à la
+// fois (par défaut une par processeur). Chaque tâche est inscrite dans la
+// table des tâches ; la suivante est lancée dès qu'une fin arrive sur le
+// signalfd de SIGCHLD. Un bilan est écrit sur la sortie d'erreur à la fin.
+// Code de retour : nombre de tâches en échec, au plus 101, comme GNU parallel.
+
+typedef struct {
+    int lancees;
+    int echecs;
+    struct timeval user, sys;
+} BilanParallel;
+
+static void fin_parallel(pid_t pid, int status, struct rusage *usage, void *contexte) {
+    BilanParallel *bilan = contexte;
+    Job *job = chercher_job_pid(pid);
+    if (code_retour(status) != 0) {
+        bilan->echecs++;
+        fprintf(stderr, "parallel: '%s' en échec (code %d)\n",
+                job ? job->command : "?", code_retour(status));
+    }
+    timeradd(&bilan->user, &usage->ru_utime, &bilan->user);
+    timeradd(&bilan->sys, &usage->ru_stime, &bilan->sys);
+    if (job != NULL && terminer_pid(job, pid, status, usage)) {
+        retirer_job(job);
+    }
+}
+
+// Mot de la commande avec chaque {} remplacé par arg, NULL si pas de {}
+static char *substituer(const char *mot, const char *arg) {
+    const char *p = strstr(mot, "{}");
+    if (p == NULL) {
+        return NULL;
+    }
+    size_t la = strlen(arg), n = 0;
+    for (const char *q = p; q != NULL; q = strstr(q + 2, "{}")) {
+        n++;
+    }
+    char *res = malloc(strlen(mot) + n * la + 1);
+    if (res == NULL) {
+        return NULL;
+    }
+    char *r = res;
+    const char *debut = mot;
+    for (; p != NULL; debut = p + 2, p = strstr(debut, "{}")) {
+        memcpy(r, debut, p - debut);
+        r += p - debut;
+        memcpy(r, arg, la);
+        r += la;
+    }
+    strcpy(r, debut);
+    return res;
+}
+
+int commande_parallel(struct cmdline *l) {
+    char **cmd = expand_command(l->seq[0], l->quoted);
+    if (cmd == NULL) {
+        fprintf(stderr, "parallel: %s\n", strerror(errno));
+        return 1;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int taches = (cpus > 0) ? (int)cpus : 1;
+    int debut = 1;
+    if (cmd[1] != NULL && strcmp(cmd[1], "-j") == 0 && cmd[2] != NULL) {
+        taches = atoi(cmd[2]);
+        debut = 3;
+    }
+    int separateur = debut;
+    while (cmd[separateur] != NULL && strcmp(cmd[separateur], ":::") != 0) {
+        separateur++;
+    }
+    if (taches < 1 || separateur == debut || cmd[separateur] == NULL) {
+        fprintf(stderr, "usage : parallel [-j N] commande... ::: arguments...\n");
+        liberer_mots(cmd);
+        return 2;
+    }
+    int nb_mots = separateur - debut;
+
+    Redirections redir;
+    if (ouvrir_redirections(l, option_atomique, &redir) == -1) {
+        liberer_mots(cmd);
+        return 1;
+    }
+    char **tache = malloc((nb_mots + 2) * sizeof(char *));
+    pid_t *actifs = malloc(taches * sizeof(pid_t));
+    if (tache == NULL || actifs == NULL) {
+        perror("malloc");
+        free(tache);
+        free(actifs);
+        publier_redirections(&redir, 1);
+        liberer_mots(cmd);
+        return 1;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    BilanParallel bilan = {0};
+    int nb_actifs = 0;
+    revalider_chemins();
+    for (int a = separateur + 1; cmd[a] != NULL; a++) {
+        // Argv de la tâche : les mots avec {} sont recopiés, les autres partagés
+        int remplace = 0;
+        for (int i = 0; i < nb_mots; i++) {
+            char *s = substituer(cmd[debut + i], cmd[a]);
+            tache[i] = s ? s : cmd[debut + i];
+            remplace |= (s != NULL);
+        }
+        tache[nb_mots] = remplace ? NULL : cmd[a];
+        tache[nb_mots + 1] = NULL;
+
+        if (nb_actifs == taches) {
+            attendre_actifs(actifs, &nb_actifs, fin_parallel, &bilan);
+        }
+        pid_t pid = lancer_simple(tache, &redir);
+        if (pid != -1) {
+            actifs[nb_actifs++] = pid;
+            bilan.lancees++;
+            // Commande affichée en cas d'échec : la tâche telle que lancée
+            char ligne[256];
+            size_t n = 0;
+            ligne[0] = '\0';
+            for (int i = 0; tache[i] != NULL && n < sizeof(ligne) - 1; i++) {
+                n += snprintf(ligne + n, sizeof(ligne) - n, i ? " %s" : "%s", tache[i]);
+            }
+            ajouter_job(0, &pid, 1, ligne);
+        } else {
+            bilan.echecs++;
+        }
+        for (int i = 0; i < nb_mots; i++) {
+            if (tache[i] != cmd[debut + i]) {
+                free(tache[i]);
+            }
+        }
+    }
+    while (nb_actifs > 0) {
+        attendre_actifs(actifs, &nb_actifs, fin_parallel, &bilan);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    fprintf(stderr, "parallel: %d tâches, %d en échec, durée %.3fs, user %.3fs sys %.3fs\n",
+            bilan.lancees, bilan.echecs,
+            (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9,
+            secondes(bilan.user), secondes(bilan.sys));
+    free(tache);
+    free(actifs);
+    int retour = bilan.echecs > 101 ? 101 : bilan.echecs;
+    publier_redirections(&redir, retour);
+    liberer_mots(cmd);
+    return retour;
+}
+
+
+// ================================================================================================
+// Commandes internes (echo, test, cd...)
+
+// Commande interne qui exécute cmd, NULL pour une commande externe. Les
+// limites (limit, timeout) s'appliquent à un processus : pas d'interne alors.
+static const Interne *interne_pour(char **cmd) {
+    if (!option_internes || cmd[0] == NULL || !limites_vides(&limites_commande)) {
+        return NULL;
+    }
+    return chercher_interne(cmd[0]);
+}
+
+// Exécute la commande interne dans le shell, ses redirections r posées sur 0,
+// 1 et 2 le temps de l'appel (les originaux sont gardés au-dessus de 10).
+// Renvoie son code de retour.
+static int executer_interne(const Interne *interne, char **cmd, const Redirections *r) {
+    int fds[3] = {r->entree, r->sortie, r->erreur};
+    int gardes[3] = {-1, -1, -1};
+    int retour = 1;
+
+    fflush(stdout);
+    fflush(stderr);
+    int k;
+    for (k = 0; k < 3; k++) {
+        if (fds[k] == -1) {
+            continue;
+        }
+        int source = fds[k] == ERREUR_SUR_SORTIE ? STDOUT_FILENO : fds[k];
+        gardes[k] = fcntl(k, F_DUPFD_CLOEXEC, 10);
+        if (gardes[k] == -1 || dup2(source, k) == -1) {
+            perror(cmd[0]);
+            break;
+        }
+    }
+    if (k == 3) {
+        retour = interne->executer(cmd);
+        fflush(stdout);
+        fflush(stderr);
+    }
+    for (k = 2; k >= 0; k--) {
+        if (gardes[k] != -1) {
+            dup2(gardes[k], k);
+            close(gardes[k]);
         }
-        close(fd_in);
     }
+    if (interne->etat_shell && taille_reserve() > 0) {
+        // Les processus de la réserve ont l'ancien répertoire : remplacés
+        int taille = taille_reserve();
+        dimensionner_reserve(0, preparer_enfant);
+        dimensionner_reserve(taille, preparer_enfant);
+    }
+    return retour;
+}
 
-    
-    if (l->out != NULL && l->seq[i + 1] == NULL) {
-        // Redirection de la sortie pour la dernière commande
-        int fd_out = open(l->out, O_WRONLY | O_CREAT, 0644);
-        if (fd_out == -1) {
-            perror("open (output file)");
-            exit(EXIT_FAILURE);
-        }
-        if (ftruncate(fd_out, 0) == -1) {
-            perror("ftruncate");
-            exit(EXIT_FAILURE);
+// Dans un pipeline ou en arrière-plan, une commande interne a son processus,
+// mais sans exec. Renvoie le pid, -1 en cas d'échec.
+static pid_t lancer_interne(const Interne *interne, char **cmd, int entree, int sortie,
+                            int erreur, pid_t pgid, int (*pipes)[2], int nb_pipes,
+                            Redirections *r) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+    }
+    if (pid == 0) {
+        preparer_enfant(pgid);
+        gerer_redirections(entree, sortie, erreur);
+        // Sans exec, O_CLOEXEC ne ferme rien : les autres étapes ne doivent
+        // pas attendre la fin de celle-ci pour voir la fin de leur pipe
+        for (int j = 0; j < nb_pipes; j++) {
+            close(pipes[j][0]);
+            close(pipes[j][1]);
         }
-        if (dup2(fd_out, STDOUT_FILENO) == -1) {
-            perror("dup2 (output file)");
-            exit(EXIT_FAILURE);
+        fermer_redirections(r);
+        if (r->sortie != -1) {
+            close(r->sortie);
         }
-        close(fd_out);
+        int statut = interne->executer(cmd);
+        fflush(stdout);
+        fflush(stderr);
+        _exit(statut);
     }
+    return pid;
 }
 
-// ================================================================================================
-// Fonction pour exécuter une commande enfant
-void executer_enfant(char **cmd) {
-    execvp(cmd[0], cmd);
-    perror("execvp");
-    exit(EXIT_FAILURE);
-}
 
+// Lance le pipeline l, préfixes de limites déjà retirés. Renvoie le code de
+// retour de la dernière étape (0 pour une commande lancée en arrière-plan).
+static int executer_pipeline(struct cmdline *l) {
 
-// =================================================================================================
-// Question 8  : Jokers étendus (Jocker en glob)
+    // QUESTION 5 : Pipe
+    // Tout le travail qui ne dépend pas des processus est fait avant le premier
+    // lancement : expansion des jokers de chaque étape puis création des pipes.
+    // La boucle de lancement ne fait plus que des spawn/fork à la suite.
 
+    int n = 0;
+    while (l->seq[n] != NULL) {
+        n++;
+    }
 
-// Fonction pour gérer l'expansion des jokers et des accolades dans une commande
-char **expand_command(char **cmd) {
-    glob_t glob_result;
-    int glob_flags = GLOB_NOCHECK | GLOB_TILDE; // Flags pour gérer les jokers et le tilde
-    char **expanded_cmd = NULL;
-    size_t expanded_count = 0;
-
-    // Initialiser glob_result
-    memset(&glob_result, 0, sizeof(glob_result));
-
-    // Expansion des accolades avant d'appeler glob
-    for (int i = 0; cmd[i] != NULL; i++) {
-        char *brace_expanded = NULL;
-        if (strchr(cmd[i], '{') != NULL && strchr(cmd[i], '}') != NULL) {
-            // Gérer les accolades manuellement
-            char *brace_pos = strchr(cmd[i], '{');
-            char *brace_end = strchr(cmd[i], '}');
-            if (brace_pos && brace_end && brace_end > brace_pos) {
-                size_t prefix_len = brace_pos - cmd[i];
-                size_t suffix_len = strlen(brace_end + 1);
-
-                char *inside_braces = strndup(brace_pos + 1, brace_end - brace_pos - 1);
-                char *token = strtok(inside_braces, ",");
-                while (token != NULL) {
-                    size_t new_len = prefix_len + strlen(token) + suffix_len + 1;
-                    brace_expanded = malloc(new_len);
-                    if (!brace_expanded) {
-                        perror("malloc");
-                        free(inside_braces);
-                        globfree(&glob_result);
-                        return expanded_cmd; // En cas d'échec, retourner la commande d'origine
-                    }
-                    snprintf(brace_expanded, new_len, "%.*s%s%s", (int)prefix_len, cmd[i], token, brace_end + 1);
-                    
-                    char **temp_cmd = realloc(expanded_cmd, sizeof(char *) * (expanded_count + 2));
-                    if (!temp_cmd) {
-                        perror("realloc");
-                        free(brace_expanded);
-                        free(inside_braces);
-                        globfree(&glob_result);
-                        for (size_t j = 0; j < expanded_count; j++) {
-                            free(expanded_cmd[j]);
-                        }
-                        free(expanded_cmd);
-                        return cmd; // En cas d'échec, retourner la commande d'origine
-                    }
-                    expanded_cmd = temp_cmd;
-                    expanded_cmd[expanded_count++] = brace_expanded;
-                    token = strtok(NULL, ",");
-                }
-                free(inside_braces);
-                continue;
-            }
-        }
+    char ***cmds = malloc(n * sizeof(char **));
+    int (*pipes)[2] = malloc((n > 1 ? n - 1 : 1) * sizeof(int[2]));
+    pid_t *pids = malloc(n * sizeof(pid_t));
+    int num_pids = 0;
+    if (cmds == NULL || pipes == NULL || pids == NULL) {
+        perror("malloc");
+        free(cmds);
+        free(pipes);
+        free(pids);
+        return 1;
+    }
 
-        // Ajouter la commande telle quelle si aucune accolade n'est présente
-        char **temp_cmd = realloc(expanded_cmd, sizeof(char *) * (expanded_count + 2));
-        if (!temp_cmd) {
-            perror("realloc");
-            globfree(&glob_result);
-            for (size_t j = 0; j < expanded_count; j++) {
-                free(expanded_cmd[j]);
+    for (int i = 0; i < n; i++) {
+        // Expansion des jokers pour chaque commande
+        cmds[i] = expand_command(l->seq[i], l->quoted);
+        if (cmds[i] == NULL) {
+            fprintf(stderr, "expansion: %s\n", strerror(errno));
+            while (i-- > 0) {
+                liberer_mots(cmds[i]);
             }
-            free(expanded_cmd);
-            return cmd; // En cas d'échec, retourner la commande d'origine
+            free(cmds);
+            free(pipes);
+            free(pids);
+            return 1;
         }
-        expanded_cmd = temp_cmd;
-        expanded_cmd[expanded_count++] = strdup(cmd[i]);
     }
-    expanded_cmd[expanded_count] = NULL;
-
-    // Expansion des jokers pour chaque argument
-    for (int i = 0; expanded_cmd[i] != NULL; i++) {
-        int glob_status;
-        if (i == 0) {
-            // Pour le premier argument, on initie glob
-            glob_status = glob(expanded_cmd[i], glob_flags, NULL, &glob_result);
+    marquer(PHASE_EXPANSION);
+
+    // Commande simple trop longue pour execve : lancée par lots si l'option
+    // decoupage le permet, sinon refusée avant même d'essayer
+    size_t place = place_arguments();
+    for (int i = 0; i < n; i++) {
+        size_t utilise = sizeof(char *);
+        if (interne_pour(cmds[i]) != NULL) {
+            continue;   // Pas d'execve
+        }
+        for (int j = 0; cmds[i][j] != NULL && utilise <= place; j++) {
+            utilise += place_mot(cmds[i][j]);
+        }
+        if (utilise <= place) {
+            continue;
+        }
+        int retour = 126;
+        if (!option_decoupage) {
+            fprintf(stderr, "%s: liste d'arguments trop longue (voir 'option decoupage on')\n",
+                    cmds[i][0]);
+        } else if (n > 1 || l->bg) {
+            fprintf(stderr, "%s: découpage possible seulement pour une commande simple au premier plan\n",
+                    cmds[i][0]);
         } else {
-            // Pour les arguments suivants, on ajoute au résultat existant
-            glob_status = glob(expanded_cmd[i], glob_flags | GLOB_APPEND, NULL, &glob_result);
+            revalider_chemins();
+            retour = executer_par_lots(l, cmds[0], place);
+        }
+        for (int j = 0; j < n; j++) {
+            liberer_mots(cmds[j]);
         }
+        free(cmds);
+        free(pipes);
+        free(pids);
+        return retour;
+    }
 
-        if (glob_status != 0) {
-            perror("glob");
-            globfree(&glob_result);
-            for (size_t j = 0; j < expanded_count; j++) {
-                free(expanded_cmd[j]);
-            }
-            free(expanded_cmd);
-            return cmd; // En cas d'échec, retourner la commande d'origine
+    // Fichiers des redirections, ouverts par le shell : les étapes les
+    // reçoivent comme des pipes
+    Redirections redir;
+    if (ouvrir_redirections(l, option_atomique, &redir) == -1) {
+        for (int i = 0; i < n; i++) {
+            liberer_mots(cmds[i]);
         }
+        free(cmds);
+        free(pipes);
+        free(pids);
+        return 1;
     }
 
-    // Libérer les anciennes commandes après l'expansion
-    for (int i = 0; expanded_cmd[i] != NULL; i++) {
-        free(expanded_cmd[i]);
+    // Commande interne seule au premier plan : ni processus ni tâche
+    const Interne *interne = (n == 1 && !l->bg) ? interne_pour(cmds[0]) : NULL;
+    if (interne != NULL) {
+        marquer(PHASE_LANCEMENT);
+        int retour = executer_interne(interne, cmds[0], &redir);
+        publier_redirections(&redir, retour);
+        marquer(PHASE_ATTENTE);
+        liberer_mots(cmds[0]);
+        free(cmds);
+        free(pipes);
+        free(pids);
+        return retour;
     }
-    free(expanded_cmd);
 
-    return glob_result.gl_pathv; // Retourner les chemins expansés
-}
+    for (int i = 0; i < n - 1; i++) {
+        // Un pipe entre chaque paire de commandes, fermé automatiquement à l'exec
+        if (pipe2(pipes[i], O_CLOEXEC) == -1) {
+            perror("pipe");
+            exit(EXIT_FAILURE);
+        }
+    }
+    marquer(PHASE_PIPES);
+
+    // Une étape qui ne fait que recopier (cat, tee) est assurée par le shell
+    // lui-même, après le lancement des autres : pas de processus ni de copie
+    // en espace utilisateur. Seulement au premier plan, le shell y est bloqué,
+    // et sans contrôle des tâches : un Ctrl-Z n'arrêterait pas le shell. Ni
+    // avec timeout ou limit, qui ne s'appliquent qu'à des processus fils.
+    int etape_shell = -1;
+    if (option_transfert && !l->bg && !controle_jobs && limites_vides(&limites_commande)
+        && limites_commande.temps == 0) {
+        etape_shell = chercher_etape_transfert(l, cmds, n);
+    }
 
+    // posix_spawn ne sait pas poser de limites : fork dans ce cas
+    int par_fork = option_lanceur == LANCEUR_FORK || !limites_vides(&limites_commande);
+    if (par_fork) {
+        fflush(stdout); // Ne pas dupliquer le tampon de stdout dans les enfants
+    }
 
+    // Les exécutables sont cherchés par le shell, dans son cache, plutôt que
+    // par execvp dans chaque enfant (un execve raté par répertoire du PATH)
+    revalider_chemins();
+
+    // Groupe de processus propre au pipeline, créé par sa première étape : en
+    // arrière-plan il ne reçoit pas le Ctrl-C du terminal, et avec le contrôle
+    // des tâches le terminal lui est donné au premier plan
+    int groupe = controle_jobs || l->bg;
+    pid_t pgid = groupe ? 0 : -1;
+    int par_reserve = 0;
+
+    for (int i = 0; i < n; i++) {
+        int input_fd = (i > 0) ? pipes[i - 1][0] : redir.entree;
+        int output_fd = (i < n - 1) ? pipes[i][1] : redir.sortie;
+        int error_fd = (i == redir.etape_erreur) ? redir.erreur : -1;
+        pid_t pid;
 
-// ================================================================================================
-// Question 10  : Signaux
+        if (i == etape_shell) {
+            continue;
+        }
 
-// Gestionnaire de signal pour SIGCHLD
-void gestionnaire_sigchld(int sig) {
-    (void)sig; // Ignorer l'argument du signal
-    int status;
-    pid_t pid;
+        const Interne *interne = interne_pour(cmds[i]);
+        const char *chemin = interne ? NULL : chercher_commande(cmds[i][0]);
+        pid = -1;
+        if (interne != NULL) {
+            pid = lancer_interne(interne, cmds[i], input_fd, output_fd, error_fd, pgid,
+                                 pipes, n - 1, &redir);
+        } else if (!par_fork && taille_reserve() > 0) {
+            pid = lancer_par_reserve(chemin, cmds[i], input_fd, output_fd, error_fd, pgid);
+            par_reserve |= pid != -1;
+        }
+        if (pid != -1 || interne != NULL) {
+            // Commande interne, ou lancée par la réserve
+        } else if (!par_fork) {
+            pid = lancer_spawn(chemin, cmds[i], input_fd, output_fd, error_fd, pgid);
+        } else {
+            // Avec time, un tube témoin fermé par l'exec de l'enfant sépare
+            // le fork de l'exec (posix_spawn ne rend la main qu'après l'exec)
+            int temoin[2] = {-1, -1};
+            if (chrono.format != TIME_AUCUN && pipe2(temoin, O_CLOEXEC) == -1) {
+                temoin[0] = -1;
+            }
+            pid = fork();
+            if (pid == -1) {
+                perror("fork");
+                exit(EXIT_FAILURE);
+            }
+            if (pid == 0) {
+                // Processus enfant : gestion des redirections et des pipes
+                preparer_enfant(pgid);
+                gerer_redirections(input_fd, output_fd, error_fd);
+                if (chemin != NULL) {
+                    execve(chemin, cmds[i], environ);
+                    // ENOEXEC (script sans #!) : execvp sait le passer à /bin/sh
+                }
+                execvp(cmds[i][0], cmds[i]);
+                perror("execvp");
+                exit(EXIT_FAILURE);
+            }
+            if (temoin[0] != -1) {
+                char c;
+                close(temoin[1]);
+                marquer(PHASE_LANCEMENT);
+                while (read(temoin[0], &c, 1) == -1 && errno == EINTR) {
+                }
+                close(temoin[0]);
+                marquer(PHASE_EXEC);
+            }
+        }
 
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        for (int i = 0; i < job_count; i++) {
-            if (jobs[i].pid == pid) {
-                printf("[Processus %d terminé]\n", pid);
-                free(jobs[i].command);
-                for (int j = i; j < job_count - 1; j++) {
-                    jobs[j] = jobs[j + 1];
+        if (pid != -1) {
+            pids[num_pids++] = pid;
+            if (groupe) {
+                // Aussi dans le parent : le groupe existe avant l'étape suivante
+                setpgid(pid, pgid == 0 ? pid : pgid);
+                if (pgid == 0) {
+                    pgid = pid;
+                    if (controle_jobs && !l->bg) {
+                        tcsetpgrp(STDIN_FILENO, pgid);
+                    }
                 }
-                job_count--;
-                break;
             }
         }
     }
-}
 
+    marquer(PHASE_LANCEMENT);
 
-// ================================================================================================
-
-
-// Fonction pour exécuter une commande
-void executer_command(struct cmdline *l) {
-    if (l == NULL || l->seq == NULL || l->seq[0] == NULL) {
-        return;
+    // Processus parent : fermer toutes les extrémités des pipes, sauf celles
+    // de l'étape assurée par le shell, qui les ferme à la fin du transfert
+    // (elle reçoit une copie des fichiers de redirection)
+    for (int i = 0; i < n - 1; i++) {
+        if (i != etape_shell - 1) {
+            close(pipes[i][0]);
+        }
+        if (i != etape_shell) {
+            close(pipes[i][1]);
+        }
     }
+    int transfert_entree = -1, transfert_sortie = -1;
+    if (etape_shell != -1) {
+        transfert_entree = etape_shell > 0 ? pipes[etape_shell - 1][0]
+                           : redir.entree != -1 ? fcntl(redir.entree, F_DUPFD_CLOEXEC, 0) : -1;
+        transfert_sortie = etape_shell < n - 1 ? pipes[etape_shell][1]
+                           : redir.sortie != -1 ? fcntl(redir.sortie, F_DUPFD_CLOEXEC, 0) : -1;
+    }
+    fermer_redirections(&redir);
+    int statut_shell = 0;
+    if (etape_shell != -1) {
+        statut_shell = executer_etape_transfert(cmds[etape_shell], transfert_entree,
+                                                transfert_sortie);
+        marquer(PHASE_ATTENTE);
+    }
+    free(pipes);
+    for (int i = 0; i < n; i++) {
+        liberer_mots(cmds[i]);
+    }
+    free(cmds);
 
-    // QUESTION 5 : Pipe
-
-    int i = 0;
-    int pipefd[2] = {-1, -1}; // Initialisation du pipe à des valeurs non valides
-    int input_fd = -1;        // Le descripteur d'entrée initial est nul (-1)
-    pid_t pids[MAX_JOBS];
-    int num_pids = 0;
-
-    while (l->seq[i] != NULL) {
-        // Expansion des jokers pour la commande actuelle
-        char **cmd = expand_command(l->seq[i]);
-        pid_t pid;
+    // Attendre la fin de tous les processus enfants, sauf si en arrière-plan
+    // Code de retour : celui de la dernière étape, 127 si elle n'a pas pu être lancée
+    int retour = (etape_shell == n - 1) ? statut_shell : 127;
+    pid_t dernier = (num_pids > 0 && etape_shell != n - 1) ? pids[num_pids - 1] : -1;
 
-        if (l->seq[i + 1] != NULL) {
-            // Créer un pipe si une autre commande suit
-            if (pipe(pipefd) == -1) {
-                perror("pipe");
-                exit(EXIT_FAILURE);
+    if (trace_commande != NULL) {
+        noter_pids(trace_commande, pids, num_pids);
+    }
+    if (num_pids == 0) {
+        free(pids);
+        publier_redirections(&redir, retour);
+        marquer(PHASE_ATTENTE);
+        return retour;
+    }
+    // Chaque pipeline est une tâche, même au premier plan : il peut être arrêté
+    // puis repris par fg ou bg
+    char *texte = texte_commande(l);
+    Job *job = texte ? ajouter_job(groupe ? pgid : 0, pids, num_pids, texte) : NULL;
+    free(texte);
+    if (job == NULL) {
+        perror("ajouter_job");
+    } else {
+        // Le cgroupe et l'enregistrement de trace vivent désormais avec la
+        // tâche (sauf si le shell assure la dernière étape : c'est lui qui
+        // donne le statut)
+        job->cgroupe = limites_commande.cgroupe;
+        limites_commande.cgroupe = NULL;
+        if (dernier != -1) {
+            job->trace = trace_commande;
+            trace_commande = NULL;
+            if (redir.cible != NULL && (job->ecriture = garder_redirections(&redir)) != NULL) {
+                redir.cible = NULL;
+                redir.sortie = -1;
             }
         }
-
-        pid = fork();
-        if (pid == -1) {
-            perror("fork");
-            exit(EXIT_FAILURE);
+        if (limites_commande.temps > 0) {
+            armer_echeance(job, &job->debut, limites_commande.temps);
         }
-
-        if (pid == 0) {
-            // Processus enfant : gestion des redirections et des pipes
-            gerer_redirections(l, i, input_fd, pipefd);
-            execvp(cmd[0], cmd);
-            perror("execvp");
-            exit(EXIT_FAILURE);
-        } else {
-            // Processus parent
-            pids[num_pids++] = pid;
-
-            // Fermer les descripteurs inutilisés
-            if (input_fd != -1) {
-                close(input_fd);
-            }
-            if (l->seq[i + 1] != NULL) {
-                close(pipefd[1]); // Fermer le côté écriture du pipe dans le parent
-                input_fd = pipefd[0]; // Garder le côté lecture du pipe pour la prochaine commande
+    }
+    marquer(PHASE_LANCEMENT);
+    if (par_reserve) {
+        // Les remplaçants sont créés pendant que la commande s'exécute
+        completer_reserve();
+    }
+    if (l->bg) {
+        retour = 0;
+        if (job != NULL) {
+            printf("[%d] [Processus en tâche de fond lancé: PID %d]\n", job->id, job->pid);
+        }
+    } else if (job != NULL) {
+        int arrete;
+        int code = attendre_premier_plan(job, 0, &arrete);
+        if (arrete || dernier != -1) {
+            retour = code;
+        }
+    } else {
+        if (controle_jobs) {
+            tcsetpgrp(STDIN_FILENO, pgid);
+        }
+        for (int j = 0; j < num_pids; j++) {
+            int status;
+            struct rusage usage;
+            if (wait4(pids[j], &status, 0, &usage) == pids[j] && pids[j] == dernier) {
+                retour = code_retour(status);
             }
         }
-        i++;
+        if (controle_jobs) {
+            tcsetpgrp(STDIN_FILENO, pgid_shell);
+        }
+    }
+    // Sortie atomique qui n'a pas été confiée à la tâche
+    publier_redirections(&redir, retour);
+    marquer(PHASE_ATTENTE);
+    free(pids);
+    return retour;
+}
+
+// Fonction pour exécuter une commande, précédée éventuellement des préfixes
+// time, puis timeout et limit (voir limites.h). Renvoie le code de retour de
+// la dernière étape (0 pour une commande lancée en arrière-plan).
+int executer_command(struct cmdline *l) {
+    if (l == NULL || l->seq == NULL || l->seq[0] == NULL) {
+        return 0;
     }
+    ignorer_phase();   // Affichage de débogage de la ligne
 
-    // Attendre la fin de tous les processus enfants, sauf si en arrière-plan
-    if (!l->bg) {
-        for (int j = 0; j < num_pids; j++) {
-            waitpid(pids[j], NULL, 0);
-        }
+    int k = lire_time(l->seq[0]);
+    if (k > 0 && l->seq[0][k] == NULL) {
+        fprintf(stderr, "time: commande manquante\n");
+        return 2;
+    }
+    l->seq[0] += k;
+    k = lire_limites(l->seq[0], &limites_commande);
+    if (k == -1) {
+        return 2;
+    }
+    if (l->seq[0][k] == NULL) {
+        fprintf(stderr, "%s: commande manquante\n", l->seq[0][0]);
+        return 2;
+    }
+    l->seq[0] += k;
+    if (trace_active) {
+        trace_commande = commencer_trace(l);
+    }
+
+    int retour;
+    if (limites_commande.cpus > 0 && !option_cgroupes) {
+        fprintf(stderr, "limit: cpus demande 'option cgroupes on'\n");
+        retour = 2;
+    } else if (option_cgroupes && (limites_commande.cpus > 0 || limites_commande.memoire > 0)
+               && creer_cgroupe(&limites_commande) == -1 && limites_commande.cpus > 0) {
+        retour = 126;   // Sans cgroupe, mem reste posée par setrlimit
     } else {
-        ajouter_job(pids[num_pids - 1], l->seq[0][0]);
-        printf("[Processus en tâche de fond lancé: PID %d]\n", pids[num_pids - 1]);
+        retour = executer_pipeline(l);
+    }
+
+    liberer_limites(&limites_commande);
+    if (limites_commande.cgroupe != NULL) {
+        // Pas de tâche pour le garder : ses processus sont terminés
+        rmdir(limites_commande.cgroupe);
+        free(limites_commande.cgroupe);
+    }
+    memset(&limites_commande, 0, sizeof(limites_commande));
+    limites_commande.fd_procs = -1;
+    if (trace_commande != NULL) {
+        // Sans tâche (commande refusée, lancée par lots...) : publiée tout de suite
+        finir_trace(trace_commande, retour, &chrono.usage);
+        trace_commande = NULL;
     }
+    if (chrono.format != TIME_AUCUN) {
+        afficher_time(retour);
+    }
+    return retour;
 }
 
 
@@ -398,6 +1975,7 @@ int question6_executer(char *line)
 
     if (pid == 0) {
         // Processus enfant : exécuter la commande
+        preparer_enfant(-1);
         execvp(cmd->seq[0][0], cmd->seq[0]);
         perror("execvp"); // Si execvp échoue
         exit(EXIT_FAILURE);
@@ -435,100 +2013,427 @@ void terminate(char *line) {
 
 
 // ================================================================================================
+// Mode script : "ensishell script.sh" ou "ensishell -c 'commandes'"
+// Pas d'invite, d'historique ni d'affichage de la ligne analysée ; les lignes
+// sont découpées sur place dans un tampon qui contient toute l'entrée.
 
-int main() {
-        printf("Variante %d: %s\n", VARIANTE, VARIANTE_STRING);
+int mode_script = 0;
 
 #if USE_GUILE == 1
+// Guile est long à démarrer : en mode script, on ne l'initialise qu'à la
+// première ligne Scheme
+static void initialiser_guile() {
+    static int initialise = 0;
+    if (!initialise) {
         scm_init_guile();
         /* register "executer" function in scheme */
         scm_c_define_gsubr("executer", 1, 0, 0, executer_wrapper);
+        initialise = 1;
+    }
+}
 #endif
 
-    // ------Définir le gestionnaire pour SIGCHLD pour la terminaison asynchrone
-    struct sigaction sa;
-    sa.sa_handler = gestionnaire_sigchld;
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
-    if (sigaction(SIGCHLD, &sa, NULL) == -1) {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+// Tant que la ligne s'arrête au milieu d'une structure (if sans fi...), lit
+// la suite avec l'invite "> " et l'ajoute après une fin de ligne
+static char *completer_ligne(char *line) {
+    while (texte_incomplet(line)) {
+        char *suite = lire_ligne("> ");
+        char *tout;
+        if (suite == NULL) {
+            break;  // Fin de l'entrée : l'erreur sera signalée à la compilation
+        }
+        if (asprintf(&tout, "%s\n%s", line, suite) == -1) {
+            free(suite);
+            break;
+        }
+        free(line);
+        free(suite);
+        line = tout;
     }
+    return line;
+}
 
-	while (1) {
-		struct cmdline *l;
-		char *line=0;
-		int i, j;
-		char *prompt = "ensishell>";
+static int executer_analysee(struct cmdline *l);
 
-		//************** Vérifier les processus en tâche de fond **************
-        verifier_jobs();
+// Pipeline d'un programme compilé (voir controle.h), traité comme une ligne :
+// exit, jobs, commandes internes, time. l est rendu intact pour l'itération
+// suivante (executer_command retire de seq[0] les préfixes time et limit).
+static int executer_dans_programme(struct cmdline *l) {
+    char **premiere = l->seq[0];
+    int statut = 0;
 
-		/* Readline use some internal memory structure that
-		   can not be cleaned at the end of the program. Thus
-		   one memory leak per command seems unavoidable yet */
-		line = readline(prompt);
-		if (line == 0 || ! strncmp(line,"exit", 4)) {
-			terminate(line);
-		}
+    if (strcmp(premiere[0], "exit") == 0) {
+        if (mode_script) {
+            exit(premiere[1] ? atoi(premiere[1]) : 0);
+        }
+        terminate(NULL);
+    }
+    if (strcmp(premiere[0], "jobs") == 0 && l->seq[1] == NULL) {
+        lister_jobs();
+    } else {
+        debuter_chrono();
+        marquer(PHASE_ANALYSE);     // Déjà faite à la compilation
+        statut = executer_analysee(l);
+        l->seq[0] = premiere;
+    }
+    traiter_sigchld(stdout);
+    traiter_echeances(stdout);
+    return statut;
+}
+
+// Exécute une ligne lue. En mode interactif la ligne vient de readline et
+// appartient à cette fonction ; en mode script elle appartient au tampon du
+// script. Renvoie le code de retour de la commande.
+int traiter_ligne(char *line) {
+    struct cmdline *l;
+    int i, j;
+
+    if (! strncmp(line,"exit", 4)) {
+        if (mode_script) {
+            exit(line[4] ? atoi(line + 4) : 0);
+        }
+        terminate(line);
+    }
 
-		//*********** Vérifier si la commande est 'jobs' ***************
-        if (strcmp(line, "jobs") == 0) {
-            lister_jobs();  // Appeler la fonction qui liste les jobs
+    //*********** Vérifier si la commande est 'jobs' ***************
+    if (strcmp(line, "jobs") == 0) {
+        lister_jobs();  // Appeler la fonction qui liste les jobs
+        if (!mode_script) {
             free(line);
-            continue;  // Retourner au prompt
         }
+        return 0;
+    }
+
+    // Structure sur plusieurs lignes : la suite est demandée
+    if (!mode_script) {
+        line = completer_ligne(line);
+    }
 
 #if USE_GNU_READLINE == 1
-		add_history(line);
+    if (!mode_script) {
+        add_history(line);
+    }
 #endif
-
+    if (!mode_script) {
+        ajouter_historique(line);
+    }
 
 #if USE_GUILE == 1
-		/* The line is a scheme command */
-		if (line[0] == '(') {
-			char catchligne[strlen(line) + 256];
-			sprintf(catchligne, "(catch #t (lambda () %s) (lambda (key . parameters) (display \"mauvaise expression/bug en scheme\n\")))", line);
-			scm_eval_string(scm_from_locale_string(catchligne));
-			free(line);
-                        continue;
-                }
+    /* The line is a scheme command */
+    if (line[0] == '(') {
+        char catchligne[strlen(line) + 256];
+        initialiser_guile();
+        sprintf(catchligne, "(catch #t (lambda () %s) (lambda (key . parameters) (display \"mauvaise expression/bug en scheme\n\")))", line);
+        scm_eval_string(scm_from_locale_string(catchligne));
+        if (!mode_script) {
+            free(line);
+        }
+        return 0;
+    }
 #endif
 
-		/* parsecmd free line and set it up to 0 */
-		l = parsecmd( & line);
+    //*********** Structures de contrôle (;, &&, ||, if, while, for) ***************
+    if (besoin_controle(line)) {
+        const Programme *p = compiler_programme(line);
+        int statut = p ? executer_programme(p, executer_dans_programme, expand_command) : 2;
+        if (!mode_script) {
+            free(line);
+        }
+        return statut;
+    }
 
-		/* If input stream closed, normal termination */
-		if (!l) {
-		  
-			terminate(0);
-		}
-		
+    debuter_chrono();
+    if (mode_script) {
+        l = parsecmd_line(line);
+    } else {
+        /* parsecmd free line and set it up to 0 */
+        l = parsecmd( & line);
+    }
+    marquer(PHASE_ANALYSE);
 
-		
-		if (l->err) {
-			/* Syntax error, read another command */
-			printf("error: %s\n", l->err);
-			continue;
-		}
+    /* If input stream closed, normal termination */
+    if (!l) {
+        terminate(0);
+    }
+
+    if (l->err) {
+        /* Syntax error, read another command */
+        printf("error: %s\n", l->err);
+        return 2;
+    }
+
+    if (!mode_script) {
+        if (l->in) printf("in: %s\n", l->in);
+        if (l->out) printf("out: %s%s\n", l->out, l->append ? " (ajout)" : "");
+        if (l->errout) printf("err: %s%s\n", l->errout, l->errappend ? " (ajout)" : "");
+        if (l->bg) printf("background (&)\n");
+
+        /* Display each command of the pipe */
+        for (i=0; l->seq[i]!=0; i++) {
+            char **cmd = l->seq[i];
+            printf("seq[%d]: ", i);
+            for (j=0; cmd[j]!=0; j++) {
+                printf("'%s' ", cmd[j]);
+            }
+            printf("\n");
+        }
+    }
+
+    return executer_analysee(l);
+}
+
+// Commandes internes du shell, puis exécution de la ligne l déjà analysée.
+// Renvoie le code de retour.
+static int executer_analysee(struct cmdline *l) {
+    //*********** Commande interne 'option' ***************
+    if (l->seq[0] != NULL && strcmp(l->seq[0][0], "option") == 0) {
+        commande_option(l->seq[0]);
+        return 0;
+    }
+
+    //*********** Commande interne 'parallel' ***************
+    if (l->seq[0] != NULL && l->seq[1] == NULL && !l->bg
+        && strcmp(l->seq[0][0], "parallel") == 0) {
+        return commande_parallel(l);
+    }
+
+    //*********** Commandes internes 'fg', 'bg' et 'kill' ***************
+    if (l->seq[0] != NULL && l->seq[1] == NULL) {
+        if (strcmp(l->seq[0][0], "fg") == 0) {
+            return commande_fg(l->seq[0]);
+        }
+        if (strcmp(l->seq[0][0], "bg") == 0) {
+            return commande_bg(l->seq[0]);
+        }
+        if (strcmp(l->seq[0][0], "kill") == 0) {
+            return commande_kill(l->seq[0]);
+        }
+    }
+
+    //*********** Commande interne 'ulimit' ***************
+    if (l->seq[0] != NULL && l->seq[1] == NULL && strcmp(l->seq[0][0], "ulimit") == 0) {
+        return commande_ulimit(l->seq[0]);
+    }
+
+    //*********** Commande interne 'trace' ***************
+    if (l->seq[0] != NULL && l->seq[1] == NULL && strcmp(l->seq[0][0], "trace") == 0) {
+        return commande_trace(l->seq[0]);
+    }
+
+    //*********** Commande interne 'history' ***************
+    if (l->seq[0] != NULL && l->seq[1] == NULL && strcmp(l->seq[0][0], "history") == 0) {
+        return commande_history(l->seq[0]);
+    }
+
+    //*********** Commande interne 'pool' ***************
+    if (l->seq[0] != NULL && l->seq[1] == NULL && strcmp(l->seq[0][0], "pool") == 0) {
+        return commande_pool(l->seq[0], preparer_enfant);
+    }
+
+    //*********** Commande interne 'hash' ***************
+    if (l->seq[0] != NULL && l->seq[1] == NULL && strcmp(l->seq[0][0], "hash") == 0) {
+        return commande_hash(l->seq[0]);
+    }
+
+    //============================================================================================
+    // Execution de la commande
+    return executer_command(l);
+}
+
+// Charge tout le fichier en mémoire, terminé par '\0' : projection privée
+// (modifiable sans toucher au fichier) pour un fichier ordinaire, lecture par
+// blocs de 64 Ko sinon (tube, terminal). Renvoie NULL en cas d'erreur.
+static char *charger_script(const char *chemin, size_t *taille, int *projete) {
+    int fd = open(chemin, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat st;
+    *projete = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        // L'octet qui suit la fin du fichier doit être dans la projection :
+        // c'est le cas sauf si le fichier occupe exactement des pages entières
+        long page = sysconf(_SC_PAGESIZE);
+        if (st.st_size % page != 0) {
+            char *buf = mmap(NULL, st.st_size + 1, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE, fd, 0);
+            if (buf != MAP_FAILED) {
+                madvise(buf, st.st_size, MADV_SEQUENTIAL);
+                close(fd);
+                buf[st.st_size] = '\0';
+                *taille = st.st_size;
+                *projete = 1;
+                return buf;
+            }
+        }
+    }
+
+    size_t capacite = 1 << 16, lus = 0;
+    char *buf = malloc(capacite + 1);
+    while (buf != NULL) {
+        ssize_t n = read(fd, buf + lus, capacite - lus);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == -1) {
+                free(buf);
+                buf = NULL;
+            }
+            break;
+        }
+        lus += n;
+        if (lus == capacite) {
+            capacite *= 2;
+            char *plus = realloc(buf, capacite + 1);
+            if (plus == NULL) {
+                free(buf);
+            }
+            buf = plus;
+        }
+    }
+    close(fd);
+    if (buf != NULL) {
+        buf[lus] = '\0';
+        *taille = lus;
+    }
+    return buf;
+}
+
+// Exécute les lignes de texte[0..taille[, texte[taille] valant '\0'.
+// Les lignes vides et les commentaires (#) sont sautés. Renvoie le code de
+// retour de la dernière commande.
+static int executer_script(char *texte, size_t taille) {
+    char *fin = texte + taille;
+    int statut = 0;
+
+    for (char *ligne = texte; ligne < fin; ) {
+        char *nl = memchr(ligne, '\n', fin - ligne);
+        char *eol = nl ? nl : fin;
+        *eol = '\0';
+
+        char *debut = ligne + strspn(ligne, " \t");
+        if (*debut != '\0' && *debut != '#') {
+            // Structure sur plusieurs lignes : réunie jusqu'à sa fin
+            while (nl != NULL && texte_incomplet(ligne)) {
+                *eol = '\n';
+                nl = memchr(eol + 1, '\n', fin - eol - 1);
+                eol = nl ? nl : fin;
+                *eol = '\0';
+            }
+            statut = dernier_statut = traiter_ligne(ligne);
+        }
+        // Fins de tâches en attente : un seul read sur le signalfd s'il n'y
+        // en a pas ; puis échéances des tâches de fond dépassées
+        traiter_sigchld(stdout);
+        traiter_echeances(stdout);
+        ligne = eol + 1;
+    }
+    return statut;
+}
+
+#if USE_GNU_READLINE == 1
+#define HISTORIQUE_READLINE 1000    // Commandes rappelées au démarrage
+
+static void rappeler_historique(const char *texte, size_t lg, void *ctx) {
+    (void)ctx;
+    char *ligne = strndup(texte, lg);
+    if (ligne != NULL) {
+        add_history(ligne);
+        free(ligne);
+    }
+}
+#endif
+
+static void usage(const char *nom) {
+    fprintf(stderr, "usage : %s [script | -c commandes]\n", nom);
+    exit(2);
+}
+
+
+// ================================================================================================
+
+int main(int argc, char **argv) {
+    char *texte = NULL;
+    size_t taille = 0;
+    int projete = 0;
+
+    if (argc > 1) {
+        mode_script = 1;
+        if (strcmp(argv[1], "-c") == 0) {
+            if (argc != 3) {
+                usage(argv[0]);
+            }
+            texte = argv[2];
+            taille = strlen(texte);
+        } else {
+            if (argc != 2) {
+                usage(argv[0]);
+            }
+            texte = charger_script(argv[1], &taille, &projete);
+            if (texte == NULL) {
+                perror(argv[1]);
+                return 127;
+            }
+        }
+    }
+
+    initialiser_options();
+
+    // ------Trace des commandes dès le démarrage si ENSISHELL_TRACE la demande
+    char *trace = getenv("ENSISHELL_TRACE");
+    if (trace != NULL && trace[0] != '\0') {
+        ouvrir_trace(trace, 0);
+    }
+
+    // ------SIGCHLD est reçu par la boucle d'évènements pour la terminaison asynchrone
+    initialiser_sigchld();
+
+    if (mode_script) {
+        int statut = executer_script(texte, taille);
+        fflush(stdout);
+        if (projete) {
+            munmap(texte, taille + 1);
+        } else if (texte != argv[2]) {
+            free(texte);
+        }
+        return statut;
+    }
+
+        printf("Variante %d: %s\n", VARIANTE, VARIANTE_STRING);
+
+    // ------Groupes de processus et terminal, seulement en interactif
+    initialiser_controle_jobs();
+
+    // ------Historique persistant : seules les dernières commandes sont lues
+    if (ouvrir_historique() == 0) {
+#if USE_GNU_READLINE == 1
+        derniers_historique(HISTORIQUE_READLINE, rappeler_historique, NULL);
+#endif
+    }
+
+#if USE_GUILE == 1
+        initialiser_guile();
+#endif
+
+#if USE_GNU_READLINE == 0
+    setvbuf(stdin, NULL, _IONBF, 0); // poll() ne voit pas les tampons de stdio
+#endif
 
-		if (l->in) printf("in: %s\n", l->in);
-		if (l->out) printf("out: %s\n", l->out);
-		if (l->bg) printf("background (&)\n");
-
-		/* Display each command of the pipe */
-		for (i=0; l->seq[i]!=0; i++) {
-			char **cmd = l->seq[i];
-			printf("seq[%d]: ", i);
-                        for (j=0; cmd[j]!=0; j++) {
-                                printf("'%s' ", cmd[j]);
-                        }
-			printf("\n");
+	while (1) {
+		char *line=0;
+		char *prompt = "ensishell>";
+
+		/* Readline use some internal memory structure that
+		   can not be cleaned at the end of the program. Thus
+		   one memory leak per command seems unavoidable yet */
+		line = lire_ligne(prompt);
+		if (line == 0) {
+			terminate(line);
 		}
 
-		//============================================================================================
-		// Execution de la commande 
-		executer_command(l);
+		dernier_statut = traiter_ligne(line);
 	}
 
 	return 0;
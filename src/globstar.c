@@ -0,0 +1,432 @@
+/*****************************************************
+ * Ensishell : joker récursif ** en parallèle        *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour O_DIRECTORY, getdents64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "globstar.h"
+
+#define NB_FILS_MAX 16
+#define TAILLE_DENTS (1 << 16)
+
+// Entrée brute renvoyée par getdents64
+struct dirent64_noyau {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// File de répertoires à lire d'un fil : son propriétaire empile et dépile
+// à la fin (parcours en profondeur, proche dans le cache), les autres fils
+// volent au début quand leur propre file est vide
+typedef struct {
+    pthread_mutex_t verrou;
+    char **taches;          // Chemins relatifs à la racine, "" pour elle
+    size_t debut, fin, cap;
+} File;
+
+typedef struct {
+    int numero;
+    char **res;             // Chemins rendus, gardé d'un parcours à l'autre
+    size_t nb, cap;
+    char *dents;            // Tampon de getdents64
+} Fil;
+
+// Les fils d'exécution, leurs tampons, leurs files et leurs tableaux de
+// résultats sont créés au premier
+// parcours et servent à tous les suivants (un par ** et par répertoire qui
+// le précède). Entre deux parcours, les fils attendent sur depart.
+static struct {
+    int racine;             // Descripteur du répertoire base
+    const char *base;
+    size_t lbase;
+    const char *motif;
+    int nb_fils;            // 0 : équipe pas encore créée
+    File files[NB_FILS_MAX];
+    Fil fils[NB_FILS_MAX];
+    atomic_size_t en_cours; // Tâches empilées et pas encore terminées
+    atomic_size_t a_prendre; // Tâches dans les files
+    atomic_int dormeurs;    // Fils en attente sur travail
+    atomic_int erreur;
+
+    pthread_mutex_t verrou; // Pour les trois conditions
+    pthread_cond_t travail; // Tâche empilée, ou plus rien en cours
+    pthread_cond_t depart;  // Nouveau parcours
+    pthread_cond_t repos;   // Dernier fil revenu de son parcours
+    unsigned long tour;     // Numéro du parcours
+    int actifs;             // Fils pas encore revenus du parcours
+} parcours = {
+    .verrou = PTHREAD_MUTEX_INITIALIZER,
+    .travail = PTHREAD_COND_INITIALIZER,
+    .depart = PTHREAD_COND_INITIALIZER,
+    .repos = PTHREAD_COND_INITIALIZER,
+};
+
+
+// ================================================================================================
+// Files de travail
+
+static int empiler(File *f, char *tache) {
+    pthread_mutex_lock(&f->verrou);
+    if (f->fin == f->cap) {
+        if (f->debut > 0) {
+            memmove(f->taches, f->taches + f->debut, (f->fin - f->debut) * sizeof(char *));
+            f->fin -= f->debut;
+            f->debut = 0;
+        } else {
+            size_t cap = f->cap ? f->cap * 2 : 64;
+            char **t = realloc(f->taches, cap * sizeof(char *));
+            if (t == NULL) {
+                pthread_mutex_unlock(&f->verrou);
+                return -1;
+            }
+            f->taches = t;
+            f->cap = cap;
+        }
+    }
+    // tache appartient désormais à la file, reprise par depiler ou voler
+    memcpy(f->taches + f->fin++, &tache, sizeof(tache));
+    pthread_mutex_unlock(&f->verrou);
+
+    // Un fil qui s'endort compte d'abord parmi les dormeurs, puis regarde
+    // a_prendre : l'un des deux voit toujours l'autre, pas de réveil perdu
+    atomic_fetch_add(&parcours.a_prendre, 1);
+    if (atomic_load(&parcours.dormeurs) > 0) {
+        pthread_mutex_lock(&parcours.verrou);
+        pthread_cond_signal(&parcours.travail);
+        pthread_mutex_unlock(&parcours.verrou);
+    }
+    return 0;
+}
+
+static char *depiler(File *f) {
+    char *tache = NULL;
+    pthread_mutex_lock(&f->verrou);
+    if (f->fin > f->debut) {
+        tache = f->taches[--f->fin];
+    }
+    pthread_mutex_unlock(&f->verrou);
+    return tache;
+}
+
+static char *voler(File *f) {
+    char *tache = NULL;
+    if (pthread_mutex_trylock(&f->verrou) != 0) {
+        return NULL;
+    }
+    if (f->fin > f->debut) {
+        tache = f->taches[f->debut++];
+    }
+    pthread_mutex_unlock(&f->verrou);
+    return tache;
+}
+
+// Attend qu'une tâche soit empilée ; renvoie 0 quand tout est terminé
+static int attendre_tache(void) {
+    pthread_mutex_lock(&parcours.verrou);
+    atomic_fetch_add(&parcours.dormeurs, 1);
+    while (atomic_load(&parcours.a_prendre) == 0 && atomic_load(&parcours.en_cours) > 0) {
+        pthread_cond_wait(&parcours.travail, &parcours.verrou);
+    }
+    atomic_fetch_sub(&parcours.dormeurs, 1);
+    int reste = atomic_load(&parcours.en_cours) > 0;
+    pthread_mutex_unlock(&parcours.verrou);
+    return reste;
+}
+
+
+// ================================================================================================
+// Lecture d'un répertoire
+
+static int rendre(Fil *fil, const char *rel, size_t lrel, const char *nom, int barre) {
+    size_t lnom = strlen(nom);
+    char *chemin = malloc(parcours.lbase + lrel + 1 + lnom + 2);
+    if (chemin == NULL) {
+        return -1;
+    }
+    char *c = chemin;
+    memcpy(c, parcours.base, parcours.lbase);
+    c += parcours.lbase;
+    if (lrel > 0) {
+        memcpy(c, rel, lrel);
+        c += lrel;
+        if (lnom > 0) {
+            *c++ = '/';
+        }
+    }
+    memcpy(c, nom, lnom);
+    c += lnom;
+    if (barre && (lrel > 0 || lnom > 0)) {
+        *c++ = '/';
+    }
+    *c = '\0';
+
+    if (fil->nb == fil->cap) {
+        size_t cap = fil->cap ? fil->cap * 2 : 256;
+        char **r = realloc(fil->res, cap * sizeof(char *));
+        if (r == NULL) {
+            free(chemin);
+            return -1;
+        }
+        fil->res = r;
+        fil->cap = cap;
+    }
+    // chemin appartient désormais à fil->res, libéré à la collecte
+    memcpy(fil->res + fil->nb++, &chemin, sizeof(chemin));
+    return 0;
+}
+
+static char *joindre(const char *rel, size_t lrel, const char *nom) {
+    size_t lnom = strlen(nom);
+    char *s = malloc(lrel + 1 + lnom + 1);
+    if (s != NULL) {
+        if (lrel > 0) {
+            memcpy(s, rel, lrel);
+            s[lrel++] = '/';
+        }
+        memcpy(s + lrel, nom, lnom + 1);
+    }
+    return s;
+}
+
+// Lit le répertoire rel : rend les correspondances, empile les sous-répertoires
+static int traiter(Fil *fil, const char *rel) {
+    size_t lrel = strlen(rel);
+    int fd = openat(parcours.racine, lrel ? rel : ".",
+                    O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd == -1) {
+        return 0;  // Illisible ou disparu : ignoré, comme glob
+    }
+    if (parcours.motif == NULL && rendre(fil, rel, lrel, "", 1) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    long n;
+    while ((n = syscall(SYS_getdents64, fd, fil->dents, TAILLE_DENTS)) > 0) {
+        for (long pos = 0; pos < n; ) {
+            struct dirent64_noyau *e = (struct dirent64_noyau *)(fil->dents + pos);
+            pos += e->d_reclen;
+            const char *nom = e->d_name;
+            if (nom[0] == '.' && (nom[1] == '\0' || (nom[1] == '.' && nom[2] == '\0'))) {
+                continue;
+            }
+
+            if (parcours.motif != NULL && fnmatch(parcours.motif, nom, FNM_PERIOD) == 0
+                && rendre(fil, rel, lrel, nom, 0) == -1) {
+                close(fd);
+                return -1;
+            }
+
+            unsigned char type = e->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                if (fstatat(fd, nom, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode)) {
+                    type = DT_DIR;
+                }
+            }
+            if (type != DT_DIR || nom[0] == '.') {
+                continue;
+            }
+            char *sous = joindre(rel, lrel, nom);
+            atomic_fetch_add(&parcours.en_cours, 1);
+            if (sous == NULL || empiler(&parcours.files[fil->numero], sous) == -1) {
+                free(sous);
+                atomic_fetch_sub(&parcours.en_cours, 1);
+                close(fd);
+                return -1;
+            }
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+// Prend les tâches de sa file, puis celles des autres, jusqu'à la fin du
+// parcours
+static void travailler(Fil *fil) {
+    while (1) {
+        char *tache = depiler(&parcours.files[fil->numero]);
+        for (int i = 1; tache == NULL && i < parcours.nb_fils; i++) {
+            tache = voler(&parcours.files[(fil->numero + i) % parcours.nb_fils]);
+        }
+        if (tache == NULL) {
+            if (!attendre_tache()) {
+                return;
+            }
+            continue;
+        }
+        atomic_fetch_sub(&parcours.a_prendre, 1);
+        // Après une erreur, on vide les files sans plus rien lire
+        if (!atomic_load(&parcours.erreur) && traiter(fil, tache) == -1) {
+            atomic_store(&parcours.erreur, 1);
+        }
+        free(tache);
+        if (atomic_fetch_sub(&parcours.en_cours, 1) == 1) {
+            // Dernière tâche : les fils en attente ont fini
+            pthread_mutex_lock(&parcours.verrou);
+            pthread_cond_broadcast(&parcours.travail);
+            pthread_mutex_unlock(&parcours.verrou);
+        }
+    }
+}
+
+// Un fil de l'équipe : un parcours à chaque nouveau tour
+static void *equipier(void *arg) {
+    Fil *fil = arg;
+    unsigned long vu = 0;
+    pthread_mutex_lock(&parcours.verrou);
+    while (1) {
+        while (parcours.tour == vu) {
+            pthread_cond_wait(&parcours.depart, &parcours.verrou);
+        }
+        vu = parcours.tour;
+        pthread_mutex_unlock(&parcours.verrou);
+        travailler(fil);
+        pthread_mutex_lock(&parcours.verrou);
+        if (--parcours.actifs == 0) {
+            pthread_cond_signal(&parcours.repos);
+        }
+    }
+    return NULL;
+}
+
+// Crée l'équipe au premier parcours : un fil par processeur, dont le fil
+// principal. Les fils créés ne reçoivent aucun signal (SIGCHLD reste au
+// signalfd du shell). Renvoie -1 si la mémoire manque.
+static int former_equipe(void) {
+    if (parcours.nb_fils > 0) {
+        return 0;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int voulus = cpus < 1 ? 1 : cpus > NB_FILS_MAX ? NB_FILS_MAX : (int)cpus;
+    for (int i = 0; i < voulus; i++) {
+        pthread_mutex_init(&parcours.files[i].verrou, NULL);
+        parcours.fils[i].numero = i;
+        parcours.fils[i].dents = malloc(TAILLE_DENTS);
+        if (parcours.fils[i].dents == NULL) {
+            while (i >= 0) {
+                free(parcours.fils[i].dents);
+                parcours.fils[i].dents = NULL;
+                pthread_mutex_destroy(&parcours.files[i--].verrou);
+            }
+            return -1;
+        }
+    }
+
+    sigset_t tous, ancien;
+    sigfillset(&tous);
+    pthread_sigmask(SIG_BLOCK, &tous, &ancien);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int nb = 1;
+    pthread_t thread;
+    while (nb < voulus && pthread_create(&thread, &attr, equipier, &parcours.fils[nb]) == 0) {
+        nb++;
+    }
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &ancien, NULL);
+
+    // Sans tous les fils voulus, l'équipe fait avec ceux qui sont là
+    for (int i = nb; i < voulus; i++) {
+        free(parcours.fils[i].dents);
+        parcours.fils[i].dents = NULL;
+        pthread_mutex_destroy(&parcours.files[i].verrou);
+    }
+    parcours.nb_fils = nb;
+    return 0;
+}
+
+
+// ================================================================================================
+// Parcours complet
+
+int arpenter(const char *base, const char *motif, char ***resultats, size_t *nb) {
+    *resultats = NULL;
+    *nb = 0;
+    if (former_equipe() == -1) {
+        return -1;
+    }
+    parcours.racine = open(base[0] ? base : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (parcours.racine == -1) {
+        return 0;
+    }
+    parcours.base = base;
+    parcours.lbase = strlen(base);
+    parcours.motif = motif;
+    atomic_store(&parcours.erreur, 0);
+    for (int i = 0; i < parcours.nb_fils; i++) {
+        parcours.fils[i].nb = 0;
+        parcours.files[i].debut = parcours.files[i].fin = 0;
+    }
+
+    int err = 0;
+    char *racine = strdup("");
+    atomic_store(&parcours.en_cours, 1);
+    if (racine == NULL || empiler(&parcours.files[0], racine) == -1) {
+        free(racine);
+        close(parcours.racine);
+        return -1;
+    }
+
+    // Le fil principal travaille aussi, puis attend le retour des autres
+    pthread_mutex_lock(&parcours.verrou);
+    parcours.actifs = parcours.nb_fils - 1;
+    parcours.tour++;
+    pthread_cond_broadcast(&parcours.depart);
+    pthread_mutex_unlock(&parcours.verrou);
+    travailler(&parcours.fils[0]);
+    pthread_mutex_lock(&parcours.verrou);
+    while (parcours.actifs > 0) {
+        pthread_cond_wait(&parcours.repos, &parcours.verrou);
+    }
+    pthread_mutex_unlock(&parcours.verrou);
+    if (atomic_load(&parcours.erreur)) {
+        err = -1;
+    }
+
+    // Regroupement des résultats de tous les fils
+    size_t total = 0;
+    for (int i = 0; i < parcours.nb_fils; i++) {
+        total += parcours.fils[i].nb;
+    }
+    char **res = (err == 0) ? malloc((total ? total : 1) * sizeof(char *)) : NULL;
+    if (res == NULL) {
+        err = -1;
+    }
+    size_t k = 0;
+    for (int i = 0; i < parcours.nb_fils; i++) {
+        Fil *fil = &parcours.fils[i];
+        for (size_t j = 0; j < fil->nb; j++) {
+            if (res != NULL) {
+                res[k++] = fil->res[j];
+            } else {
+                free(fil->res[j]);
+            }
+        }
+        fil->nb = 0;
+    }
+    close(parcours.racine);
+    *resultats = res;
+    *nb = k;
+    return err;
+}
@@ -0,0 +1,23 @@
+/*****************************************************
+ * Ensishell : joker récursif ** en parallèle        *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __GLOBSTAR_H
+#define __GLOBSTAR_H
+
+#include <stddef.h>
+
+/* Parcourt l'arborescence sous le répertoire base ("" pour le répertoire
+   courant, sinon terminé par '/') avec un fil d'exécution par processeur,
+   sans suivre les liens symboliques ni entrer dans les répertoires cachés.
+   Si motif n'est pas NULL, rend base + chemin de chaque entrée dont le nom
+   correspond à motif, à toutes les profondeurs (base compris). Sinon, rend
+   chaque répertoire visité, base compris, suivi de '/'.
+   Les chemins sont rendus dans un ordre quelconque, dans un tableau alloué
+   (*resultats, *nb) dont l'appelant libère les chaînes et le tableau.
+   Renvoie 0, ou -1 si la mémoire manque. */
+int arpenter(const char *base, const char *motif, char ***resultats, size_t *nb);
+
+#endif
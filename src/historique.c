@@ -0,0 +1,432 @@
+/*****************************************************
+ * Ensishell : historique persistant des commandes   *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour memmem
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "historique.h"
+
+// Une commande dans le fichier : en-tête, texte, zéros jusqu'à un multiple de
+// 8 octets, pied. Le pied permet de relire depuis la fin ; la somme et la
+// double taille font reconnaître un enregistrement coupé (arrêt brutal).
+#define MAGIE 0x48534e45u           // "ENSH"
+#define LONGUEUR_MAX (1u << 20)
+
+typedef struct {
+    uint32_t magie;
+    uint32_t longueur;              // Du texte
+    int64_t date;                   // time(NULL)
+} EnTete;
+
+typedef struct {
+    uint32_t somme;                 // FNV-1a du texte
+    uint32_t taille;                // De tout l'enregistrement
+} Pied;
+
+#define TAILLE_ENREGISTREMENT(lg) \
+    (sizeof(EnTete) + (((lg) + 7) & ~(size_t)7) + sizeof(Pied))
+
+static int fd_historique = -1;
+static const char *carte = NULL;    // Projection du fichier
+static size_t taille_carte = 0;
+
+// Index, construit à la première recherche puis complété au fil des ajouts
+// (de ce shell ou des autres) : position de chaque commande, et pour chaque
+// trigramme la liste croissante des commandes qui le contiennent
+static uint64_t *positions = NULL;
+static size_t nb_commandes = 0, cap_commandes = 0;
+static size_t fin_indexee = 0;      // Octets du fichier déjà parcourus
+
+typedef struct {
+    uint32_t cle;                   // 3 octets du trigramme, 0 : case vide
+    uint32_t nb, cap;
+    uint32_t *commandes;
+} Liste;
+
+static Liste *trigrammes = NULL;
+static size_t taille_trigrammes = 0, occupes_trigrammes = 0;
+
+
+// ================================================================================================
+// Fichier et enregistrements
+
+static uint32_t somme(const char *texte, size_t lg) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < lg; i++) {
+        h = (h ^ (unsigned char)texte[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Suit la taille du fichier, que d'autres shells allongent
+static int projeter(void) {
+    struct stat st;
+    if (fstat(fd_historique, &st) == -1) {
+        return -1;
+    }
+    if ((size_t)st.st_size == taille_carte) {
+        return 0;
+    }
+    if (carte != NULL) {
+        munmap((void *)carte, taille_carte);
+        carte = NULL;
+        taille_carte = 0;
+    }
+    if (st.st_size == 0) {
+        return 0;
+    }
+    void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd_historique, 0);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+    madvise(p, st.st_size, MADV_RANDOM);
+    carte = p;
+    taille_carte = st.st_size;
+    return 0;
+}
+
+// Enregistrement valide commençant à pos : renvoie sa taille, 0 sinon
+static size_t valide(size_t pos) {
+    if (pos % 8 != 0 || pos + sizeof(EnTete) + sizeof(Pied) > taille_carte) {
+        return 0;
+    }
+    const EnTete *e = (const EnTete *)(carte + pos);
+    if (e->magie != MAGIE || e->longueur > LONGUEUR_MAX) {
+        return 0;
+    }
+    size_t taille = TAILLE_ENREGISTREMENT(e->longueur);
+    if (pos + taille > taille_carte) {
+        return 0;
+    }
+    const Pied *p = (const Pied *)(carte + pos + taille - sizeof(Pied));
+    if (p->taille != taille || p->somme != somme(carte + pos + sizeof(EnTete), e->longueur)) {
+        return 0;
+    }
+    return taille;
+}
+
+// Enregistrement valide finissant juste avant fin : renvoie son début, ou
+// (size_t)-1 s'il n'y en a pas
+static size_t precedent(size_t fin) {
+    if (fin < sizeof(Pied) + sizeof(EnTete) || fin % 8 != 0) {
+        return (size_t)-1;
+    }
+    const Pied *p = (const Pied *)(carte + fin - sizeof(Pied));
+    if (p->taille > fin || valide(fin - p->taille) != p->taille) {
+        return (size_t)-1;
+    }
+    return fin - p->taille;
+}
+
+static const char *texte_de(size_t pos, size_t *lg) {
+    *lg = ((const EnTete *)(carte + pos))->longueur;
+    return carte + pos + sizeof(EnTete);
+}
+
+int ouvrir_historique(void) {
+    char chemin[4096];
+    const char *nom = getenv("ENSISHELL_HISTORIQUE");
+    const char *home = getenv("HOME");
+    if (nom != NULL && nom[0] != '\0') {
+        snprintf(chemin, sizeof(chemin), "%s", nom);
+    } else if (home != NULL) {
+        snprintf(chemin, sizeof(chemin), "%s/.ensishell_historique", home);
+    } else {
+        return -1;
+    }
+    fd_historique = open(chemin, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd_historique == -1 || projeter() == -1) {
+        perror(chemin);
+        if (fd_historique != -1) {
+            close(fd_historique);
+            fd_historique = -1;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+int derniers_historique(int n, void (*f)(const char *texte, size_t lg, void *ctx), void *ctx) {
+    if (fd_historique == -1 || n <= 0) {
+        return 0;
+    }
+    size_t *trouves = malloc(n * sizeof(size_t));
+    if (trouves == NULL) {
+        return 0;
+    }
+    // En remontant depuis la fin ; une fin coupée est sautée 8 octets par 8
+    int nb = 0;
+    size_t fin = taille_carte & ~(size_t)7;
+    while (nb < n && fin > 0) {
+        size_t debut = precedent(fin);
+        if (debut == (size_t)-1) {
+            fin -= 8;
+            continue;
+        }
+        trouves[nb++] = debut;
+        fin = debut;
+    }
+    for (int i = nb - 1; i >= 0; i--) {
+        size_t lg;
+        const char *texte = texte_de(trouves[i], &lg);
+        f(texte, lg, ctx);
+    }
+    free(trouves);
+    return nb;
+}
+
+void ajouter_historique(const char *ligne) {
+    if (fd_historique == -1) {
+        return;
+    }
+    size_t lg = strlen(ligne);
+    if (lg == 0 || lg > LONGUEUR_MAX || strspn(ligne, " \t") == lg) {
+        return;
+    }
+    size_t taille = TAILLE_ENREGISTREMENT(lg);
+    char *enregistrement = calloc(1, taille);
+    if (enregistrement == NULL) {
+        return;
+    }
+    EnTete e = {.magie = MAGIE, .longueur = lg, .date = time(NULL)};
+    Pied p = {.somme = somme(ligne, lg), .taille = taille};
+    memcpy(enregistrement, &e, sizeof(e));
+    memcpy(enregistrement + sizeof(e), ligne, lg);
+    memcpy(enregistrement + taille - sizeof(p), &p, sizeof(p));
+    // Une seule écriture : avec O_APPEND, pas d'entrelacement entre shells.
+    // Une écriture partielle (disque plein) laisse une fin coupée, ignorée.
+    if (write(fd_historique, enregistrement, taille) != (ssize_t)taille) {
+        perror("historique");
+    }
+    free(enregistrement);
+}
+
+
+// ================================================================================================
+// Index des trigrammes
+
+static size_t hacher(uint32_t cle) {
+    return (cle * 2654435761u) & (taille_trigrammes - 1);
+}
+
+static Liste *trouver_liste(uint32_t cle, int creer) {
+    if (creer && (occupes_trigrammes + 1) * 2 > taille_trigrammes) {
+        size_t ancienne = taille_trigrammes;
+        Liste *anciennes = trigrammes;
+        size_t nouvelle = ancienne ? ancienne * 2 : 4096;
+        Liste *t = calloc(nouvelle, sizeof(Liste));
+        if (t == NULL) {
+            return NULL;
+        }
+        trigrammes = t;
+        taille_trigrammes = nouvelle;
+        for (size_t i = 0; i < ancienne; i++) {
+            if (anciennes[i].cle != 0) {
+                size_t j = hacher(anciennes[i].cle);
+                while (trigrammes[j].cle != 0) {
+                    j = (j + 1) & (taille_trigrammes - 1);
+                }
+                trigrammes[j] = anciennes[i];
+            }
+        }
+        free(anciennes);
+    }
+    if (taille_trigrammes == 0) {
+        return NULL;
+    }
+    size_t i = hacher(cle);
+    while (trigrammes[i].cle != 0) {
+        if (trigrammes[i].cle == cle) {
+            return &trigrammes[i];
+        }
+        i = (i + 1) & (taille_trigrammes - 1);
+    }
+    if (!creer) {
+        return NULL;
+    }
+    trigrammes[i].cle = cle;
+    occupes_trigrammes++;
+    return &trigrammes[i];
+}
+
+static uint32_t trigramme(const char *t) {
+    return ((uint32_t)(unsigned char)t[0] << 16) | ((uint32_t)(unsigned char)t[1] << 8)
+           | (unsigned char)t[2];
+}
+
+static int indexer(size_t pos) {
+    if (nb_commandes == cap_commandes) {
+        size_t cap = cap_commandes ? cap_commandes * 2 : 1024;
+        uint64_t *p = realloc(positions, cap * sizeof(uint64_t));
+        if (p == NULL) {
+            return -1;
+        }
+        positions = p;
+        cap_commandes = cap;
+    }
+    uint32_t numero = nb_commandes;
+    positions[nb_commandes++] = pos;
+
+    size_t lg;
+    const char *texte = texte_de(pos, &lg);
+    for (size_t i = 0; i + 3 <= lg; i++) {
+        uint32_t cle = trigramme(texte + i);
+        if (cle == 0) {
+            continue;
+        }
+        Liste *l = trouver_liste(cle, 1);
+        if (l == NULL) {
+            return -1;
+        }
+        // Les numéros arrivent dans l'ordre : un doublon ne peut être que le dernier
+        if (l->nb > 0 && l->commandes[l->nb - 1] == numero) {
+            continue;
+        }
+        if (l->nb == l->cap) {
+            uint32_t cap = l->cap ? l->cap * 2 : 4;
+            uint32_t *c = realloc(l->commandes, cap * sizeof(uint32_t));
+            if (c == NULL) {
+                return -1;
+            }
+            l->commandes = c;
+            l->cap = cap;
+        }
+        l->commandes[l->nb++] = numero;
+    }
+    return 0;
+}
+
+// Indexe ce qui a été ajouté au fichier depuis la dernière fois
+static int completer_index(void) {
+    if (projeter() == -1) {
+        return -1;
+    }
+    while (fin_indexee < taille_carte) {
+        size_t taille = valide(fin_indexee);
+        if (taille == 0) {
+            // Enregistrement coupé : reprise au prochain valide
+            fin_indexee += 8;
+            continue;
+        }
+        if (indexer(fin_indexee) == -1) {
+            return -1;
+        }
+        fin_indexee += taille;
+    }
+    return 0;
+}
+
+
+// ================================================================================================
+// Commande interne history
+
+static void afficher(size_t numero) {
+    size_t lg;
+    const char *texte = texte_de(positions[numero], &lg);
+    printf("%6zu  %.*s\n", numero + 1, (int)lg, texte);
+}
+
+static int contient(size_t numero, const char *motif, size_t lm) {
+    size_t lg;
+    const char *texte = texte_de(positions[numero], &lg);
+    return memmem(texte, lg, motif, lm) != NULL;
+}
+
+// Les n commandes les plus récentes contenant motif, de la plus ancienne à
+// la plus récente. Candidates : la plus courte des listes des trigrammes du
+// motif, vérifiées une à une ; toutes les commandes si le motif est trop court.
+static void chercher(const char *motif, size_t n) {
+    size_t lm = strlen(motif);
+    const Liste *plus_courte = NULL;
+    for (size_t i = 0; i + 3 <= lm; i++) {
+        const Liste *l = trouver_liste(trigramme(motif + i), 0);
+        if (l == NULL) {
+            return;     // Trigramme absent de tout l'historique
+        }
+        if (plus_courte == NULL || l->nb < plus_courte->nb) {
+            plus_courte = l;
+        }
+    }
+
+    size_t *trouves = malloc(n * sizeof(size_t));
+    if (trouves == NULL) {
+        return;
+    }
+    size_t nb = 0;
+    if (plus_courte != NULL) {
+        for (size_t i = plus_courte->nb; i-- > 0 && nb < n; ) {
+            if (contient(plus_courte->commandes[i], motif, lm)) {
+                trouves[nb++] = plus_courte->commandes[i];
+            }
+        }
+    } else {
+        for (size_t i = nb_commandes; i-- > 0 && nb < n; ) {
+            if (contient(i, motif, lm)) {
+                trouves[nb++] = i;
+            }
+        }
+    }
+    while (nb-- > 0) {
+        afficher(trouves[nb]);
+    }
+    free(trouves);
+}
+
+static int lire_nombre(const char *texte, size_t *n) {
+    char *fin;
+    long v = strtol(texte, &fin, 10);
+    if (fin == texte || *fin != '\0' || v <= 0) {
+        return -1;
+    }
+    *n = v;
+    return 0;
+}
+
+int commande_history(char **cmd) {
+    size_t n = 20;
+    const char *motif = NULL;
+    int i = 1;
+
+    if (fd_historique == -1) {
+        fprintf(stderr, "history : pas d'historique persistant\n");
+        return 1;
+    }
+    if (cmd[i] != NULL && strcmp(cmd[i], "-s") == 0) {
+        motif = cmd[++i];
+        if (motif == NULL || motif[0] == '\0') {
+            fprintf(stderr, "usage : history [n] | history -s motif [n]\n");
+            return 2;
+        }
+        i++;
+    }
+    if (cmd[i] != NULL && (lire_nombre(cmd[i], &n) == -1 || cmd[i + 1] != NULL)) {
+        fprintf(stderr, "usage : history [n] | history -s motif [n]\n");
+        return 2;
+    }
+    if (completer_index() == -1) {
+        perror("history");
+        return 1;
+    }
+
+    if (motif != NULL) {
+        chercher(motif, n);
+    } else {
+        for (size_t j = nb_commandes > n ? nb_commandes - n : 0; j < nb_commandes; j++) {
+            afficher(j);
+        }
+    }
+    return 0;
+}
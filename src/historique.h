@@ -0,0 +1,31 @@
+/*****************************************************
+ * Ensishell : historique persistant des commandes   *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __HISTORIQUE_H
+#define __HISTORIQUE_H
+
+#include <stddef.h>
+
+/* Ouvre le fichier d'historique ($ENSISHELL_HISTORIQUE, sinon
+   ~/.ensishell_historique) et le projette en mémoire, sans le lire.
+   Renvoie -1 (historique désactivé) s'il ne peut pas l'être. */
+int ouvrir_historique(void);
+
+/* Appelle f, dans l'ordre chronologique, pour les n dernières commandes,
+   lues depuis la fin du fichier. Le texte n'est pas terminé par '\0'.
+   Renvoie le nombre de commandes. */
+int derniers_historique(int n, void (*f)(const char *texte, size_t lg, void *ctx), void *ctx);
+
+/* Ajoute une commande à la fin du fichier, en une seule écriture O_APPEND :
+   plusieurs shells peuvent écrire le même historique. */
+void ajouter_historique(const char *ligne);
+
+/* Commande interne "history [n] | history -s motif [n]" : n dernières
+   commandes (20 par défaut), ou les n plus récentes contenant motif,
+   trouvées par l'index des trigrammes. Renvoie le code de retour. */
+int commande_history(char **cmd);
+
+#endif
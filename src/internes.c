@@ -0,0 +1,584 @@
+/*****************************************************
+ * Ensishell : commandes exécutées par le shell      *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "internes.h"
+
+// Code de retour après écriture sur stdout : 1 si elle a échoué
+static int fin_ecriture(const char *commande) {
+    if (fflush(stdout) == EOF || ferror(stdout)) {
+        fprintf(stderr, "%s: erreur d'écriture : %s\n", commande, strerror(errno));
+        clearerr(stdout);
+        return 1;
+    }
+    return 0;
+}
+
+
+// ================================================================================================
+// :, true, false, pwd, cd
+
+static int interne_vrai(char **cmd) {
+    (void)cmd;
+    return 0;
+}
+
+static int interne_faux(char **cmd) {
+    (void)cmd;
+    return 1;
+}
+
+static int interne_pwd(char **cmd) {
+    char *rep = getcwd(NULL, 0);
+    if (rep == NULL) {
+        fprintf(stderr, "%s: %s\n", cmd[0], strerror(errno));
+        return 1;
+    }
+    puts(rep);
+    free(rep);
+    return fin_ecriture(cmd[0]);
+}
+
+// "cd [rép | -]" : HOME sans argument, OLDPWD (affiché) pour "-"
+static int interne_cd(char **cmd) {
+    const char *rep = cmd[1];
+    int afficher = 0;
+
+    if (rep != NULL && cmd[2] != NULL) {
+        fprintf(stderr, "cd: trop d'arguments\n");
+        return 1;
+    }
+    if (rep == NULL || strcmp(rep, "-") == 0) {
+        const char *variable = rep ? "OLDPWD" : "HOME";
+        afficher = rep != NULL;
+        rep = getenv(variable);
+        if (rep == NULL) {
+            fprintf(stderr, "cd: %s non défini\n", variable);
+            return 1;
+        }
+    }
+    char *ancien = getcwd(NULL, 0);
+    if (chdir(rep) == -1) {
+        fprintf(stderr, "cd: %s: %s\n", rep, strerror(errno));
+        free(ancien);
+        return 1;
+    }
+    char *nouveau = getcwd(NULL, 0);
+    if (ancien != NULL) {
+        setenv("OLDPWD", ancien, 1);
+    }
+    if (nouveau != NULL) {
+        setenv("PWD", nouveau, 1);
+        if (afficher) {
+            puts(nouveau);
+        }
+    }
+    free(ancien);
+    free(nouveau);
+    return afficher ? fin_ecriture(cmd[0]) : 0;
+}
+
+
+// ================================================================================================
+// echo et printf
+
+// Écrit le caractère désigné par l'échappement commençant en s (juste après
+// '\'). Avec zero_octal (echo -e, %b), les octaux s'écrivent \0nnn, sinon
+// \nnn. Renvoie le nombre de caractères lus après '\', -1 pour \c (fin de
+// toute la sortie).
+static int echappement(const char *s, int zero_octal) {
+    const char *simples = "\\\\a\ab\be\033f\fn\nr\rt\tv\v";
+    for (const char *c = simples; *c; c += 2) {
+        if (*s == c[0]) {
+            putchar(c[1]);
+            return 1;
+        }
+    }
+    if (*s == 'c') {
+        return -1;
+    }
+    int lus = 0, valeur = 0;
+    if (*s == 'x') {
+        while (lus < 2 && s[1 + lus] != '\0' && strchr("0123456789abcdefABCDEF", s[1 + lus])) {
+            char c = s[1 + lus++];
+            valeur = valeur * 16 + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+        if (lus > 0) {
+            putchar(valeur);
+            return 1 + lus;
+        }
+    } else if (*s >= '0' && *s <= '7' && (!zero_octal || *s == '0')) {
+        int debut = (zero_octal && *s == '0') ? 1 : 0;
+        while (lus < 3 && s[debut + lus] >= '0' && s[debut + lus] <= '7') {
+            valeur = valeur * 8 + s[debut + lus++] - '0';
+        }
+        putchar(valeur);
+        return debut + lus;
+    }
+    // Inconnu : recopié tel quel
+    putchar('\\');
+    if (*s == '\0') {
+        return 0;
+    }
+    putchar(*s);
+    return 1;
+}
+
+// Écrit texte en interprétant les échappements ; renvoie -1 après \c
+static int ecrire_echappe(const char *texte) {
+    for (const char *p = texte; *p; p++) {
+        if (*p != '\\') {
+            putchar(*p);
+            continue;
+        }
+        int n = echappement(p + 1, 1);
+        if (n == -1) {
+            return -1;
+        }
+        p += n;
+    }
+    return 0;
+}
+
+// "echo [-neE] mots..." comme celui de coreutils
+static int interne_echo(char **cmd) {
+    int i = 1, ligne = 1, echappements = 0;
+    while (cmd[i] != NULL && cmd[i][0] == '-' && cmd[i][1] != '\0'
+           && strspn(cmd[i] + 1, "neE") == strlen(cmd[i] + 1)) {
+        for (const char *c = cmd[i] + 1; *c; c++) {
+            if (*c == 'n') {
+                ligne = 0;
+            } else {
+                echappements = (*c == 'e');
+            }
+        }
+        i++;
+    }
+    for (int premier = i; cmd[i] != NULL; i++) {
+        if (i > premier) {
+            putchar(' ');
+        }
+        if (!echappements) {
+            fputs(cmd[i], stdout);
+        } else if (ecrire_echappe(cmd[i]) == -1) {
+            return fin_ecriture(cmd[0]);
+        }
+    }
+    if (ligne) {
+        putchar('\n');
+    }
+    return fin_ecriture(cmd[0]);
+}
+
+// Argument numérique de printf : entier en base 8, 10 ou 16, ou 'c (code du
+// caractère c). Un argument absent vaut 0.
+static long long lire_entier(const char *arg, int *statut) {
+    if (arg == NULL || arg[0] == '\0') {
+        return 0;
+    }
+    if (arg[0] == '\'' || arg[0] == '"') {
+        return (unsigned char)arg[1];
+    }
+    char *fin;
+    errno = 0;
+    long long v = strtoll(arg, &fin, 0);
+    if (*fin != '\0' || errno != 0) {
+        fprintf(stderr, "printf: %s: valeur numérique attendue\n", arg);
+        *statut = 1;
+    }
+    return v;
+}
+
+static double lire_reel(const char *arg, int *statut) {
+    if (arg == NULL || arg[0] == '\0') {
+        return 0;
+    }
+    char *fin;
+    double v = strtod(arg, &fin);
+    if (*fin != '\0') {
+        fprintf(stderr, "printf: %s: valeur numérique attendue\n", arg);
+        *statut = 1;
+    }
+    return v;
+}
+
+// "printf format arguments..." : le format est repris tant qu'il consomme
+// des arguments. Conversions : %s %b %c %d %i %o %u %x %X et réels, avec
+// drapeaux, largeur et précision.
+static int interne_printf(char **cmd) {
+    if (cmd[1] == NULL) {
+        fprintf(stderr, "usage : printf format [arguments...]\n");
+        return 2;
+    }
+    const char *format = cmd[1];
+    char **args = cmd + 2;
+    char **debut;
+    int statut = 0;
+
+    do {
+        debut = args;
+        for (const char *p = format; *p; p++) {
+            if (*p == '\\') {
+                int n = echappement(p + 1, 0);
+                if (n == -1) {
+                    return fin_ecriture(cmd[0]) | statut;
+                }
+                p += n;
+                continue;
+            }
+            if (*p != '%') {
+                putchar(*p);
+                continue;
+            }
+            if (p[1] == '%') {
+                putchar('%');
+                p++;
+                continue;
+            }
+            // Spécification recopiée pour printf, avec le modificateur ll
+            size_t lg = 1 + strspn(p + 1, "-+ #0");
+            lg += strspn(p + lg, "0123456789");
+            if (p[lg] == '.') {
+                lg++;
+                lg += strspn(p + lg, "0123456789");
+            }
+            char spec[32];
+            char conversion = p[lg];
+            if (lg + 4 > sizeof(spec) || conversion == '\0') {
+                fprintf(stderr, "printf: %s: format invalide\n", format);
+                return 1;
+            }
+            memcpy(spec, p, lg);
+            const char *arg = *args ? *args++ : NULL;
+
+            switch (conversion) {
+            case 's':
+            case 'c':
+                spec[lg] = conversion;
+                spec[lg + 1] = '\0';
+                if (conversion == 's') {
+                    printf(spec, arg ? arg : "");
+                } else if (arg != NULL && arg[0] != '\0') {
+                    printf(spec, arg[0]);
+                }
+                break;
+            case 'b':
+                if (arg != NULL && ecrire_echappe(arg) == -1) {
+                    return fin_ecriture(cmd[0]) | statut;
+                }
+                break;
+            case 'd':
+            case 'i':
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                spec[lg] = 'l';
+                spec[lg + 1] = 'l';
+                spec[lg + 2] = conversion;
+                spec[lg + 3] = '\0';
+                printf(spec, lire_entier(arg, &statut));
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec[lg] = conversion;
+                spec[lg + 1] = '\0';
+                printf(spec, lire_reel(arg, &statut));
+                break;
+            default:
+                fprintf(stderr, "printf: %%%c: conversion invalide\n", conversion);
+                return 1;
+            }
+            p += lg;
+        }
+    } while (*args != NULL && args != debut);
+
+    return fin_ecriture(cmd[0]) | statut;
+}
+
+
+// ================================================================================================
+// test et [
+
+// Analyse d'une expression de test : mots[i..n[, erreur mise à 1 avec un
+// message en cas d'expression mal formée
+typedef struct {
+    char **mots;
+    int n;
+    int i;
+    int erreur;
+} Test;
+
+static int erreur_test(Test *t, const char *message, const char *mot) {
+    if (!t->erreur) {
+        fprintf(stderr, "test: %s%s%s\n", mot ? mot : "", mot ? ": " : "", message);
+    }
+    t->erreur = 1;
+    return 0;
+}
+
+static long long entier_test(Test *t, const char *mot) {
+    char *fin;
+    errno = 0;
+    long long v = strtoll(mot, &fin, 10);
+    if (fin == mot || *fin != '\0' || errno != 0) {
+        erreur_test(t, "entier attendu", mot);
+    }
+    return v;
+}
+
+// Opérateur unaire op appliqué à arg : 0 ou 1, -1 si op n'en est pas un
+static int unaire(const char *op, const char *arg) {
+    struct stat st;
+    if (op[0] != '-' || op[1] == '\0' || op[2] != '\0') {
+        return -1;
+    }
+    switch (op[1]) {
+    case 'n': return arg[0] != '\0';
+    case 'z': return arg[0] == '\0';
+    case 'r': return access(arg, R_OK) == 0;
+    case 'w': return access(arg, W_OK) == 0;
+    case 'x': return access(arg, X_OK) == 0;
+    case 't': return isatty(atoi(arg));
+    case 'h':
+    case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    case 'e': case 'f': case 'd': case 's': case 'b': case 'c': case 'p': case 'S':
+    case 'g': case 'u': case 'k':
+        break;
+    default:
+        return -1;
+    }
+    if (stat(arg, &st) == -1) {
+        return 0;
+    }
+    switch (op[1]) {
+    case 'f': return S_ISREG(st.st_mode);
+    case 'd': return S_ISDIR(st.st_mode);
+    case 's': return st.st_size > 0;
+    case 'b': return S_ISBLK(st.st_mode);
+    case 'c': return S_ISCHR(st.st_mode);
+    case 'p': return S_ISFIFO(st.st_mode);
+    case 'S': return S_ISSOCK(st.st_mode);
+    case 'g': return (st.st_mode & S_ISGID) != 0;
+    case 'u': return (st.st_mode & S_ISUID) != 0;
+    case 'k': return (st.st_mode & S_ISVTX) != 0;
+    default: return 1;  // -e
+    }
+}
+
+static const char *const binaires[] = {
+    "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef", NULL
+};
+
+static int est_binaire(const char *op) {
+    for (int k = 0; binaires[k] != NULL; k++) {
+        if (strcmp(op, binaires[k]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int binaire(Test *t, const char *a, const char *op, const char *b) {
+    if (op[0] != '-') {
+        int c = strcmp(a, b);
+        switch (op[0]) {
+        case '!': return c != 0;
+        case '<': return c < 0;
+        case '>': return c > 0;
+        default: return c == 0;
+        }
+    }
+    if (op[1] == 'n' && op[2] == 't') {
+        struct stat sa, sb;
+        return stat(a, &sa) == 0 && (stat(b, &sb) == -1
+            || sa.st_mtim.tv_sec > sb.st_mtim.tv_sec
+            || (sa.st_mtim.tv_sec == sb.st_mtim.tv_sec && sa.st_mtim.tv_nsec > sb.st_mtim.tv_nsec));
+    }
+    if (op[1] == 'o' && op[2] == 't') {
+        return binaire(t, b, "-nt", a);
+    }
+    if (op[1] == 'e' && op[2] == 'f') {
+        struct stat sa, sb;
+        return stat(a, &sa) == 0 && stat(b, &sb) == 0
+               && sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    }
+    long long x = entier_test(t, a), y = entier_test(t, b);
+    switch (op[1] * 256 + op[2]) {
+    case 'e' * 256 + 'q': return x == y;
+    case 'n' * 256 + 'e': return x != y;
+    case 'l' * 256 + 't': return x < y;
+    case 'l' * 256 + 'e': return x <= y;
+    case 'g' * 256 + 't': return x > y;
+    default: return x >= y;
+    }
+}
+
+static int test_ou(Test *t);
+
+// primaire : ( expr ) | -op arg | arg op arg | arg
+static int test_primaire(Test *t) {
+    char **m = t->mots;
+    if (t->i >= t->n) {
+        return erreur_test(t, "argument manquant", NULL);
+    }
+    if (strcmp(m[t->i], "(") == 0) {
+        t->i++;
+        int v = test_ou(t);
+        if (t->i >= t->n || strcmp(m[t->i], ")") != 0) {
+            return erreur_test(t, "')' manquante", NULL);
+        }
+        t->i++;
+        return v;
+    }
+    if (t->i + 2 < t->n && est_binaire(m[t->i + 1])) {
+        t->i += 3;
+        return binaire(t, m[t->i - 3], m[t->i - 2], m[t->i - 1]);
+    }
+    if (t->i + 1 < t->n) {
+        int v = unaire(m[t->i], m[t->i + 1]);
+        if (v != -1) {
+            t->i += 2;
+            return v;
+        }
+    }
+    return m[t->i++][0] != '\0';
+}
+
+static int test_non(Test *t) {
+    if (t->i < t->n && strcmp(t->mots[t->i], "!") == 0) {
+        t->i++;
+        return !test_non(t);
+    }
+    return test_primaire(t);
+}
+
+static int test_et(Test *t) {
+    int v = test_non(t);
+    while (t->i < t->n && strcmp(t->mots[t->i], "-a") == 0) {
+        t->i++;
+        v = test_non(t) && v;
+    }
+    return v;
+}
+
+static int test_ou(Test *t) {
+    int v = test_et(t);
+    while (t->i < t->n && strcmp(t->mots[t->i], "-o") == 0) {
+        t->i++;
+        v = test_et(t) || v;
+    }
+    return v;
+}
+
+// Valeur de l'expression mots[0..n[ : les cas de 0 à 4 mots suivent les
+// règles de POSIX, qui lèvent les ambiguïtés ("test -n", "test ! =")
+static int evaluer_test(Test *t, char **mots, int n) {
+    if (n == 0) {
+        return 0;
+    }
+    if (n == 1) {
+        return mots[0][0] != '\0';
+    }
+    if (n == 2) {
+        if (strcmp(mots[0], "!") == 0) {
+            return mots[1][0] == '\0';
+        }
+        int v = unaire(mots[0], mots[1]);
+        return v != -1 ? v : erreur_test(t, "opérateur unaire attendu", mots[0]);
+    }
+    if (n == 3) {
+        if (est_binaire(mots[1])) {
+            return binaire(t, mots[0], mots[1], mots[2]);
+        }
+        if (strcmp(mots[1], "-a") == 0) {
+            return mots[0][0] != '\0' && mots[2][0] != '\0';
+        }
+        if (strcmp(mots[1], "-o") == 0) {
+            return mots[0][0] != '\0' || mots[2][0] != '\0';
+        }
+        if (strcmp(mots[0], "!") == 0) {
+            return !evaluer_test(t, mots + 1, 2);
+        }
+        if (strcmp(mots[0], "(") == 0 && strcmp(mots[2], ")") == 0) {
+            return mots[1][0] != '\0';
+        }
+    }
+    if (n == 4) {
+        if (strcmp(mots[0], "!") == 0) {
+            return !evaluer_test(t, mots + 1, 3);
+        }
+        if (strcmp(mots[0], "(") == 0 && strcmp(mots[3], ")") == 0) {
+            return evaluer_test(t, mots + 1, 2);
+        }
+    }
+    t->mots = mots;
+    t->n = n;
+    t->i = 0;
+    int v = test_ou(t);
+    if (t->i < t->n) {
+        return erreur_test(t, "argument inattendu", mots[t->i]);
+    }
+    return v;
+}
+
+static int interne_test(char **cmd) {
+    int n = 0;
+    while (cmd[n + 1] != NULL) {
+        n++;
+    }
+    if (cmd[0][0] == '[') {
+        if (n == 0 || strcmp(cmd[n], "]") != 0) {
+            fprintf(stderr, "[: ']' manquant\n");
+            return 2;
+        }
+        n--;
+    }
+    Test t = {0};
+    int v = evaluer_test(&t, cmd + 1, n);
+    return t.erreur ? 2 : !v;
+}
+
+
+// ================================================================================================
+// Table des commandes
+
+// Hachage parfait des noms de la table : aucune collision entre eux (une
+// collision ferait écraser une case, signalé par -Woverride-init)
+#define HACHE(longueur, premier, dernier) (((longueur) + (premier) + 3 * (dernier)) & 15)
+
+static const Interne table[16] = {
+    [HACHE(1, ':', ':')] = {":", interne_vrai, 0},
+    [HACHE(4, 't', 'e')] = {"true", interne_vrai, 0},
+    [HACHE(5, 'f', 'e')] = {"false", interne_faux, 0},
+    [HACHE(4, 'e', 'o')] = {"echo", interne_echo, 0},
+    [HACHE(6, 'p', 'f')] = {"printf", interne_printf, 0},
+    [HACHE(4, 't', 't')] = {"test", interne_test, 0},
+    [HACHE(1, '[', '[')] = {"[", interne_test, 0},
+    [HACHE(2, 'c', 'd')] = {"cd", interne_cd, 1},
+    [HACHE(3, 'p', 'd')] = {"pwd", interne_pwd, 0},
+};
+
+const Interne *chercher_interne(const char *nom) {
+    size_t lg = strlen(nom);
+    if (lg == 0) {
+        return NULL;
+    }
+    const Interne *i = &table[HACHE(lg, (unsigned char)nom[0], (unsigned char)nom[lg - 1])];
+    return (i->nom != NULL && strcmp(i->nom, nom) == 0) ? i : NULL;
+}
@@ -0,0 +1,23 @@
+/*****************************************************
+ * Ensishell : commandes exécutées par le shell      *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __INTERNES_H
+#define __INTERNES_H
+
+/* Utilitaires courants (:, true, false, echo, printf, test, [, cd, pwd)
+   exécutés sans processus. Ils écrivent sur stdout et stderr, que
+   l'appelant redirige, et renvoient le code de retour. */
+typedef struct {
+    const char *nom;
+    int (*executer)(char **cmd);
+    int etat_shell;             /* Agit sur le shell (cd) : sans effet hors de lui */
+} Interne;
+
+/* Commande interne de ce nom, NULL sinon. Une seule comparaison de chaînes
+   (hachage parfait sur la longueur, le premier et le dernier caractère). */
+const Interne *chercher_interne(const char *nom);
+
+#endif
@@ -0,0 +1,387 @@
+/*****************************************************
+ * Ensishell : table des tâches en arrière-plan      *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "jobs.h"
+
+// Les tâches sont rangées par numéro : emplacements[id - 1], NULL si libre.
+// Les numéros libérés sont empilés dans libres et réutilisés en premier.
+static Job **emplacements = NULL;
+static int *libres = NULL;
+static int capacite = 0;
+static int nb_libres = 0;
+static int prochain_id = 1;
+static int nb_jobs = 0;
+
+// Index pid -> numéro : adressage ouvert à sondage linéaire, taille en
+// puissance de 2, pid 0 pour une case vide
+typedef struct {
+    pid_t pid;
+    int id;
+} Entree;
+
+static Entree *index_pid = NULL;
+static size_t taille_index = 0;
+static size_t occupes_index = 0;
+
+// Tas binaire des tâches qui ont une échéance, la plus proche en tête :
+// echeances[job->rang_echeance - 1] == job
+static Job **echeances = NULL;
+static int nb_echeances = 0;
+static int cap_echeances = 0;
+
+
+// ================================================================================================
+// Index pid -> numéro
+
+static size_t hacher(pid_t pid) {
+    return ((uint32_t)pid * 2654435761u) & (taille_index - 1);
+}
+
+static int index_agrandir(void) {
+    size_t ancienne_taille = taille_index;
+    Entree *ancien = index_pid;
+    size_t nouvelle_taille = ancienne_taille ? ancienne_taille * 2 : 64;
+
+    Entree *nouveau = calloc(nouvelle_taille, sizeof(Entree));
+    if (nouveau == NULL) {
+        return -1;
+    }
+    index_pid = nouveau;
+    taille_index = nouvelle_taille;
+    for (size_t i = 0; i < ancienne_taille; i++) {
+        if (ancien[i].pid != 0) {
+            size_t j = hacher(ancien[i].pid);
+            while (index_pid[j].pid != 0) {
+                j = (j + 1) & (taille_index - 1);
+            }
+            index_pid[j] = ancien[i];
+        }
+    }
+    free(ancien);
+    return 0;
+}
+
+static int index_inserer(pid_t pid, int id) {
+    if ((occupes_index + 1) * 2 > taille_index && index_agrandir() == -1) {
+        return -1;
+    }
+    size_t i = hacher(pid);
+    while (index_pid[i].pid != 0) {
+        i = (i + 1) & (taille_index - 1);
+    }
+    index_pid[i].pid = pid;
+    index_pid[i].id = id;
+    occupes_index++;
+    return 0;
+}
+
+static Entree *index_chercher(pid_t pid) {
+    if (taille_index == 0 || pid <= 0) {
+        return NULL;
+    }
+    size_t i = hacher(pid);
+    while (index_pid[i].pid != 0) {
+        if (index_pid[i].pid == pid) {
+            return &index_pid[i];
+        }
+        i = (i + 1) & (taille_index - 1);
+    }
+    return NULL;
+}
+
+// Suppression par décalage arrière : pas de case "supprimée" qui rallongerait
+// les sondages au fil des ajouts et retraits
+static void index_retirer(pid_t pid) {
+    Entree *e = index_chercher(pid);
+    if (e == NULL) {
+        return;
+    }
+    size_t masque = taille_index - 1;
+    size_t i = e - index_pid;
+    size_t j = i;
+    while (1) {
+        j = (j + 1) & masque;
+        if (index_pid[j].pid == 0) {
+            break;
+        }
+        size_t k = hacher(index_pid[j].pid);
+        // L'entrée j peut remonter en i si sa case idéale k n'est pas dans ]i, j]
+        int reste = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (!reste) {
+            index_pid[i] = index_pid[j];
+            i = j;
+        }
+    }
+    index_pid[i].pid = 0;
+    occupes_index--;
+}
+
+
+// ================================================================================================
+// Tas des échéances
+
+static int plus_proche(const Job *a, const Job *b) {
+    return a->echeance.tv_sec < b->echeance.tv_sec
+           || (a->echeance.tv_sec == b->echeance.tv_sec && a->echeance.tv_nsec < b->echeance.tv_nsec);
+}
+
+static void placer(int i, Job *job) {
+    echeances[i] = job;
+    job->rang_echeance = i + 1;
+}
+
+// Remonte ou descend la tâche de la case i jusqu'à sa place
+static void tasser(int i) {
+    Job *job = echeances[i];
+    while (i > 0 && plus_proche(job, echeances[(i - 1) / 2])) {
+        placer(i, echeances[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    while (1) {
+        int f = 2 * i + 1;
+        if (f >= nb_echeances) {
+            break;
+        }
+        if (f + 1 < nb_echeances && plus_proche(echeances[f + 1], echeances[f])) {
+            f++;
+        }
+        if (!plus_proche(echeances[f], job)) {
+            break;
+        }
+        placer(i, echeances[f]);
+        i = f;
+    }
+    placer(i, job);
+}
+
+static void retirer_echeance(Job *job) {
+    int i = job->rang_echeance - 1;
+    job->rang_echeance = 0;
+    if (--nb_echeances > i) {
+        placer(i, echeances[nb_echeances]);
+        tasser(i);
+    }
+}
+
+int fixer_echeance(Job *job, struct timespec echeance) {
+    if (echeance.tv_sec == 0) {
+        if (job->rang_echeance != 0) {
+            retirer_echeance(job);
+        }
+        job->echeance = echeance;
+        return 0;
+    }
+    if (job->rang_echeance == 0) {
+        if (nb_echeances == cap_echeances) {
+            int cap = cap_echeances ? cap_echeances * 2 : 16;
+            Job **e = realloc(echeances, cap * sizeof(Job *));
+            if (e == NULL) {
+                return -1;
+            }
+            echeances = e;
+            cap_echeances = cap;
+        }
+        placer(nb_echeances++, job);
+    }
+    job->echeance = echeance;
+    tasser(job->rang_echeance - 1);
+    return 0;
+}
+
+Job *prochaine_echeance(void) {
+    return nb_echeances > 0 ? echeances[0] : NULL;
+}
+
+
+// ================================================================================================
+// Table des tâches
+
+static int reserver_id(void) {
+    if (nb_libres > 0) {
+        return libres[--nb_libres];
+    }
+    if (prochain_id > capacite) {
+        int nouvelle = capacite ? capacite * 2 : 16;
+        Job **e = realloc(emplacements, nouvelle * sizeof(Job *));
+        if (e == NULL) {
+            return -1;
+        }
+        emplacements = e;
+        int *l = realloc(libres, nouvelle * sizeof(int));
+        if (l == NULL) {
+            return -1;
+        }
+        libres = l;
+        for (int i = capacite; i < nouvelle; i++) {
+            emplacements[i] = NULL;
+        }
+        capacite = nouvelle;
+    }
+    return prochain_id++;
+}
+
+static void liberer_job(Job *job) {
+    if (job->cgroupe != NULL) {
+        rmdir(job->cgroupe);
+        free(job->cgroupe);
+    }
+    free(job->trace);
+    free(job->ecriture);
+    free(job->pids);
+    free(job->command);
+    free(job);
+}
+
+Job *ajouter_job(pid_t pgid, const pid_t *pids, int nb, const char *command) {
+    Job *job = calloc(1, sizeof(Job));
+    if (job == NULL) {
+        return NULL;
+    }
+    job->pgid = pgid;
+    job->pids = malloc(nb * sizeof(pid_t));
+    job->command = strdup(command);
+    job->id = (job->pids && job->command) ? reserver_id() : -1;
+    if (job->id == -1) {
+        liberer_job(job);
+        return NULL;
+    }
+    memcpy(job->pids, pids, nb * sizeof(pid_t));
+    job->nb_pids = nb;
+    job->pid = pids[nb - 1];
+    job->etat = JOB_EN_COURS;
+    clock_gettime(CLOCK_MONOTONIC, &job->debut);
+    for (int i = 0; i < nb; i++) {
+        if (index_inserer(pids[i], job->id) == -1) {
+            while (i-- > 0) {
+                index_retirer(pids[i]);
+            }
+            libres[nb_libres++] = job->id;
+            liberer_job(job);
+            return NULL;
+        }
+    }
+    job->nb_vivants = nb;
+    emplacements[job->id - 1] = job;
+    nb_jobs++;
+    return job;
+}
+
+static void cumuler(struct rusage *total, const struct rusage *u) {
+    timeradd(&total->ru_utime, &u->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &u->ru_stime, &total->ru_stime);
+    if (u->ru_maxrss > total->ru_maxrss) {
+        total->ru_maxrss = u->ru_maxrss;
+    }
+    total->ru_minflt += u->ru_minflt;
+    total->ru_majflt += u->ru_majflt;
+    total->ru_inblock += u->ru_inblock;
+    total->ru_oublock += u->ru_oublock;
+    total->ru_nvcsw += u->ru_nvcsw;
+    total->ru_nivcsw += u->ru_nivcsw;
+}
+
+int terminer_pid(Job *job, pid_t pid, int statut, const struct rusage *usage) {
+    // Le pid peut être réattribué dès maintenant : il quitte l'index, et
+    // pids ne garde que les processus vivants (0 pour les autres)
+    index_retirer(pid);
+    for (int i = 0; i < job->nb_pids; i++) {
+        if (job->pids[i] == pid) {
+            job->pids[i] = 0;
+        }
+    }
+    cumuler(&job->usage, usage);
+    if (pid == job->pid) {
+        job->statut = statut;
+    }
+    if (--job->nb_vivants > 0) {
+        return 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &job->fin);
+    job->termine = 1;
+    job->etat = JOB_TERMINE;
+    return 1;
+}
+
+void arreter_job(Job *job) {
+    job->etat = JOB_ARRETE;
+}
+
+void reprendre_job(Job *job) {
+    job->etat = JOB_EN_COURS;
+}
+
+double duree_job(const Job *job) {
+    struct timespec fin = job->fin;
+    if (!job->termine) {
+        clock_gettime(CLOCK_MONOTONIC, &fin);
+    }
+    return (fin.tv_sec - job->debut.tv_sec) + (fin.tv_nsec - job->debut.tv_nsec) / 1e9;
+}
+
+void retirer_job(Job *job) {
+    if (job->rang_echeance != 0) {
+        retirer_echeance(job);
+    }
+    for (int i = 0; i < job->nb_pids; i++) {
+        if (job->pids[i] != 0) {
+            index_retirer(job->pids[i]);
+        }
+    }
+    emplacements[job->id - 1] = NULL;
+    nb_jobs--;
+    if (nb_jobs == 0) {
+        // Table vide : la numérotation repart de %1
+        nb_libres = 0;
+        prochain_id = 1;
+    } else {
+        libres[nb_libres++] = job->id;
+    }
+    liberer_job(job);
+}
+
+Job *chercher_job_pid(pid_t pid) {
+    Entree *e = index_chercher(pid);
+    return e ? emplacements[e->id - 1] : NULL;
+}
+
+Job *chercher_job_id(int id) {
+    if (id < 1 || id >= prochain_id) {
+        return NULL;
+    }
+    return emplacements[id - 1];
+}
+
+Job *chercher_job(const char *designation) {
+    char *fin;
+    if (designation[0] == '%') {
+        designation++;
+    }
+    long id = strtol(designation, &fin, 10);
+    if (fin == designation || *fin != '\0' || id < 1 || id > INT32_MAX) {
+        return NULL;
+    }
+    return chercher_job_id((int)id);
+}
+
+int nombre_jobs(void) {
+    return nb_jobs;
+}
+
+Job *job_suivant(Job *prec) {
+    for (int i = prec ? prec->id : 0; i < prochain_id - 1; i++) {
+        if (emplacements[i] != NULL) {
+            return emplacements[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,94 @@
+/*****************************************************
+ * Ensishell : table des tâches en arrière-plan      *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __JOBS_H
+#define __JOBS_H
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/* États d'une tâche */
+enum { JOB_EN_COURS, JOB_ARRETE, JOB_TERMINE };
+
+/* Un pipeline lancé par le shell, avec tous ses processus. Son numéro (%1,
+   %2...) ne change pas tant qu'il est dans la table ; il est réutilisé
+   après son retrait. */
+typedef struct {
+    int id;
+    pid_t pgid;             /* Groupe de processus du pipeline, 0 : celui du shell */
+    pid_t *pids;            /* Un pid par étape lancée, dans l'ordre du pipeline,
+                               0 une fois le processus terminé */
+    int nb_pids;
+    int nb_vivants;
+    pid_t pid;              /* Dernière étape, qui donne le statut du pipeline */
+    char *command;
+    struct timespec debut;  /* CLOCK_MONOTONIC au lancement */
+    int etat;
+
+    /* Limites (préfixes timeout et limit) */
+    struct timespec echeance; /* CLOCK_MONOTONIC où le shell l'interrompt, 0 : aucune */
+    int rang_echeance;      /* Case (+1) dans le tas des échéances, 0 : hors du tas */
+    int depasse;            /* Échéance atteinte : SIGTERM envoyé, SIGKILL ensuite */
+    char *cgroupe;          /* Feuille cgroup v2 de la tâche, supprimée avec elle */
+    void *trace;            /* Enregistrement de trace en cours, libéré avec elle */
+    void *ecriture;         /* Sortie atomique (Redirections) publiée à sa fin */
+
+    /* Renseignés par terminer_pid() au fil des fins des processus */
+    int termine;            /* Tous les processus sont terminés */
+    int statut;             /* Statut brut de wait4 pour pid */
+    struct rusage usage;    /* Cumul des processus terminés (maxrss : maximum) */
+    struct timespec fin;
+} Job;
+
+/* Ajoute une tâche formée des nb processus pids (recopiés, comme la
+   commande), dans le groupe pgid. Renvoie NULL si la mémoire manque.
+   Temps constant amorti. */
+Job *ajouter_job(pid_t pgid, const pid_t *pids, int nb, const char *command);
+
+/* Enregistre la fin du processus pid de la tâche, avec le statut et la
+   consommation renvoyés par wait4. Renvoie 1 quand c'était le dernier
+   processus vivant : la tâche est alors terminée (heure de fin). */
+int terminer_pid(Job *job, pid_t pid, int statut, const struct rusage *usage);
+
+/* Changements d'état signalés par SIGCHLD (WIFSTOPPED, WIFCONTINUED) ou
+   provoqués par fg/bg */
+void arreter_job(Job *job);
+void reprendre_job(Job *job);
+
+/* Durée écoulée en secondes depuis le lancement (jusqu'à la fin si terminée) */
+double duree_job(const Job *job);
+
+/* Fixe l'échéance de la tâche, ou la supprime si echeance vaut 0. Les
+   tâches qui en ont une sont rangées dans un tas, la plus proche en tête :
+   O(log n). Renvoie -1 si la mémoire manque (l'échéance n'est pas posée). */
+int fixer_echeance(Job *job, struct timespec echeance);
+
+/* Tâche dont l'échéance est la plus proche, NULL si aucune n'en a. Temps
+   constant. */
+Job *prochaine_echeance(void);
+
+/* Retire la tâche de la table (et du tas des échéances) et la libère, avec
+   son cgroupe. Temps constant, O(log n) avec une échéance. */
+void retirer_job(Job *job);
+
+/* Recherche par pid (de n'importe quel processus vivant de la tâche) ou
+   par numéro, NULL si absente. Temps constant. */
+Job *chercher_job_pid(pid_t pid);
+Job *chercher_job_id(int id);
+
+/* Recherche à partir d'une désignation "%n" ou "n". NULL si absente ou
+   mal formée. */
+Job *chercher_job(const char *designation);
+
+/* Nombre de tâches dans la table */
+int nombre_jobs(void);
+
+/* Tâche suivante dans l'ordre des numéros (la première si prec vaut NULL),
+   NULL à la fin. */
+Job *job_suivant(Job *prec);
+
+#endif
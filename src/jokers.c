@@ -0,0 +1,511 @@
+/*****************************************************
+ * Ensishell : expansion des jokers (*, ?, [...])    *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour qsort_r
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <pwd.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "jokers.h"
+#include "globstar.h"
+
+// Liste des entrées d'un répertoire, gardée en cache et identifiée par son
+// inode : elle reste valable tant que la date de modification ne change pas
+typedef struct {
+    int occupe;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    int fiable;             // Lue strictement après la dernière modification
+    unsigned epoque;        // Dernier appel de developper_jokers qui l'a lue
+    unsigned usage;         // Pour choisir la liste à remplacer (LRU)
+    int epingles;           // Parcours en cours sur cette liste
+    size_t nb;
+    char **noms;            // Pointent dans tampon
+    unsigned char *types;   // d_type de chaque entrée
+    char *tampon;
+} Liste;
+
+#define NB_LISTES 16
+
+static Liste cache[NB_LISTES];
+static unsigned epoque = 0;
+static unsigned horloge = 0;
+
+// Mots produits : leurs caractères sont mis bout à bout dans texte, pos
+// donne le début de chacun. Les deux tableaux grandissent par doublement.
+typedef struct {
+    size_t *pos;
+    size_t n, cap;
+    char *texte;
+    size_t taille, cap_texte;
+} Mots;
+
+
+// ================================================================================================
+// Utilitaires
+
+int contient_jokers(const char *mot) {
+    return strpbrk(mot, "*?[") != NULL;
+}
+
+// Alloue les deux tableaux de m : ils existent jusqu'à terminer, qui est
+// le seul à les libérer, y compris après une erreur
+static int commencer(Mots *m) {
+    m->n = m->taille = 0;
+    m->cap = 16;
+    m->cap_texte = 1024;
+    m->pos = malloc(m->cap * sizeof(size_t));
+    m->texte = malloc(m->cap_texte);
+    return m->pos != NULL && m->texte != NULL ? 0 : -1;
+}
+
+// Ajoute un mot ; en cas d'échec, m reste tel quel (à rendre à terminer)
+static int ajouter(Mots *m, const char *mot, size_t len) {
+    if (m->n == m->cap) {
+        size_t *p = realloc(m->pos, m->cap * 2 * sizeof(size_t));
+        if (p == NULL) {
+            return -1;
+        }
+        m->pos = p;
+        m->cap *= 2;
+    }
+    if (m->taille + len + 1 > m->cap_texte) {
+        size_t cap = m->cap_texte;
+        while (m->taille + len + 1 > cap) {
+            cap *= 2;
+        }
+        char *t = realloc(m->texte, cap);
+        if (t == NULL) {
+            return -1;
+        }
+        m->texte = t;
+        m->cap_texte = cap;
+    }
+    memcpy(m->texte + m->taille, mot, len);
+    m->texte[m->taille + len] = '\0';
+    m->pos[m->n++] = m->taille;
+    m->taille += len + 1;
+    return 0;
+}
+
+// Range les mots dans un seul bloc : le tableau de pointeurs terminé par
+// NULL, suivi des caractères. Libère m dans tous les cas.
+static char **terminer(Mots *m, int err) {
+    char **mots = NULL;
+    if (err == 0) {
+        mots = malloc((m->n + 1) * sizeof(char *) + m->taille);
+    }
+    if (mots != NULL) {
+        char *texte = (char *)(mots + m->n + 1);
+        memcpy(texte, m->texte, m->taille);
+        for (size_t i = 0; i < m->n; i++) {
+            mots[i] = texte + m->pos[i];
+        }
+        mots[m->n] = NULL;
+    }
+    free(m->pos);
+    free(m->texte);
+    return mots;
+}
+
+void liberer_mots(char **mots) {
+    free(mots);
+}
+
+static int comparer(const void *a, const void *b, void *texte) {
+    return strcoll((char *)texte + *(const size_t *)a, (char *)texte + *(const size_t *)b);
+}
+
+// "~" ou "~utilisateur" en tête de mot. Renvoie une copie développée, ou
+// une simple copie si le mot ne commence pas par un tilde connu.
+static char *developper_tilde(const char *mot) {
+    if (mot[0] != '~') {
+        return strdup(mot);
+    }
+    size_t len = strcspn(mot + 1, "/");
+    const char *maison = NULL;
+    if (len == 0) {
+        maison = getenv("HOME");
+    }
+    if (maison == NULL) {
+        char nom[len + 1];
+        memcpy(nom, mot + 1, len);
+        nom[len] = '\0';
+        struct passwd *pw = len ? getpwnam(nom) : getpwuid(getuid());
+        maison = pw ? pw->pw_dir : NULL;
+    }
+    if (maison == NULL) {
+        return strdup(mot);
+    }
+    size_t lm = strlen(maison), reste = strlen(mot + 1 + len);
+    char *res = malloc(lm + reste + 1);
+    if (res != NULL) {
+        memcpy(res, maison, lm);
+        memcpy(res + lm, mot + 1 + len, reste + 1);
+    }
+    return res;
+}
+
+
+// ================================================================================================
+// Cache des listes de répertoires
+
+static void liberer_liste(Liste *l) {
+    free(l->noms);
+    free(l->types);
+    free(l->tampon);
+    memset(l, 0, sizeof(*l));
+}
+
+void vider_cache_repertoires(void) {
+    for (int i = 0; i < NB_LISTES; i++) {
+        if (cache[i].occupe && cache[i].epingles == 0) {
+            liberer_liste(&cache[i]);
+        }
+    }
+}
+
+// Lit toutes les entrées du répertoire ouvert dans l. Renvoie -1 en cas
+// d'erreur (la liste est alors vide).
+static int lire_liste(Liste *l, DIR *d) {
+    size_t taille = 0, cap = 1 << 14;
+    size_t nb = 0, cap_nb = 256;
+    size_t *positions = malloc(cap_nb * sizeof(size_t));
+    unsigned char *types = malloc(cap_nb);
+    char *tampon = malloc(cap);
+    struct dirent *e = NULL;
+
+    while (positions && types && tampon && (e = readdir(d)) != NULL) {
+        size_t len = strlen(e->d_name) + 1;
+        if (taille + len > cap) {
+            while (taille + len > cap) {
+                cap *= 2;
+            }
+            char *t = realloc(tampon, cap);
+            if (t == NULL) {
+                break;
+            }
+            tampon = t;
+        }
+        if (nb == cap_nb) {
+            cap_nb *= 2;
+            size_t *p = realloc(positions, cap_nb * sizeof(size_t));
+            unsigned char *ty = p ? realloc(types, cap_nb) : NULL;
+            if (p != NULL) {
+                positions = p;
+            }
+            if (ty == NULL) {
+                break;
+            }
+            types = ty;
+        }
+        memcpy(tampon + taille, e->d_name, len);
+        positions[nb] = taille;
+        types[nb] = e->d_type;
+        taille += len;
+        nb++;
+    }
+
+    // Les noms ne sont rangés qu'une fois le tampon à sa taille définitive
+    char **noms = (e == NULL && positions && types && tampon)
+                  ? malloc((nb ? nb : 1) * sizeof(char *)) : NULL;
+    if (noms == NULL) {
+        free(positions);
+        free(types);
+        free(tampon);
+        l->nb = 0;
+        return -1;
+    }
+    for (size_t i = 0; i < nb; i++) {
+        noms[i] = tampon + positions[i];
+    }
+    free(positions);
+    l->nb = nb;
+    l->noms = noms;
+    l->types = types;
+    l->tampon = tampon;
+    return 0;
+}
+
+// Renvoie la liste du répertoire chemin, épinglée (à rendre avec relacher),
+// lue au plus une fois par appel de developper_jokers. NULL si ce n'est pas
+// un répertoire lisible.
+static Liste *ouvrir_liste(const char *chemin) {
+    struct stat st;
+    if (stat(chemin, &st) == -1 || !S_ISDIR(st.st_mode)) {
+        return NULL;
+    }
+
+    Liste *l = NULL;
+    for (int i = 0; i < NB_LISTES; i++) {
+        if (cache[i].occupe && cache[i].dev == st.st_dev && cache[i].ino == st.st_ino) {
+            l = &cache[i];
+            break;
+        }
+    }
+    if (l != NULL) {
+        int meme = l->mtime.tv_sec == st.st_mtim.tv_sec
+                   && l->mtime.tv_nsec == st.st_mtim.tv_nsec;
+        if (l->epoque == epoque || (l->fiable && meme)) {
+            l->epoque = epoque;
+            l->usage = ++horloge;
+            l->epingles++;
+            return l;
+        }
+        if (l->epingles > 0) {
+            return NULL;
+        }
+        liberer_liste(l);
+    } else {
+        // Une case libre, ou la liste non épinglée la moins récemment utilisée
+        for (int i = 0; i < NB_LISTES; i++) {
+            if (cache[i].epingles > 0) {
+                continue;
+            }
+            if (!cache[i].occupe) {
+                l = &cache[i];
+                break;
+            }
+            if (l == NULL || cache[i].usage < l->usage) {
+                l = &cache[i];
+            }
+        }
+        if (l == NULL) {
+            return NULL;
+        }
+        if (l->occupe) {
+            liberer_liste(l);
+        }
+    }
+
+    DIR *d = opendir(chemin);
+    if (d == NULL) {
+        return NULL;
+    }
+    struct timespec debut;
+    clock_gettime(CLOCK_REALTIME, &debut);
+    int err = lire_liste(l, d);
+    struct stat apres;
+    int stable = fstat(dirfd(d), &apres) == 0
+                 && apres.st_mtim.tv_sec == st.st_mtim.tv_sec
+                 && apres.st_mtim.tv_nsec == st.st_mtim.tv_nsec;
+    closedir(d);
+    if (err == -1) {
+        return NULL;
+    }
+
+    l->occupe = 1;
+    l->dev = st.st_dev;
+    l->ino = st.st_ino;
+    l->mtime = st.st_mtim;
+    // Une modification dans la même seconde que la lecture pourrait ne pas
+    // changer la date : une telle liste n'est réutilisée que pendant cet appel
+    l->fiable = stable && st.st_mtim.tv_sec < debut.tv_sec;
+    l->epoque = epoque;
+    l->usage = ++horloge;
+    l->epingles = 1;
+    return l;
+}
+
+static void relacher(Liste *l) {
+    l->epingles--;
+}
+
+static int est_repertoire(const char *chemin, unsigned char type) {
+    struct stat st;
+    if (type == DT_DIR) {
+        return 1;
+    }
+    if (type != DT_LNK && type != DT_UNKNOWN) {
+        return 0;
+    }
+    return stat(chemin, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+
+// ================================================================================================
+// Parcours d'un motif composante par composante
+
+typedef struct {
+    char **composantes;
+    int nb;
+    char chemin[PATH_MAX];
+} Parcours;
+
+static int parcourir(Parcours *p, Mots *resultat, size_t len, int k, int etat);
+
+// "**" : zéro, un ou plusieurs niveaux de répertoires, parcourus en parallèle.
+// Quand il ne reste qu'une composante après lui (cas de "src/**/*.c"), elle
+// est comparée pendant le parcours même ; "**" en dernier vaut "**/*".
+static int parcourir_globstar(Parcours *p, Mots *resultat, size_t len, int k) {
+    const char *motif = NULL;
+    if (k == p->nb - 1) {
+        motif = "*";
+    } else if (k == p->nb - 2 && p->composantes[k + 1][0] != '\0') {
+        motif = p->composantes[k + 1];
+    }
+
+    char **trouves;
+    size_t nb;
+    p->chemin[len] = '\0';
+    if (arpenter(p->chemin, motif, &trouves, &nb) == -1) {
+        return -1;
+    }
+    int err = 0;
+    for (size_t i = 0; i < nb; i++) {
+        if (err != 0) {
+            free(trouves[i]);
+        } else if (motif != NULL) {
+            err = ajouter(resultat, trouves[i], strlen(trouves[i]));
+            free(trouves[i]);
+        } else {
+            // Un répertoire : on continue avec les composantes suivantes
+            size_t lr = strlen(trouves[i]);
+            if (lr + 2 <= sizeof(p->chemin)) {
+                memcpy(p->chemin, trouves[i], lr);
+                err = parcourir(p, resultat, lr, k + 1, 1);
+            }
+            free(trouves[i]);
+        }
+    }
+    free(trouves);
+    return err;
+}
+
+// Ajoute à resultat les correspondances des composantes k et suivantes,
+// à la suite de p->chemin (de longueur len). resultat reste hors de p, que
+// chemin expose aux appels système. etat : 0 avant le premier joker, 1 si tout ce qui suit le
+// dernier joker a été lu dans un répertoire, 2 si une composante sans joker
+// a été ajoutée depuis (le chemin complet doit alors exister).
+static int parcourir(Parcours *p, Mots *resultat, size_t len, int k, int etat) {
+    if (k == p->nb) {
+        struct stat st;
+        p->chemin[len] = '\0';
+        if (etat == 2 && lstat(p->chemin, &st) == -1) {
+            return 0;
+        }
+        return ajouter(resultat, p->chemin, len);
+    }
+
+    const char *comp = p->composantes[k];
+    int dernier = (k == p->nb - 1);
+
+    if (strcmp(comp, "**") == 0) {
+        return parcourir_globstar(p, resultat, len, k);
+    }
+
+    if (!contient_jokers(comp)) {
+        size_t lc = strlen(comp);
+        if (len + lc + 2 > sizeof(p->chemin)) {
+            return 0;
+        }
+        memcpy(p->chemin + len, comp, lc);
+        len += lc;
+        if (!dernier) {
+            p->chemin[len++] = '/';
+        }
+        return parcourir(p, resultat, len, k + 1, etat ? 2 : 0);
+    }
+
+    p->chemin[len] = '\0';
+    Liste *l = ouvrir_liste(len ? p->chemin : ".");
+    if (l == NULL) {
+        return 0;
+    }
+    int err = 0;
+    for (size_t i = 0; i < l->nb && err == 0; i++) {
+        const char *nom = l->noms[i];
+        if (fnmatch(comp, nom, FNM_PERIOD) != 0) {
+            continue;
+        }
+        size_t ln = strlen(nom);
+        if (len + ln + 2 > sizeof(p->chemin)) {
+            continue;
+        }
+        memcpy(p->chemin + len, nom, ln + 1);
+        if (!dernier) {
+            if (!est_repertoire(p->chemin, l->types[i])) {
+                continue;
+            }
+            p->chemin[len + ln] = '/';
+            err = parcourir(p, resultat, len + ln + 1, k + 1, 1);
+        } else {
+            err = parcourir(p, resultat, len + ln, k + 1, 1);
+        }
+    }
+    relacher(l);
+    return err;
+}
+
+// Ajoute à resultat les correspondances du motif, triées, ou le motif
+// lui-même s'il n'y en a aucune
+static int developper_motif(Mots *resultat, char *motif) {
+    // Découpage en composantes sur place ; un motif absolu commence par "/"
+    int nb = 1;
+    for (char *c = motif; *c; c++) {
+        nb += (*c == '/');
+    }
+    char *composantes[nb];
+    Parcours p = {.composantes = composantes, .nb = 0};
+    char *copie = strdup(motif);
+    if (copie == NULL) {
+        return -1;
+    }
+    size_t len = 0;
+    char *debut = copie;
+    if (*debut == '/') {
+        p.chemin[len++] = '/';
+        debut++;
+    }
+    while (1) {
+        char *barre = strchr(debut, '/');
+        composantes[p.nb++] = debut;
+        if (barre == NULL) {
+            break;
+        }
+        *barre = '\0';
+        debut = barre + 1;
+    }
+
+    size_t avant = resultat->n;
+    int err = parcourir(&p, resultat, len, 0, 0);
+    free(copie);
+    if (err == 0 && resultat->n == avant) {
+        return ajouter(resultat, motif, strlen(motif));
+    }
+    qsort_r(resultat->pos + avant, resultat->n - avant, sizeof(size_t), comparer,
+            resultat->texte);
+    return err;
+}
+
+char **developper_jokers(char **mots) {
+    Mots resultat;
+    int err = commencer(&resultat);
+
+    epoque++;
+    for (size_t i = 0; mots[i] != NULL && err == 0; i++) {
+        char *mot = developper_tilde(mots[i]);
+        if (mot == NULL) {
+            err = -1;
+        } else if (!contient_jokers(mot)) {
+            // Pas de joker : aucun accès au système de fichiers
+            err = ajouter(&resultat, mot, strlen(mot));
+        } else {
+            err = developper_motif(&resultat, mot);
+        }
+        free(mot);
+    }
+    return terminer(&resultat, err);
+}
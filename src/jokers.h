@@ -0,0 +1,31 @@
+/*****************************************************
+ * Ensishell : expansion des jokers (*, ?, [...])    *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __JOKERS_H
+#define __JOKERS_H
+
+/* Vrai si le mot contient un joker (*, ? ou [) */
+int contient_jokers(const char *mot);
+
+/* Expanse les jokers et le tilde de tous les mots (tableau terminé par NULL),
+   comme glob(GLOB_NOCHECK | GLOB_TILDE) : un motif sans correspondance est
+   gardé tel quel, les correspondances d'un motif sont triées.
+   Une composante "**" vaut zéro, un ou plusieurs répertoires (hors
+   répertoires cachés et liens symboliques), parcourus en parallèle.
+   Chaque répertoire est lu au plus une fois par appel, quel que soit le
+   nombre de motifs qui le parcourent ; les listes lues restent en cache
+   d'un appel à l'autre tant que le répertoire n'est pas modifié.
+   Renvoie un nouveau tableau, alloué d'un seul bloc avec les chaînes (à
+   libérer avec liberer_mots), ou NULL si la mémoire manque. */
+char **developper_jokers(char **mots);
+
+/* Libère un tableau rendu par developper_jokers ou developper_accolades */
+void liberer_mots(char **mots);
+
+/* Oublie toutes les listes de répertoires en cache */
+void vider_cache_repertoires(void);
+
+#endif
@@ -0,0 +1,454 @@
+/*****************************************************
+ * Ensishell : limites de ressources des commandes   *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour asprintf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <mntent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "limites.h"
+
+// Période de cpu.max en microsecondes (valeur par défaut du noyau)
+#define PERIODE_CPU 100000
+
+// Cgroupe propre au shell (NULL tant qu'il n'a pas servi) : le shell est dans
+// sa feuille "shell", chaque pipeline limité dans une feuille "tache-N"
+static char *racine = NULL;
+static char *cgroupe_origine = NULL;
+static unsigned nb_taches = 0;
+
+
+// ================================================================================================
+// Lecture des valeurs
+
+// Taille en octets, suffixes K, M, G (puissances de 1024)
+static int lire_taille(const char *texte, long long *valeur) {
+    char *fin;
+    errno = 0;
+    long long v = strtoll(texte, &fin, 10);
+    int decalage = 0;
+    switch (*fin) {
+    case 'k': case 'K': decalage = 10; fin++; break;
+    case 'm': case 'M': decalage = 20; fin++; break;
+    case 'g': case 'G': decalage = 30; fin++; break;
+    }
+    if (fin == texte || *fin != '\0' || errno != 0 || v <= 0 || v > (LLONG_MAX >> decalage)) {
+        return -1;
+    }
+    *valeur = v << decalage;
+    return 0;
+}
+
+// Durée en secondes, suffixes s, m, h
+static int lire_duree(const char *texte, double *valeur) {
+    char *fin;
+    double v = strtod(texte, &fin);
+    switch (*fin) {
+    case 's': fin++; break;
+    case 'm': v *= 60; fin++; break;
+    case 'h': v *= 3600; fin++; break;
+    }
+    if (fin == texte || *fin != '\0' || !(v > 0 && v < 1e9)) {
+        return -1;
+    }
+    *valeur = v;
+    return 0;
+}
+
+static int ajouter_rlimit(Limites *lim, int ressource, rlim_t valeur) {
+    for (int i = 0; i < lim->nb; i++) {
+        if (lim->ressources[i] == ressource) {
+            lim->valeurs[i] = valeur;
+            return 0;
+        }
+    }
+    if (lim->nb == MAX_RLIMITS) {
+        return -1;
+    }
+    lim->ressources[lim->nb] = ressource;
+    lim->valeurs[lim->nb++] = valeur;
+    return 0;
+}
+
+// Une clé de "limit", renvoie -1 si inconnue ou si la valeur est mal formée
+static int lire_cle(Limites *lim, const char *cle, const char *valeur) {
+    long long taille;
+    double duree;
+
+    if (strcmp(cle, "cpu") == 0 && lire_duree(valeur, &duree) == 0) {
+        // Secondes entières pour RLIMIT_CPU, arrondies au-dessus
+        rlim_t secondes = (rlim_t)duree;
+        return ajouter_rlimit(lim, RLIMIT_CPU, secondes + (duree > secondes));
+    }
+    if (strcmp(cle, "mem") == 0 && lire_taille(valeur, &taille) == 0) {
+        lim->memoire = taille;
+        return ajouter_rlimit(lim, RLIMIT_AS, (rlim_t)taille);
+    }
+    if (strcmp(cle, "fsize") == 0 && lire_taille(valeur, &taille) == 0) {
+        return ajouter_rlimit(lim, RLIMIT_FSIZE, (rlim_t)taille);
+    }
+    if (strcmp(cle, "nofile") == 0 && lire_taille(valeur, &taille) == 0) {
+        return ajouter_rlimit(lim, RLIMIT_NOFILE, (rlim_t)taille);
+    }
+    if (strcmp(cle, "nproc") == 0 && lire_taille(valeur, &taille) == 0) {
+        return ajouter_rlimit(lim, RLIMIT_NPROC, (rlim_t)taille);
+    }
+    if (strcmp(cle, "temps") == 0) {
+        return lire_duree(valeur, &lim->temps);
+    }
+    if (strcmp(cle, "cpus") == 0) {
+        return lire_duree(valeur, &lim->cpus);
+    }
+    return -1;
+}
+
+int lire_limites(char **mots, Limites *lim) {
+    memset(lim, 0, sizeof(*lim));
+    lim->fd_procs = -1;
+
+    int i = 0;
+    while (mots[i] != NULL) {
+        if (strcmp(mots[i], "timeout") == 0) {
+            if (mots[i + 1] == NULL || lire_duree(mots[i + 1], &lim->temps) == -1) {
+                fprintf(stderr, "timeout: durée invalide (usage : timeout DUREE commande)\n");
+                return -1;
+            }
+        } else if (strcmp(mots[i], "limit") == 0) {
+            const char *cles = mots[i + 1];
+            if (cles == NULL) {
+                fprintf(stderr, "usage : limit cle=valeur[,cle=valeur...] commande\n");
+                return -1;
+            }
+            while (*cles != '\0') {
+                size_t n = strcspn(cles, ",");
+                char cle[80];
+                char *egal = NULL;
+                if (n < sizeof(cle)) {
+                    memcpy(cle, cles, n);
+                    cle[n] = '\0';
+                    egal = strchr(cle, '=');
+                }
+                if (egal == NULL || (*egal = '\0', lire_cle(lim, cle, egal + 1) == -1)) {
+                    fprintf(stderr, "limit: %.*s : limite invalide\n", (int)n, cles);
+                    return -1;
+                }
+                cles += n + (cles[n] == ',');
+            }
+        } else {
+            break;
+        }
+        i += 2;
+    }
+    return i;
+}
+
+int limites_vides(const Limites *lim) {
+    return lim->nb == 0 && lim->fd_procs == -1;
+}
+
+
+// ================================================================================================
+// Cgroupes v2
+
+static int ecrire_fichier(const char *rep, const char *nom, const char *texte) {
+    char chemin[PATH_MAX];
+    snprintf(chemin, sizeof(chemin), "%s/%s", rep, nom);
+    int fd = open(chemin, O_WRONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t n = write(fd, texte, strlen(texte));
+    int erreur = errno;
+    close(fd);
+    errno = erreur;
+    return n == (ssize_t)strlen(texte) ? 0 : -1;
+}
+
+// Répertoire du cgroupe v2 du shell : point de montage de cgroup2 suivi du
+// chemin de la ligne "0::" de /proc/self/cgroup
+static char *cgroupe_courant(void) {
+    char point[PATH_MAX] = "";
+    FILE *f = setmntent("/proc/self/mounts", "r");
+    if (f != NULL) {
+        struct mntent *m;
+        while ((m = getmntent(f)) != NULL) {
+            if (strcmp(m->mnt_type, "cgroup2") == 0) {
+                snprintf(point, sizeof(point), "%s", m->mnt_dir);
+                break;
+            }
+        }
+        endmntent(f);
+    }
+    f = fopen("/proc/self/cgroup", "r");
+    if (point[0] == '\0' || f == NULL) {
+        if (f != NULL) {
+            fclose(f);
+        }
+        errno = ENOENT;
+        return NULL;
+    }
+    char ligne[PATH_MAX];
+    char *chemin = NULL;
+    while (fgets(ligne, sizeof(ligne), f) != NULL) {
+        if (strncmp(ligne, "0::", 3) == 0) {
+            ligne[strcspn(ligne, "\n")] = '\0';
+            if (asprintf(&chemin, "%s%s", point, strcmp(ligne + 3, "/") ? ligne + 3 : "") == -1) {
+                chemin = NULL;
+            }
+            break;
+        }
+    }
+    fclose(f);
+    if (chemin == NULL) {
+        errno = ENOENT;
+    }
+    return chemin;
+}
+
+// À la sortie du shell : retour dans le cgroupe d'origine, suppression des
+// répertoires créés (les feuilles des tâches ont été supprimées avec elles)
+static void quitter_cgroupe(void) {
+    char shell[PATH_MAX], pid[32];
+    snprintf(pid, sizeof(pid), "%d", getpid());
+    snprintf(shell, sizeof(shell), "%s/shell", racine);
+    if (ecrire_fichier(cgroupe_origine, "cgroup.procs", pid) == 0) {
+        rmdir(shell);
+        rmdir(racine);
+    }
+}
+
+// Règle des cgroupes v2 : pas de processus dans un cgroupe qui délègue des
+// contrôleurs à ses fils. Le shell passe donc dans racine/shell, à côté des
+// feuilles des tâches.
+static int preparer_racine(void) {
+    char shell[PATH_MAX], pid[32];
+
+    if (racine != NULL) {
+        return 0;
+    }
+    char *origine = cgroupe_courant();
+    if (origine == NULL) {
+        fprintf(stderr, "cgroupe: pas de hiérarchie cgroup v2 montée\n");
+        return -1;
+    }
+    char *r;
+    if (asprintf(&r, "%s/ensishell-%d", origine, getpid()) == -1) {
+        free(origine);
+        return -1;
+    }
+    snprintf(shell, sizeof(shell), "%s/shell", r);
+    snprintf(pid, sizeof(pid), "%d", getpid());
+    // Possible seulement si l'on a reçu la délégation : sans effet sinon
+    ecrire_fichier(origine, "cgroup.subtree_control", "+cpu +memory");
+    if ((mkdir(r, 0755) == -1 && errno != EEXIST)
+        || (mkdir(shell, 0755) == -1 && errno != EEXIST)
+        || ecrire_fichier(shell, "cgroup.procs", pid) == -1
+        || ecrire_fichier(r, "cgroup.subtree_control", "+cpu +memory") == -1) {
+        int erreur = errno;
+        fprintf(stderr, "cgroupe: %s : %s%s\n", r, strerror(erreur),
+                erreur == ENOENT ? " (contrôleurs cpu et memory non délégués ?)" : "");
+        ecrire_fichier(origine, "cgroup.procs", pid);
+        rmdir(shell);
+        rmdir(r);
+        free(r);
+        free(origine);
+        errno = erreur;
+        return -1;
+    }
+    racine = r;
+    cgroupe_origine = origine;
+    atexit(quitter_cgroupe);
+    return 0;
+}
+
+int creer_cgroupe(Limites *lim) {
+    char texte[64];
+
+    if (preparer_racine() == -1) {
+        return -1;
+    }
+    if (asprintf(&lim->cgroupe, "%s/tache-%u", racine, ++nb_taches) == -1) {
+        lim->cgroupe = NULL;
+        perror("cgroupe");
+        return -1;
+    }
+    if (mkdir(lim->cgroupe, 0755) == -1) {
+        goto erreur;
+    }
+    if (lim->cpus > 0) {
+        snprintf(texte, sizeof(texte), "%ld %d", (long)(lim->cpus * PERIODE_CPU + 0.5), PERIODE_CPU);
+        if (ecrire_fichier(lim->cgroupe, "cpu.max", texte) == -1) {
+            goto erreur;
+        }
+    }
+    if (lim->memoire > 0) {
+        snprintf(texte, sizeof(texte), "%lld", lim->memoire);
+        if (ecrire_fichier(lim->cgroupe, "memory.max", texte) == -1) {
+            goto erreur;
+        }
+    }
+    char procs[PATH_MAX];
+    snprintf(procs, sizeof(procs), "%s/cgroup.procs", lim->cgroupe);
+    if ((lim->fd_procs = open(procs, O_WRONLY | O_CLOEXEC)) == -1) {
+        goto erreur;
+    }
+    return 0;
+
+erreur:
+    perror(lim->cgroupe);
+    rmdir(lim->cgroupe);
+    free(lim->cgroupe);
+    lim->cgroupe = NULL;
+    return -1;
+}
+
+void appliquer_limites(const Limites *lim) {
+    if (lim->fd_procs != -1 && write(lim->fd_procs, "0", 1) != 1) {
+        static const char message[] = "cgroupe: impossible d'y placer le processus\n";
+        if (write(STDERR_FILENO, message, sizeof(message) - 1) < 0) {
+            // Rien de plus à faire dans l'enfant
+        }
+    }
+    for (int i = 0; i < lim->nb; i++) {
+        struct rlimit r;
+        if (getrlimit(lim->ressources[i], &r) == 0) {
+            // La limite dure ne peut que baisser : ne pas dépasser l'actuelle
+            r.rlim_cur = lim->valeurs[i];
+            if (r.rlim_max != RLIM_INFINITY && r.rlim_cur > r.rlim_max) {
+                r.rlim_cur = r.rlim_max;
+            }
+            // Temps CPU : SIGXCPU à la limite souple, SIGKILL une seconde
+            // plus tard seulement
+            int marge = lim->ressources[i] == RLIMIT_CPU
+                        && (r.rlim_max == RLIM_INFINITY || r.rlim_cur < r.rlim_max);
+            r.rlim_max = r.rlim_cur + marge;
+            setrlimit(lim->ressources[i], &r);
+        }
+    }
+}
+
+void liberer_limites(Limites *lim) {
+    if (lim->fd_procs != -1) {
+        close(lim->fd_procs);
+        lim->fd_procs = -1;
+    }
+}
+
+
+// ================================================================================================
+// Commande interne ulimit
+
+typedef struct {
+    char option;
+    int ressource;
+    rlim_t unite;
+    const char *description;
+} Ressource;
+
+static const Ressource ressources[] = {
+    {'c', RLIMIT_CORE, 1024, "taille des fichiers core (Ko)"},
+    {'d', RLIMIT_DATA, 1024, "taille du segment de données (Ko)"},
+    {'f', RLIMIT_FSIZE, 1024, "taille des fichiers (Ko)"},
+    {'l', RLIMIT_MEMLOCK, 1024, "mémoire verrouillée (Ko)"},
+    {'n', RLIMIT_NOFILE, 1, "fichiers ouverts"},
+    {'s', RLIMIT_STACK, 1024, "taille de la pile (Ko)"},
+    {'t', RLIMIT_CPU, 1, "temps CPU (secondes)"},
+    {'u', RLIMIT_NPROC, 1, "processus"},
+    {'v', RLIMIT_AS, 1024, "mémoire virtuelle (Ko)"},
+    {0, 0, 0, NULL}
+};
+
+static void afficher_limite(rlim_t valeur, rlim_t unite) {
+    if (valeur == RLIM_INFINITY) {
+        printf("unlimited\n");
+    } else {
+        printf("%llu\n", (unsigned long long)(valeur / unite));
+    }
+}
+
+int commande_ulimit(char **cmd) {
+    const Ressource *r = &ressources[2];   // -f par défaut, comme sh
+    int souple = 0, dure = 0, tout = 0;
+    int i = 1;
+
+    for (; cmd[i] != NULL && cmd[i][0] == '-' && cmd[i][1] != '\0'; i++) {
+        for (const char *c = cmd[i] + 1; *c != '\0'; c++) {
+            if (*c == 'S') {
+                souple = 1;
+            } else if (*c == 'H') {
+                dure = 1;
+            } else if (*c == 'a') {
+                tout = 1;
+            } else {
+                for (r = ressources; r->option != 0 && r->option != *c; r++) {
+                }
+                if (r->option == 0) {
+                    fprintf(stderr, "ulimit: -%c : option inconnue\n", *c);
+                    return 2;
+                }
+            }
+        }
+    }
+
+    if (tout) {
+        for (const Ressource *q = ressources; q->option != 0; q++) {
+            struct rlimit lim;
+            getrlimit(q->ressource, &lim);
+            // Alignement en caractères, pas en octets (descriptions en UTF-8)
+            int largeur = 0;
+            for (const char *c = q->description; *c != '\0'; c++) {
+                largeur += (*c & 0xC0) != 0x80;
+            }
+            printf("%s%*s (-%c) ", q->description, 36 - largeur, "", q->option);
+            afficher_limite(dure ? lim.rlim_max : lim.rlim_cur, q->unite);
+        }
+        return 0;
+    }
+
+    struct rlimit lim;
+    if (getrlimit(r->ressource, &lim) == -1) {
+        perror("ulimit");
+        return 1;
+    }
+    if (cmd[i] == NULL) {
+        afficher_limite(dure && !souple ? lim.rlim_max : lim.rlim_cur, r->unite);
+        return 0;
+    }
+
+    rlim_t valeur;
+    if (strcmp(cmd[i], "unlimited") == 0) {
+        valeur = RLIM_INFINITY;
+    } else {
+        char *fin;
+        errno = 0;
+        unsigned long long v = strtoull(cmd[i], &fin, 10);
+        if (fin == cmd[i] || *fin != '\0' || errno != 0 || cmd[i + 1] != NULL
+            || v > (RLIM_INFINITY - 1) / r->unite) {
+            fprintf(stderr, "usage : ulimit [-S|-H] [-a | -cdflnstuv [valeur|unlimited]]\n");
+            return 2;
+        }
+        valeur = (rlim_t)v * r->unite;
+    }
+    // Sans -S ni -H, les deux limites changent
+    if (souple || !dure) {
+        lim.rlim_cur = valeur;
+    }
+    if (dure || !souple) {
+        lim.rlim_max = valeur;
+    }
+    if (setrlimit(r->ressource, &lim) == -1) {
+        fprintf(stderr, "ulimit: -%c : %s\n", r->option, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+/*****************************************************
+ * Ensishell : limites de ressources des commandes   *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __LIMITES_H
+#define __LIMITES_H
+
+#include <sys/resource.h>
+
+#define MAX_RLIMITS 8
+
+/* Limites d'une commande, données par les préfixes "timeout DUREE" et
+   "limit cle=valeur,..." */
+typedef struct {
+    int nb;                     /* Limites à poser par setrlimit dans l'enfant */
+    int ressources[MAX_RLIMITS];
+    rlim_t valeurs[MAX_RLIMITS];
+
+    double temps;               /* Durée maximale (horloge murale) en secondes, 0 : aucune */
+
+    /* Feuille cgroup v2 (option cgroupes) : débit CPU et mémoire du pipeline */
+    double cpus;                /* cpu.max en nombre de processeurs, 0 : aucun */
+    long long memoire;          /* memory.max en octets, 0 : aucune */
+    char *cgroupe;              /* Chemin de la feuille créée, NULL sinon */
+    int fd_procs;               /* Son cgroup.procs ouvert, -1 sinon */
+} Limites;
+
+/* Lit les préfixes de limites au début de mots :
+     timeout DUREE              durée maximale (s, m ou h, secondes par défaut)
+     limit cle=valeur[,...]     cpu (temps CPU), mem, nofile, nproc, fsize,
+                                temps (comme timeout), cpus (cgroupe seulement)
+   Les tailles acceptent les suffixes K, M et G. Renvoie le nombre de mots
+   lus (0 sans préfixe), ou -1 après un message d'erreur. */
+int lire_limites(char **mots, Limites *lim);
+
+/* Rien à faire dans l'enfant (ni setrlimit ni cgroupe) */
+int limites_vides(const Limites *lim);
+
+/* Crée la feuille cgroup v2 des limites cpus et mem (sous le cgroupe du
+   shell, qui est lui-même déplacé dans une feuille à la première fois).
+   Renvoie -1 après un message si c'est impossible. */
+int creer_cgroupe(Limites *lim);
+
+/* Dans l'enfant, avant exec : rejoint le cgroupe et pose les limites.
+   N'utilise que des appels sûrs après fork. */
+void appliquer_limites(const Limites *lim);
+
+/* Ferme cgroup.procs ; la feuille (lim->cgroupe) reste à la charge de
+   l'appelant, qui la supprime quand ses processus sont terminés. */
+void liberer_limites(Limites *lim);
+
+/* Commande interne "ulimit [-S|-H] [-a | -X [valeur|unlimited]]" : limites
+   du shell lui-même, héritées par tout ce qu'il lance. Renvoie le code de
+   retour de la commande. */
+int commande_ulimit(char **cmd);
+
+#endif
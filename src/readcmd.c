@@ -37,6 +37,84 @@ static void *xrealloc(void *ptr, size_t size)
 	return p;
 }
 
+/* Arena: every allocation made by parsecmd for one line (words, argv
+   arrays, sequence) is taken from a chain of blocks by bumping a pointer,
+   and everything is released at once on the next parsecmd call. When a
+   line needed several blocks, they are merged into a single block of the
+   total size, so the following lines of similar length cost no malloc. */
+struct arena_block {
+	struct arena_block *next;
+	size_t size;
+	size_t used;
+	size_t last;	/* Offset of the last allocation, which may grow in place */
+	max_align_t data[];
+};
+
+static struct arena_block *arena = 0;
+
+#define ARENA_MIN_BLOCK 4096
+#define ARENA_ALIGN(n) (((n) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+static void *arena_alloc(size_t size)
+{
+	size = ARENA_ALIGN(size);
+	if (!arena || arena->size - arena->used < size) {
+		size_t bsize = arena ? arena->size * 2 : ARENA_MIN_BLOCK;
+		while (bsize < size) bsize *= 2;
+		struct arena_block *b = xmalloc(sizeof(struct arena_block) + bsize);
+		b->next = arena;
+		b->size = bsize;
+		b->used = 0;
+		arena = b;
+	}
+	arena->last = arena->used;
+	arena->used += size;
+	return (char *) arena->data + arena->last;
+}
+
+/* Grow ptr (old_size bytes) to new_size bytes. If ptr is the last
+   allocation of the current block and there is room, it grows in place. */
+static void *arena_grow(void *ptr, size_t old_size, size_t new_size)
+{
+	if (ptr && ptr == (char *) arena->data + arena->last
+	    && arena->last + ARENA_ALIGN(new_size) <= arena->size) {
+		arena->used = arena->last + ARENA_ALIGN(new_size);
+		return ptr;
+	}
+	void *p = arena_alloc(new_size);
+	if (ptr) memcpy(p, ptr, old_size);
+	return p;
+}
+
+/* Release everything allocated since the previous reset */
+static void arena_reset(void)
+{
+	if (!arena) return;
+	if (arena->next) {
+		size_t total = 0;
+		while (arena) {
+			struct arena_block *next = arena->next;
+			total += arena->size;
+			free(arena);
+			arena = next;
+		}
+		arena = xmalloc(sizeof(struct arena_block) + total);
+		arena->next = 0;
+		arena->size = total;
+	}
+	arena->used = 0;
+	arena->last = 0;
+}
+
+static void arena_free(void)
+{
+	while (arena) {
+		struct arena_block *next = arena->next;
+		free(arena);
+		arena = next;
+	}
+}
+
 #if USE_GNU_READLINE == 0
 /* Read a line from standard input and put it in a char[] */
 char *readline(const char *prompt)
@@ -44,7 +122,7 @@ char *readline(const char *prompt)
 	size_t buf_len = 16;
 	char *buf = xmalloc(buf_len * sizeof(char));
 
-	printf(prompt);
+	fputs(prompt, stdout);
 	if (fgets(buf, buf_len, stdin) == NULL) {
 		free(buf);
 		return NULL;
@@ -65,53 +143,105 @@ char *readline(const char *prompt)
 }
 #endif
 
-#define READ_CHAR *(*cur_buf)++ = *(*cur)++
-#define SKIP_CHAR (*cur)++
-
-static void read_single_quote(char ** cur, char ** cur_buf) {
-	SKIP_CHAR;
-	while(1) {
-		char c = **cur;
-		switch(c) {
-                case '\'':
-                        SKIP_CHAR;
-                        return;
-                case '\0':
-                        fprintf(stderr, "Missing closing '\n");
-                        return;
-                default:
-                        READ_CHAR;
-                        break;
-                }
+/* Tokenizer: the line is scanned once and every token is an (offset,
+   length) view into the line itself. The plain part of a word is found
+   with a single strcspn over the delimiter set (vectorized in the libc),
+   and the word is terminated in place by writing a 0 over the delimiter,
+   which has been looked at before. Only words containing quotes or
+   backslashes are rewritten, in place too, since unquoting can only
+   remove characters. */
+#define DELIMITERS " \t<>|&'\"\\"
+
+struct token {
+	size_t off;	/* Offset in the line */
+	size_t len;
+	char kind;	/* 'w' for a word, otherwise the operator: < > | &,
+			   or one of the kinds below */
+};
+
+#define T_APPEND	'a'	/* >> */
+#define T_ALL		'b'	/* &> */
+#define T_ALL_APPEND	'c'	/* &>> */
+#define T_ERR		'e'	/* 2> */
+#define T_ERR_APPEND	'f'	/* 2>> */
+#define T_ERR_DUP	'd'	/* 2>&1 */
+
+static int is_operator(char c)
+{
+	return c == '<' || c == '>' || c == '|' || c == '&';
+}
+
+/* Operator starting with the character c, followed by next. Returns its
+   length and sets *kind. */
+static size_t operator_at(char c, const char *next, char *kind)
+{
+	*kind = c;
+	if (c == '>' && next[0] == '>') {
+		*kind = T_APPEND;
+		return 2;
+	}
+	if (c == '&' && next[0] == '>') {
+		if (next[1] == '>') {
+			*kind = T_ALL_APPEND;
+			return 3;
+		}
+		*kind = T_ALL;
+		return 2;
 	}
+	return 1;
 }
 
-static void read_double_quote(char ** cur, char ** cur_buf) {
-	SKIP_CHAR;
-	while(1) {
-		char c = **cur;
-		switch(c) {
-		case '"':
-			SKIP_CHAR;
-			return;
-		case '\\':
-			SKIP_CHAR;
-			READ_CHAR;
-			break;
-                case '\0':
-                        fprintf(stderr, "Missing closing \"\n");
-                        return;
-		default:
-			READ_CHAR;
-			break;
+/* Operator for the error output, after a word "2" followed by c == '>'.
+   Returns its length from the '>' and sets *kind. */
+static size_t err_operator_at(const char *next, char *kind)
+{
+	if (next[0] == '>') {
+		*kind = T_ERR_APPEND;
+		return 2;
+	}
+	if (next[0] == '&' && next[1] == '1') {
+		*kind = T_ERR_DUP;
+		return 3;
+	}
+	*kind = T_ERR;
+	return 1;
+}
+
+/* Offsets in the line of the '$' characters kept from quotes ('...' or a
+   backslash): they stand for themselves and are not expanded. Kept from one
+   line to the next, released with the arena. */
+static size_t *quoted_off = 0;
+static size_t nquoted = 0, quoted_cap = 0;
+
+/* Remember the '$' characters of line[from..to), which were quoted */
+static void mark_quoted(const char *line, size_t from, size_t to)
+{
+	for (size_t i = from; i < to; i++) {
+		if (line[i] != '$') continue;
+		if (nquoted == quoted_cap) {
+			quoted_cap = quoted_cap ? 2 * quoted_cap : 16;
+			quoted_off = xrealloc(quoted_off, quoted_cap * sizeof(size_t));
 		}
+		quoted_off[nquoted++] = i;
 	}
 }
 
-static void read_word(char ** cur, char ** cur_buf) {
-	while(1) {
-		char c = **cur;
-		switch (c) {
+/* Copy k characters of a word from line[*r] to line[*w] */
+static void keep(char *line, size_t *r, size_t *w, size_t k)
+{
+	if (*w != *r) memmove(line + *w, line + *r, k);
+	*r += k;
+	*w += k;
+}
+
+/* Rest of a word starting at a quote or a backslash. Characters are read at
+   *r and kept at *w (<= *r). Stops on the delimiter ending the word. */
+static void read_quoted(char *line, size_t *r, size_t *w)
+{
+	size_t k;
+
+	while (1) {
+		switch (line[*r]) {
 		case '\0':
 		case ' ':
 		case '\t':
@@ -119,189 +249,235 @@ static void read_word(char ** cur, char ** cur_buf) {
 		case '>':
 		case '|':
 		case '&':
-			**cur_buf = '\0';
 			return;
 		case '\'':
-			read_single_quote(cur, cur_buf);
+			(*r)++;
+			k = strcspn(line + *r, "'");
+			keep(line, r, w, k);
+			mark_quoted(line, *w - k, *w);
+			if (line[*r] == '\0') {
+				fprintf(stderr, "Missing closing '\n");
+				return;
+			}
+			(*r)++;
 			break;
 		case '"':
-			read_double_quote(cur, cur_buf);
+			(*r)++;
+			while (1) {
+				keep(line, r, w, strcspn(line + *r, "\"\\"));
+				if (line[*r] == '"') {
+					(*r)++;
+					break;
+				}
+				if (line[*r] == '\0') {
+					fprintf(stderr, "Missing closing \"\n");
+					return;
+				}
+				/* Backslash: the next character is kept as is */
+				(*r)++;
+				if (line[*r] != '\0') {
+					keep(line, r, w, 1);
+					mark_quoted(line, *w - 1, *w);
+				}
+			}
 			break;
 		case '\\':
-			SKIP_CHAR;
-			READ_CHAR;
+			(*r)++;
+			if (line[*r] != '\0') {
+				keep(line, r, w, 1);
+				mark_quoted(line, *w - 1, *w);
+			}
 			break;
 		default:
-			READ_CHAR;
-			break;
+			keep(line, r, w, strcspn(line + *r, DELIMITERS));
 		}
 	}
 }
 
-/* Split the string in words, according to the simple shell grammar. */
-static char **split_in_words(char *line)
+/* Split the line in tokens, according to the simple shell grammar */
+static struct token *tokenize(char *line, size_t *ntokens)
 {
-	char *cur = line;
-	char *buf = xmalloc(strlen(line) + 1);
-	char *cur_buf;
-	char **tab = 0;
-	size_t l = 0;
-	char c;
-
-	while ((c = *cur) != 0) {
-		char *w = 0;
-		switch (c) {
-		case ' ':
-		case '\t':
-			/* Ignore any whitespace */
-			cur++;
-			break;
-		case '&':
-		        w = "&";
-			cur++;
-			break;
-		case '<':
-			w = "<";
-			cur++;
-			break;
-		case '>':
-			w = ">";
-			cur++;
-			break;
-		case '|':
-			w = "|";
-			cur++;
+	size_t r = 0, n = 0, cap = 16;
+	struct token *tab = arena_alloc(cap * sizeof(struct token));
+
+	nquoted = 0;
+	while (1) {
+		char c = line[r];
+		if (c == ' ' || c == '\t') {
+			r++;
+			continue;
+		}
+		if (c == '\0')
 			break;
-		default:
-			/* Another word */
-			cur_buf = buf;
-			read_word(&cur, &cur_buf);
-			w = strdup(buf);
+		if (n + 2 > cap) {
+			tab = arena_grow(tab, cap * sizeof(struct token),
+					 2 * cap * sizeof(struct token));
+			cap *= 2;
 		}
-		if (w) {
-			tab = xrealloc(tab, (l + 1) * sizeof(char *));
-			tab[l++] = w;
+		if (is_operator(c)) {
+			tab[n].off = r;
+			tab[n].len = operator_at(c, line + r + 1, &tab[n].kind);
+			r += tab[n++].len;
+			continue;
 		}
-	}
-	tab = xrealloc(tab, (l + 1) * sizeof(char *));
-	tab[l++] = 0;
-	free(buf);
-	return tab;
-}
 
+		/* A word */
+		size_t start = r, w;
+		r += strcspn(line + r, DELIMITERS);
+		w = r;
+		if (line[r] == '\'' || line[r] == '"' || line[r] == '\\')
+			read_quoted(line, &r, &w);
+		/* r is on the delimiter, which the terminating 0 may overwrite */
+		c = line[r];
+		if (c == '>' && r == start + 1 && line[start] == '2') {
+			/* An unquoted "2" glued to '>' is not a word */
+			tab[n].off = start;
+			tab[n].len = err_operator_at(line + r + 1, &tab[n].kind);
+			r += tab[n++].len;
+			continue;
+		}
+		tab[n].off = start;
+		tab[n].len = w - start;
+		tab[n++].kind = 'w';
 
-static void freeseq(char ***seq)
-{
-	int i, j;
-
-	for (i=0; seq[i]!=0; i++) {
-		char **cmd = seq[i];
-
-		for (j=0; cmd[j]!=0; j++) free(cmd[j]);
-		free(cmd);
+		line[w] = '\0';
+		if (c == '\0')
+			break;
+		if (is_operator(c)) {
+			tab[n].off = r;
+			tab[n].len = operator_at(c, line + r + 1, &tab[n].kind);
+			r += tab[n++].len;
+			continue;
+		}
+		r++;
 	}
-	free(seq);
+	*ntokens = n;
+	return tab;
 }
 
 
-/* Free the fields of the structure but not the structure itself */
-static void freecmd(struct cmdline *s)
-{
-	if (s->in) free(s->in);
-	if (s->out) free(s->out);
-	if (s->seq) freeseq(s->seq);
-}
+/* The tokens of the current line point into it: a line given to parsecmd
+   is kept until the next call */
+static char *current_line = 0;
+static struct cmdline *static_cmdline = 0;
 
-
-struct cmdline *parsecmd(char **pline)
+static struct cmdline *parse(char *line)
 {
-	char *line = *pline;
-	static struct cmdline *static_cmdline = 0;
 	struct cmdline *s = static_cmdline;
-	char **words;
-	int i;
-	char *w;
+	struct token *tokens;
+	size_t i, ntokens;
+	struct token *t;
 	char **cmd;
 	char ***seq;
 	size_t cmd_len, seq_len;
 
-	if (line == NULL) {
-		if (s) {
-			freecmd(s);
-			free(s);
-		}
-		return static_cmdline = 0;
-	}
+	arena_reset();
+	tokens = tokenize(line, &ntokens);
 
-	cmd = xmalloc(sizeof(char *));
+	/* Every argv is a slice of one array: the words of a command followed
+	   by a null pointer, which takes the place of the "|" before the next
+	   command. ntokens + 1 slots are therefore enough, and at most
+	   ntokens + 1 commands. */
+	cmd = arena_alloc((ntokens + 1) * sizeof(char *));
 	cmd[0] = 0;
 	cmd_len = 0;
-	seq = xmalloc(sizeof(char **));
+	seq = arena_alloc((ntokens + 2) * sizeof(char **));
 	seq[0] = 0;
 	seq_len = 0;
 
-	words = split_in_words(line);
-	free(line);
-	*pline = NULL;
-
 	if (!s)
 		static_cmdline = s = xmalloc(sizeof(struct cmdline));
-	else
-		freecmd(s);
 	s->err = 0;
 	s->in = 0;
 	s->out = 0;
+	s->append = 0;
+	s->errout = 0;
+	s->errappend = 0;
+	s->errdup = 0;
+	s->errfirst = 0;
+	s->errcmd = 0;
 	s->seq = 0;
 	s->bg = 0;
+	s->quoted = 0;
+	if (nquoted != 0) {
+		s->quoted = arena_alloc((nquoted + 1) * sizeof(char *));
+		for (i = 0; i < nquoted; i++)
+			s->quoted[i] = line + quoted_off[i];
+		s->quoted[nquoted] = 0;
+	}
 
 	i = 0;
-	while ((w = words[i++]) != 0) {
-		switch (w[0]) {
+	while (i < ntokens) {
+		t = &tokens[i++];
+		switch (t->kind) {
 		case '<':
-			/* Tricky : the word can only be "<" */
 			if (s->in) {
 				s->err = "only one input file supported";
 				goto error;
 			}
-			if (words[i] == 0) {
+			if (i == ntokens) {
 				s->err = "filename missing for input redirection";
 				goto error;
 			}
-			switch(words[i][0]){
-			case '<':
-			case '>':
-			case '&':
-			case '|':
-			  s->err = "incorrect filename for input redirection";
-			  goto error;
-			  break;
+			if (tokens[i].kind != 'w') {
+				s->err = "incorrect filename for input redirection";
+				goto error;
 			}
-			s->in = words[i++];
+			s->in = line + tokens[i++].off;
 			break;
 		case '>':
-			/* Tricky : the word can only be ">" */
+		case T_APPEND:
+		case T_ALL:
+		case T_ALL_APPEND:
 			if (s->out) {
 				s->err = "only one output file supported";
 				goto error;
 			}
-			if (words[i] == 0) {
+			if (t->kind == T_ALL || t->kind == T_ALL_APPEND) {
+				if (s->errout || s->errdup) {
+					s->err = "only one error file supported";
+					goto error;
+				}
+				s->errdup = 1;
+				s->errcmd = seq_len;
+			}
+			if (i == ntokens) {
 				s->err = "filename missing for output redirection";
 				goto error;
 			}
-			switch(words[i][0]){
-			case '<':
-			case '>':
-			case '&':
-			case '|':
-			  s->err = "incorrect filename for output redirection";
-			  goto error;
-			  break;
+			if (tokens[i].kind != 'w') {
+				s->err = "incorrect filename for output redirection";
+				goto error;
 			}
-			s->out = words[i++];
+			s->append = t->kind == T_APPEND || t->kind == T_ALL_APPEND;
+			s->out = line + tokens[i++].off;
+			break;
+		case T_ERR:
+		case T_ERR_APPEND:
+		case T_ERR_DUP:
+			if (s->errout || s->errdup) {
+				s->err = "only one error file supported";
+				goto error;
+			}
+			s->errcmd = seq_len;
+			if (t->kind == T_ERR_DUP) {
+				s->errdup = 1;
+				s->errfirst = !s->out;
+				break;
+			}
+			if (i == ntokens) {
+				s->err = "filename missing for error redirection";
+				goto error;
+			}
+			if (tokens[i].kind != 'w') {
+				s->err = "incorrect filename for error redirection";
+				goto error;
+			}
+			s->errappend = t->kind == T_ERR_APPEND;
+			s->errout = line + tokens[i++].off;
 			break;
 		case '&':
-			/* Tricky : the word can only be "&" */
-			if (cmd_len == 0 || words[i] != 0) {
+			if (cmd_len == 0 || i != ntokens) {
 				s->err = "misplaced ampersand";
 				goto error;
 			}
@@ -312,75 +488,143 @@ struct cmdline *parsecmd(char **pline)
 			s->bg = 1;
 			break;
 		case '|':
-			/* Tricky : the word can only be "|" */
 			if (cmd_len == 0) {
 				s->err = "misplaced pipe";
 				goto error;
 			}
-			if (words[i] == 0) {
+			if (i == ntokens) {
 				s->err = "second command missing for pipe redirection";
 				goto error;
 			}
-			switch(words[i][0]){
-			case '<':
-			case '>':
-			case '&':
-			case '|':
-			  s->err = "incorrect pipe usage";
-			  goto error;
-			  break;
+			if (tokens[i].kind != 'w') {
+				s->err = "incorrect pipe usage";
+				goto error;
 			}
-			seq = xrealloc(seq, (seq_len + 2) * sizeof(char **));
 			seq[seq_len++] = cmd;
 			seq[seq_len] = 0;
 
-			cmd = xmalloc(sizeof(char *));
+			cmd += cmd_len + 1;
 			cmd[0] = 0;
 			cmd_len = 0;
 			break;
 		default:
-			cmd = xrealloc(cmd, (cmd_len + 2) * sizeof(char *));
-			cmd[cmd_len++] = w;
+			cmd[cmd_len++] = line + t->off;
 			cmd[cmd_len] = 0;
 		}
 	}
 
 	if (cmd_len != 0) {
-		seq = xrealloc(seq, (seq_len + 2) * sizeof(char **));
 		seq[seq_len++] = cmd;
 		seq[seq_len] = 0;
 	} else if (seq_len != 0) {
 		s->err = "misplaced pipe";
-		i--;
 		goto error;
-	} else
-		free(cmd);
-	free(words);
+	}
 	s->seq = seq;
 	return s;
 error:
-	while ((w = words[i++]) != 0) {
-		switch (w[0]) {
-		case '&':
-		case '<':
-		case '>':
-		case '|':
-			break;
-		default:
-			free(w);
-		}
+	/* Everything lives in the arena and the line, released by the next call */
+	s->in = 0;
+	s->out = 0;
+	s->errout = 0;
+	s->errdup = 0;
+	s->errfirst = 0;
+	s->quoted = 0;
+	return s;
+}
+
+struct cmdline *parsecmd(char **pline)
+{
+	char *line = *pline;
+
+	free(current_line);
+	current_line = 0;
+
+	if (line == NULL) {
+		free(static_cmdline);
+		arena_free();
+		free(quoted_off);
+		quoted_off = 0;
+		nquoted = quoted_cap = 0;
+		return static_cmdline = 0;
 	}
-	free(words);
-	freeseq(seq);
-	for (i=0; cmd[i]!=0; i++) free(cmd[i]);
-	free(cmd);
-	if (s->in) {
-		free(s->in);
-		s->in = 0;
+
+	current_line = line;
+	*pline = NULL;
+	return parse(line);
+}
+
+struct cmdline *parsecmd_line(char *line)
+{
+	free(current_line);
+	current_line = 0;
+	return parse(line);
+}
+
+/* Size of the string s in a copy (0 for a null pointer) */
+static size_t copy_size(const char *s)
+{
+	return s ? strlen(s) + 1 : 0;
+}
+
+/* Copy s at *dst, which is moved past it */
+static char *copy_string(const char *s, char **dst)
+{
+	char *c = *dst;
+	if (!s) return 0;
+	strcpy(c, s);
+	*dst += strlen(s) + 1;
+	return c;
+}
+
+struct cmdline *copycmd(const struct cmdline *l)
+{
+	size_t nseq = 0, nwords = 0, nchars = 0, nq = 0;
+	size_t i, j, k;
+
+	nchars += copy_size(l->in) + copy_size(l->out) + copy_size(l->errout);
+	for (i = 0; l->seq && l->seq[i]; i++, nseq++) {
+		for (j = 0; l->seq[i][j]; j++, nwords++)
+			nchars += strlen(l->seq[i][j]) + 1;
 	}
-	if (s->out) {
-		free(s->out);
-		s->out = 0;
+	for (k = 0; l->quoted && l->quoted[k]; k++)
+		nq++;
+
+	/* Structure, then sequence, then argv arrays, then quoted '$', then
+	   strings */
+	size_t size = sizeof(struct cmdline) + (nseq + 1) * sizeof(char **)
+		+ (nwords + nseq) * sizeof(char *) + (nq + 1) * sizeof(char *)
+		+ nchars;
+	struct cmdline *c = malloc(size);
+	if (!c) return 0;
+	*c = *l;
+	char ***seq = (char ***) (c + 1);
+	char **words = (char **) (seq + nseq + 1);
+	char **quoted = words + nwords + nseq;
+	char *chars = (char *) (quoted + nq + 1);
+
+	c->err = 0;
+	c->in = copy_string(l->in, &chars);
+	c->out = copy_string(l->out, &chars);
+	c->errout = copy_string(l->errout, &chars);
+	c->seq = l->seq ? seq : 0;
+	c->quoted = nq ? quoted : 0;
+	for (i = 0; i < nseq; i++) {
+		seq[i] = words;
+		for (j = 0; l->seq[i][j]; j++) {
+			const char *w = l->seq[i][j];
+			size_t len = strlen(w);
+			*words = copy_string(w, &chars);
+			/* The quoted '$' of this word, at the same offsets */
+			for (k = 0; k < nq; k++) {
+				if (l->quoted[k] >= w && l->quoted[k] < w + len)
+					*quoted++ = *words + (l->quoted[k] - w);
+			}
+			words++;
+		}
+		*words++ = 0;
 	}
-	return s;
+	if (nq) *quoted = 0;
+	seq[nseq] = 0;
+	return c;
 }
@@ -22,10 +22,19 @@ Display an error and call exit() in case of memory exhaustion.
 It frees also line and set it at NULL */
 struct cmdline *parsecmd(char **line);
 
+/* Same as parsecmd, for a line that stays owned by the caller (a slice of a
+   script held in memory, for instance). The line is modified in place and
+   must remain valid until the next call to parsecmd or parsecmd_line. */
+struct cmdline *parsecmd_line(char *line);
+
+/* Copy of a command line returned by parsecmd or parsecmd_line, which stays
+   valid after the next call: structure, arrays and strings are allocated in
+   a single block, released with free(). Returns NULL if memory is exhausted. */
+struct cmdline *copycmd(const struct cmdline *l);
 
 #if USE_GNU_READLINE == 0
 /* Read a line from standard input and put it in a char[] */
-char *readline(char *prompt);
+char *readline(const char *prompt);
 
 #else
 #include <readline/readline.h>
@@ -39,8 +48,21 @@ struct cmdline {
 			   displayed. The other fields are null. */
 	char *in;	/* If not null : name of file for input redirection. */
 	char *out;	/* If not null : name of file for output redirection. */
+	int   append;	/* If set, out is opened in append mode (>>). */
+	char *errout;	/* If not null : name of file for error redirection (2>). */
+	int   errappend;	/* If set, errout is opened in append mode (2>>). */
+	int   errdup;	/* If set, error output goes where standard output
+			   goes, after its own redirection (2>&1, &>). */
+	int   errfirst;	/* If set with errdup, 2>&1 came before > : error
+			   output goes where standard output went before
+			   its redirection. */
+	int   errcmd;	/* Index in seq of the command whose error output is
+			   redirected by errout or errdup. */
         int   bg;       /* If set the command must run in background */ 
 	char ***seq;	/* See comment below */
+	char **quoted;	/* If not null : null-terminated array of the '$'
+			   characters of the words of seq that were quoted
+			   ('...', \$), which must not be expanded. */
 };
 
 /* Field seq of struct cmdline :
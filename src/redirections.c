@@ -0,0 +1,245 @@
+/*****************************************************
+ * Ensishell : ouverture des redirections            *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour asprintf, O_TMPFILE et fallocate
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "redirections.h"
+
+// En dessous, la préallocation coûte plus (un appel système) qu'elle ne
+// fait gagner
+#define PREALLOCATION_MIN (64 * 1024)
+
+static unsigned nb_liens = 0;
+
+
+// ================================================================================================
+// Écriture atomique
+
+// Nom caché à côté de cible : "rep/.nom<suffixe>"
+static char *nom_voisin(const char *cible, const char *suffixe) {
+    char *nom;
+    const char *base = strrchr(cible, '/');
+    int lg_rep = base ? (int)(base - cible + 1) : 0;
+    base = base ? base + 1 : cible;
+    if (asprintf(&nom, "%.*s.%s%s", lg_rep, cible, base, suffixe) == -1) {
+        return NULL;
+    }
+    return nom;
+}
+
+// Ouvre le fichier où écrire la sortie destinée à cible : un fichier anonyme
+// du même répertoire (même système de fichiers, pour le lien final), ou à
+// défaut un fichier caché nommé. Il prend les droits de l'ancienne cible.
+// Renvoie le descripteur, -1 après un message.
+static int ouvrir_atomique(const char *cible, const struct stat *ancien, off_t estimation,
+                           Redirections *r) {
+    const char *base = strrchr(cible, '/');
+    char *rep = base ? strndup(cible, base == cible ? 1 : base - cible) : strdup(".");
+    mode_t mode = ancien ? (ancien->st_mode & 07777) : 0644;
+    if (rep == NULL) {
+        perror(cible);
+        return -1;
+    }
+    int fd = open(rep, O_TMPFILE | O_WRONLY | O_CLOEXEC, mode);
+    free(rep);
+    if (fd == -1 && errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL) {
+        perror(cible);
+        return -1;
+    }
+    if (fd == -1) {
+        // Système de fichiers sans O_TMPFILE
+        r->temporaire = nom_voisin(cible, ".XXXXXX");
+        if (r->temporaire == NULL || (fd = mkostemp(r->temporaire, O_CLOEXEC)) == -1) {
+            perror(cible);
+            free(r->temporaire);
+            r->temporaire = NULL;
+            return -1;
+        }
+        if (ancien == NULL) {
+            mode_t masque = umask(0);
+            umask(masque);
+            mode &= ~masque;
+        }
+        fchmod(fd, mode);
+    } else if (ancien != NULL) {
+        fchmod(fd, mode);   // Sans le masque appliqué par open
+    }
+
+    // Blocs réservés d'avance, sans changer la taille : le fichier final
+    // est contigu et l'écriture ne s'arrête pas sur un disque plein
+    if (estimation >= PREALLOCATION_MIN
+        && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, estimation) == 0) {
+        r->prealloue = 1;
+    }
+    r->cible = strdup(cible);
+    if (r->cible == NULL) {
+        perror(cible);
+        if (r->temporaire != NULL) {
+            unlink(r->temporaire);
+            free(r->temporaire);
+            r->temporaire = NULL;
+        }
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Donne à la sortie atomique le nom de la cible. Renvoie -1 (errno) en cas
+// d'échec, le fichier est alors perdu.
+static int lier_atomique(Redirections *r) {
+    struct stat st;
+    if (r->prealloue && fstat(r->sortie, &st) == 0) {
+        // Rend les blocs préalloués au-delà de la fin
+        if (ftruncate(r->sortie, st.st_size) == -1) {
+            return -1;
+        }
+    }
+    if (r->temporaire != NULL) {
+        return rename(r->temporaire, r->cible);
+    }
+
+    // Un fichier anonyme ne peut être lié que sous un nom libre : sous un nom
+    // temporaire, puis rename remplace la cible d'un coup
+    char chemin[64], suffixe[32];
+    snprintf(chemin, sizeof(chemin), "/proc/self/fd/%d", r->sortie);
+    snprintf(suffixe, sizeof(suffixe), ".%d.%u", (int)getpid(), nb_liens++);
+    char *lien = nom_voisin(r->cible, suffixe);
+    if (lien == NULL) {
+        return -1;
+    }
+    int ret = linkat(AT_FDCWD, chemin, AT_FDCWD, lien, AT_SYMLINK_FOLLOW);
+    if (ret == 0 && (ret = rename(lien, r->cible)) == -1) {
+        int err = errno;
+        unlink(lien);
+        errno = err;
+    }
+    free(lien);
+    return ret;
+}
+
+
+// ================================================================================================
+
+static int ouvrir_sortie(const char *nom, int ajout) {
+    int fd = open(nom, O_WRONLY | O_CREAT | O_CLOEXEC | (ajout ? O_APPEND : O_TRUNC), 0644);
+    if (fd == -1) {
+        perror(nom);
+    }
+    return fd;
+}
+
+// Ferme tout ; une sortie atomique disparaît sans remplacer la cible
+static void abandonner(Redirections *r) {
+    fermer_redirections(r);
+    if (r->cible != NULL) {
+        if (r->temporaire != NULL) {
+            unlink(r->temporaire);
+        }
+        close(r->sortie);
+        r->sortie = -1;
+        free(r->cible);
+        free(r->temporaire);
+        r->cible = r->temporaire = NULL;
+    }
+}
+
+int ouvrir_redirections(const struct cmdline *l, int atomique, Redirections *r) {
+    memset(r, 0, sizeof(*r));
+    r->entree = r->sortie = r->erreur = -1;
+    r->etape_erreur = l->errcmd;
+
+    if (l->in != NULL && (r->entree = open(l->in, O_RDONLY | O_CLOEXEC)) == -1) {
+        perror(l->in);
+        return -1;
+    }
+    if (l->out != NULL) {
+        struct stat cible, entree;
+        int existe = stat(l->out, &cible) == 0;
+        if (atomique && !l->append && (!existe || S_ISREG(cible.st_mode))) {
+            // Taille attendue : celle du fichier remplacé, sinon celle de l'entrée
+            off_t estimation = 0;
+            if (existe) {
+                estimation = cible.st_size;
+            } else if (r->entree != -1 && fstat(r->entree, &entree) == 0
+                       && S_ISREG(entree.st_mode)) {
+                estimation = entree.st_size;
+            }
+            r->sortie = ouvrir_atomique(l->out, existe ? &cible : NULL, estimation, r);
+        } else {
+            r->sortie = ouvrir_sortie(l->out, l->append);
+        }
+        if (r->sortie == -1) {
+            fermer_redirections(r);
+            return -1;
+        }
+    }
+    int derniere = 0;
+    while (l->seq[derniere + 1] != NULL) {
+        derniere++;
+    }
+    if (l->errdup && l->errfirst && l->out != NULL && l->errcmd == derniere) {
+        // cmd 2>&1 > f : la sortie d'erreur reste sur la sortie du shell
+        if ((r->erreur = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3)) == -1) {
+            perror("2>&1");
+            abandonner(r);
+            return -1;
+        }
+    } else if (l->errdup) {
+        r->erreur = ERREUR_SUR_SORTIE;
+    } else if (l->errout != NULL && (r->erreur = ouvrir_sortie(l->errout, l->errappend)) == -1) {
+        abandonner(r);
+        return -1;
+    }
+    return 0;
+}
+
+void fermer_redirections(Redirections *r) {
+    if (r->entree != -1) {
+        close(r->entree);
+        r->entree = -1;
+    }
+    if (r->erreur >= 0) {
+        close(r->erreur);
+    }
+    r->erreur = -1;
+    if (r->sortie != -1 && r->cible == NULL) {
+        close(r->sortie);
+        r->sortie = -1;
+    }
+}
+
+int publier_redirections(Redirections *r, int statut) {
+    if (r->cible != NULL && statut != 0) {
+        fprintf(stderr, "%s: non remplacé (code de retour %d)\n", r->cible, statut);
+    } else if (r->cible != NULL && lier_atomique(r) == -1) {
+        fprintf(stderr, "%s: %s\n", r->cible, strerror(errno));
+        abandonner(r);
+        return -1;
+    } else if (r->cible != NULL) {
+        // Publiée : plus rien à supprimer
+        free(r->temporaire);
+        r->temporaire = NULL;
+    }
+    abandonner(r);
+    return 0;
+}
+
+Redirections *garder_redirections(const Redirections *r) {
+    Redirections *copie = malloc(sizeof(Redirections));
+    if (copie != NULL) {
+        *copie = *r;
+    }
+    return copie;
+}
@@ -0,0 +1,51 @@
+/*****************************************************
+ * Ensishell : ouverture des redirections            *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __REDIRECTIONS_H
+#define __REDIRECTIONS_H
+
+#include "readcmd.h"
+
+/* Valeur de erreur pour 2>&1 : la sortie d'erreur suit la sortie standard */
+#define ERREUR_SUR_SORTIE (-2)
+
+/* Fichiers des redirections d'un pipeline, ouverts par le shell avant les
+   lancements (O_CLOEXEC) : les étapes les reçoivent comme des extrémités
+   de pipe. -1 : pas de redirection. */
+typedef struct {
+    int entree;             /* < : entrée de la première étape */
+    int sortie;             /* >, >>, &> : sortie de la dernière étape */
+    int erreur;             /* 2>, 2>>, 2>&1 > : sortie d'erreur de l'étape etape_erreur,
+                               ou ERREUR_SUR_SORTIE (2>&1, &>) */
+    int etape_erreur;
+
+    /* Écriture atomique de la sortie : le fichier n'apparaît sous son nom
+       qu'une fois complet */
+    char *cible;            /* Nom final, NULL sans écriture atomique */
+    char *temporaire;       /* Fichier nommé à renommer, NULL avec O_TMPFILE */
+    int prealloue;          /* fallocate fait : l'excédent est rendu à la fin */
+} Redirections;
+
+/* Ouvre les fichiers des redirections de l. Avec atomique, '>' et '&>' vers
+   un fichier ordinaire (ou absent) écrivent dans un fichier anonyme
+   (O_TMPFILE) du même répertoire, préalloué d'après la taille de l'ancien
+   fichier ou de l'entrée, qui ne remplace la cible qu'à la publication.
+   Renvoie -1 après un message (rien n'est alors ouvert). */
+int ouvrir_redirections(const struct cmdline *l, int atomique, Redirections *r);
+
+/* Ferme ce qui n'est plus utile au shell une fois les étapes lancées : tout
+   sauf une sortie atomique, gardée jusqu'à publier_redirections */
+void fermer_redirections(Redirections *r);
+
+/* Fin du pipeline de code de retour statut : une sortie atomique remplace
+   la cible (lien puis rename) si statut est nul, disparaît sinon. Ferme
+   tout. Renvoie -1 après un message si la cible n'a pas pu être remplacée. */
+int publier_redirections(Redirections *r, int statut);
+
+/* Copie allouée de r, pour qu'une tâche la publie à sa fin */
+Redirections *garder_redirections(const Redirections *r);
+
+#endif
@@ -0,0 +1,406 @@
+/*****************************************************
+ * Ensishell : réserve de processus pré-créés        *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour CLONE_PARENT
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "reserve.h"
+
+extern char **environ;
+
+#define RESERVE_MAX 64
+#define TAILLE_MESSAGE (64 * 1024)  // Au-delà, lancement normal
+
+// Commande : en-tête, puis le chemin, les mots et l'environnement terminés
+// par '\0' (chemin vide : recherche dans le PATH). Les trois descripteurs
+// l'accompagnent. L'environnement et les limites sont ceux du shell au
+// lancement : le processus a ceux du générateur, figés à sa création.
+typedef struct {
+    int32_t pgid;
+    int32_t nb_mots;
+    int32_t nb_variables;
+    struct rlimit limites[RLIM_NLIMITS];
+} EnTete;
+
+// Les processus de la réserve ne sont pas créés par le shell mais par un
+// générateur, créé une fois : un fork du shell rendrait toutes ses pages
+// copie-sur-écriture, et chaque écriture du shell coûterait ensuite une faute
+// de page. Le générateur n'écrit presque rien ; avec CLONE_PARENT, ses
+// processus sont des fils du shell, attendus par wait4 comme les autres.
+static pid_t generateur = -1;
+static int fd_generateur = -1;      // Côté shell : demandes et réponses
+
+static int voulus = 0;
+static int demandes = 0;            // Processus demandés, pas encore reçus
+static int nb_prets = 0;
+static pid_t pids[RESERVE_MAX];
+static int sockets[RESERVE_MAX];    // Côté shell
+static unsigned long lancements = 0;
+static void (*preparer_enfant)(pid_t) = NULL;
+
+typedef union {
+    char octets[CMSG_SPACE(3 * sizeof(int))];
+    struct cmsghdr aligne;
+} Controle;
+
+
+// ================================================================================================
+// Processus de la réserve
+
+static void installer(int fd, int cible) {
+    if (fd != cible) {
+        if (dup2(fd, cible) == -1) {
+            perror("dup2");
+            _exit(127);
+        }
+        close(fd);
+    }
+}
+
+// Attend une commande sur s et l'exécute ; ne revient pas. Sans commande
+// (shell terminé ou réserve réduite), fin immédiate.
+static void attendre_commande(int s) {
+    static char tampon[TAILLE_MESSAGE];
+    Controle controle;
+
+    struct iovec iov = {.iov_base = tampon, .iov_len = sizeof(tampon)};
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = controle.octets, .msg_controllen = sizeof(controle.octets),
+    };
+    ssize_t n;
+    while ((n = recvmsg(s, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR) {
+    }
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    if (n < (ssize_t)sizeof(EnTete) || c == NULL || c->cmsg_type != SCM_RIGHTS
+        || c->cmsg_len != CMSG_LEN(3 * sizeof(int))) {
+        _exit(0);
+    }
+    int fds[3];
+    memcpy(fds, CMSG_DATA(c), sizeof(fds));
+
+    EnTete e;
+    memcpy(&e, tampon, sizeof(e));
+    if (e.nb_mots <= 0 || e.nb_variables < 0
+        || e.nb_mots + e.nb_variables > (int32_t)(TAILLE_MESSAGE / 2)) {
+        _exit(127);
+    }
+    char *chemin = tampon + sizeof(e);
+    char *fin = tampon + n;
+    // Mots puis variables, chaque liste terminée par NULL
+    char **mots = malloc((e.nb_mots + e.nb_variables + 2) * sizeof(char *));
+    char **variables = mots + e.nb_mots + 1;
+    char *p = memchr(chemin, '\0', fin - chemin);
+    if (mots == NULL || p == NULL) {
+        _exit(127);
+    }
+    for (int i = 0; i < e.nb_mots + e.nb_variables; i++) {
+        mots[i < e.nb_mots ? i : i + 1] = ++p;
+        p = memchr(p, '\0', fin - p);
+        if (p == NULL) {
+            _exit(127);
+        }
+    }
+    mots[e.nb_mots] = NULL;
+    variables[e.nb_variables] = NULL;
+    environ = variables;
+    for (int r = 0; r < RLIM_NLIMITS; r++) {
+        struct rlimit lim;
+        if (getrlimit(r, &lim) == 0 && (lim.rlim_cur != e.limites[r].rlim_cur
+                                        || lim.rlim_max != e.limites[r].rlim_max)) {
+            setrlimit(r, &e.limites[r]);
+        }
+    }
+
+    // Descripteurs reçus au-dessus de 2 : 0, 1 et 2 sont encore ouverts
+    installer(fds[0], STDIN_FILENO);
+    installer(fds[1], STDOUT_FILENO);
+    installer(fds[2], STDERR_FILENO);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    preparer_enfant(e.pgid);
+    if (chemin[0] != '\0') {
+        execve(chemin, mots, environ);
+    }
+    execvp(mots[0], mots);
+    perror(mots[0]);
+    _exit(127);
+}
+
+
+// ================================================================================================
+// Générateur
+
+// Un processus par octet reçu, envoyé au shell avec son pid
+static void generer(int s) {
+    char demande;
+    ssize_t n;
+
+    // Le Ctrl-C destiné au shell ne doit tuer ni le générateur ni la réserve
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    while ((n = recv(s, &demande, 1, 0)) != 0) {
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+            break;
+        }
+        pid_t pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, NULL, NULL, NULL, NULL);
+        if (pid == 0) {
+            close(s);
+            close(sv[0]);
+            attendre_commande(sv[1]);
+        }
+        close(sv[1]);
+        if (pid == -1) {
+            close(sv[0]);
+            break;
+        }
+        Controle controle;
+        memset(&controle, 0, sizeof(controle));
+        struct iovec iov = {.iov_base = &pid, .iov_len = sizeof(pid)};
+        struct msghdr msg = {
+            .msg_iov = &iov, .msg_iovlen = 1,
+            .msg_control = controle.octets, .msg_controllen = CMSG_SPACE(sizeof(int)),
+        };
+        struct cmsghdr *h = CMSG_FIRSTHDR(&msg);
+        h->cmsg_level = SOL_SOCKET;
+        h->cmsg_type = SCM_RIGHTS;
+        h->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(h), &sv[0], sizeof(int));
+        ssize_t envoye = sendmsg(s, &msg, MSG_NOSIGNAL);
+        close(sv[0]);
+        if (envoye == -1) {
+            break;
+        }
+    }
+    _exit(0);
+}
+
+static int creer_generateur(void) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) {
+        perror("socketpair");
+        return -1;
+    }
+    fflush(stdout); // Ne pas dupliquer le tampon de stdout
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(sv[0]);
+        generer(sv[1]);
+    }
+    close(sv[1]);
+    generateur = pid;
+    fd_generateur = sv[0];
+    return 0;
+}
+
+// Range les processus envoyés par le générateur ; attend le premier si
+// attendre est non nul. Au-delà de la taille voulue, ils sont congédiés.
+static void recevoir_processus(int attendre) {
+    while (demandes > 0) {
+        pid_t pid;
+        Controle controle;
+        struct iovec iov = {.iov_base = &pid, .iov_len = sizeof(pid)};
+        struct msghdr msg = {
+            .msg_iov = &iov, .msg_iovlen = 1,
+            .msg_control = controle.octets, .msg_controllen = sizeof(controle.octets),
+        };
+        ssize_t n = recvmsg(fd_generateur, &msg, MSG_CMSG_CLOEXEC | (attendre ? 0 : MSG_DONTWAIT));
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        struct cmsghdr *c = n == sizeof(pid) ? CMSG_FIRSTHDR(&msg) : NULL;
+        if (c == NULL || c->cmsg_type != SCM_RIGHTS) {
+            if (n != -1 || errno != EAGAIN) {
+                demandes = 0;   // Générateur disparu
+            }
+            return;
+        }
+        demandes--;
+        int s;
+        memcpy(&s, CMSG_DATA(c), sizeof(s));
+        if (nb_prets < voulus) {
+            pids[nb_prets] = pid;
+            sockets[nb_prets] = s;
+            nb_prets++;
+        } else {
+            close(s);
+        }
+        attendre = 0;
+    }
+}
+
+// Demande au générateur de quoi atteindre la taille voulue
+static int demander_processus(void) {
+    while (nb_prets + demandes < voulus) {
+        char demande = 1;
+        if (send(fd_generateur, &demande, 1, MSG_NOSIGNAL | MSG_DONTWAIT) != 1) {
+            return -1;
+        }
+        demandes++;
+    }
+    return 0;
+}
+
+
+// ================================================================================================
+// Côté shell
+
+int dimensionner_reserve(int n, void (*preparer)(pid_t pgid)) {
+    preparer_enfant = preparer;
+    voulus = n;
+    while (nb_prets > n) {
+        // Fin de fichier sur sa socket : le processus se termine
+        close(sockets[--nb_prets]);
+    }
+    if (n == 0) {
+        if (fd_generateur != -1) {
+            close(fd_generateur);   // Le générateur se termine de même
+            fd_generateur = -1;
+            generateur = -1;
+            demandes = 0;
+        }
+        return 0;
+    }
+    if (generateur == -1 && creer_generateur() == -1) {
+        voulus = 0;
+        return -1;
+    }
+    if (demander_processus() == -1) {
+        perror("pool");
+        return -1;
+    }
+    // Réserve complète avant la commande suivante
+    while (demandes > 0) {
+        recevoir_processus(1);
+    }
+    return 0;
+}
+
+int taille_reserve(void) {
+    return voulus;
+}
+
+pid_t lancer_reserve(const char *chemin, char **cmd, const int fds[3], pid_t pgid) {
+    static char tampon[TAILLE_MESSAGE];
+
+    EnTete e = {.pgid = pgid, .nb_mots = 0, .nb_variables = 0};
+    size_t n = sizeof(e);
+    const char *c = chemin ? chemin : "";
+    size_t lg = strlen(c) + 1;
+    if (n + lg > sizeof(tampon)) {
+        return -1;
+    }
+    memcpy(tampon + n, c, lg);
+    n += lg;
+    for (; cmd[e.nb_mots] != NULL; e.nb_mots++) {
+        lg = strlen(cmd[e.nb_mots]) + 1;
+        if (n + lg > sizeof(tampon)) {
+            return -1;
+        }
+        memcpy(tampon + n, cmd[e.nb_mots], lg);
+        n += lg;
+    }
+    for (; environ[e.nb_variables] != NULL; e.nb_variables++) {
+        lg = strlen(environ[e.nb_variables]) + 1;
+        if (n + lg > sizeof(tampon)) {
+            return -1;
+        }
+        memcpy(tampon + n, environ[e.nb_variables], lg);
+        n += lg;
+    }
+    for (int r = 0; r < RLIM_NLIMITS; r++) {
+        if (getrlimit(r, &e.limites[r]) == -1) {
+            return -1;
+        }
+    }
+    memcpy(tampon, &e, sizeof(e));
+
+    Controle controle;
+    memset(&controle, 0, sizeof(controle));
+    struct iovec iov = {.iov_base = tampon, .iov_len = n};
+    struct msghdr msg = {
+        .msg_iov = &iov, .msg_iovlen = 1,
+        .msg_control = controle.octets, .msg_controllen = sizeof(controle.octets),
+    };
+    struct cmsghdr *h = CMSG_FIRSTHDR(&msg);
+    h->cmsg_level = SOL_SOCKET;
+    h->cmsg_type = SCM_RIGHTS;
+    h->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(h), fds, 3 * sizeof(int));
+
+    // Sans processus prêt, pas d'attente : le lancement normal est plus rapide
+    recevoir_processus(0);
+    while (nb_prets > 0) {
+        nb_prets--;
+        int s = sockets[nb_prets];
+        ssize_t envoye;
+        while ((envoye = sendmsg(s, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR) {
+        }
+        close(s);
+        if (envoye == (ssize_t)n) {
+            lancements++;
+            return pids[nb_prets];
+        }
+        // Processus disparu (tué par un signal) : récupéré par wait4 comme
+        // tout fils inconnu, on essaie le suivant
+    }
+    return -1;
+}
+
+void completer_reserve(void) {
+    if (fd_generateur != -1) {
+        demander_processus();
+    }
+}
+
+int commande_pool(char **cmd, void (*preparer)(pid_t pgid)) {
+    if (cmd[1] == NULL) {
+        recevoir_processus(0);
+        printf("pool : %d processus prêts sur %d, %lu lancements\n", nb_prets, voulus, lancements);
+        return 0;
+    }
+    int n;
+    char *fin;
+    if (strcmp(cmd[1], "off") == 0) {
+        n = 0;
+    } else {
+        long v = strtol(cmd[1], &fin, 10);
+        if (fin == cmd[1] || *fin != '\0' || v < 0 || v > RESERVE_MAX) {
+            n = -1;
+        } else {
+            n = v;
+        }
+    }
+    if (n == -1 || cmd[2] != NULL) {
+        fprintf(stderr, "usage : pool [n | off] (n au plus %d)\n", RESERVE_MAX);
+        return 2;
+    }
+    return dimensionner_reserve(n, preparer) == -1 ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+/*****************************************************
+ * Ensishell : réserve de processus pré-créés        *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __RESERVE_H
+#define __RESERVE_H
+
+#include <sys/types.h>
+
+/* Processus créés à l'avance, chacun bloqué sur sa socket Unix. Pour lancer
+   une commande, le shell y envoie le chemin, les mots et le groupe de
+   processus, avec ses entrée, sortie et sortie d'erreur (SCM_RIGHTS) : le
+   processus les installe puis fait l'exec. La création est sortie du
+   lancement : elle est faite plus tard par un processus générateur.
+   L'environnement et les limites (ulimit) du shell sont envoyés avec chaque
+   commande ; seul le répertoire courant est celui de la création. */
+
+/* Porte la réserve à n processus (0 : la vide). preparer est appelée dans le
+   processus juste avant l'exec, avec le groupe demandé (voir preparer_enfant).
+   Renvoie -1 après un message si un processus n'a pas pu être créé. */
+int dimensionner_reserve(int n, void (*preparer)(pid_t pgid));
+
+/* Nombre de processus voulus dans la réserve (0 : réserve inutilisée) */
+int taille_reserve(void);
+
+/* Lance cmd (exécutable chemin, NULL : recherche dans le PATH) par un
+   processus de la réserve, avec fds[0..2] comme entrée, sorties standard et
+   d'erreur, dans le groupe pgid (0 : nouveau groupe, -1 : celui du shell).
+   Renvoie le pid ; -1 si aucun processus n'est disponible ou si la commande
+   ne tient pas dans un message : le lancement normal prend alors le relais. */
+pid_t lancer_reserve(const char *chemin, char **cmd, const int fds[3], pid_t pgid);
+
+/* Demande au générateur de remplacer les processus consommés, sans attendre */
+void completer_reserve(void);
+
+/* Commande interne "pool [n | off]", preparer comme pour dimensionner_reserve */
+int commande_pool(char **cmd, void (*preparer)(pid_t pgid));
+
+#endif
@@ -0,0 +1,278 @@
+/*****************************************************
+ * Ensishell : trace des commandes exécutées         *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#include "trace.h"
+
+// Anneau à un producteur (le shell) et un consommateur (le fil d'écriture) :
+// chacun n'écrit que son propre indice, aucun verrou. Les indices croissent
+// sans fin, la case est indice % TAILLE_ANNEAU.
+#define TAILLE_ANNEAU 1024
+#define PERIODE_MS 200          // Écriture au plus tard après ce délai
+#define TAILLE_TAMPON (1 << 16)
+
+static EnregistrementTrace anneau[TAILLE_ANNEAU];
+static atomic_ulong tete;       // Prochaine case à remplir (shell)
+static atomic_ulong queue;      // Prochaine case à écrire (fil d'écriture)
+static atomic_ulong perdus;     // Enregistrements perdus, anneau plein
+static atomic_int arret;
+
+int trace_active = 0;
+static int fd_trace = -1;
+static int binaire = 0;
+static int fd_reveil = -1;      // eventfd : anneau à moitié plein ou arrêt
+static pthread_t fil;
+static char *chemin_trace = NULL;
+
+
+// ================================================================================================
+// Producteur
+
+uint64_t empreinte_mots(char **mots, uint64_t h) {
+    for (int i = 0; mots[i] != NULL; i++) {
+        for (const unsigned char *c = (const unsigned char *)mots[i]; *c; c++) {
+            h = (h ^ *c) * 0x100000001b3ULL;
+        }
+        h = (h ^ 0) * 0x100000001b3ULL;   // Séparateur : "a b" ≠ "ab"
+    }
+    return h;
+}
+
+void publier_trace(const EnregistrementTrace *e) {
+    unsigned long t = atomic_load_explicit(&tete, memory_order_relaxed);
+    unsigned long q = atomic_load_explicit(&queue, memory_order_acquire);
+    if (t - q == TAILLE_ANNEAU) {
+        atomic_fetch_add_explicit(&perdus, 1, memory_order_relaxed);
+        return;
+    }
+    anneau[t % TAILLE_ANNEAU] = *e;
+    atomic_store_explicit(&tete, t + 1, memory_order_release);
+    // Réveil anticipé une seule fois par remplissage, le reste attend la période
+    if (t + 1 - q == TAILLE_ANNEAU / 2) {
+        uint64_t un = 1;
+        if (write(fd_reveil, &un, sizeof(un)) < 0) {
+            // Le fil se réveillera de toute façon à la fin de sa période
+        }
+    }
+}
+
+
+// ================================================================================================
+// Fil d'écriture
+
+static int ecrire_tout(const char *tampon, size_t n) {
+    while (n > 0) {
+        ssize_t e = write(fd_trace, tampon, n);
+        if (e == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        tampon += e;
+        n -= e;
+    }
+    return 0;
+}
+
+// Chaîne JSON : guillemets, barres obliques inverses et caractères de contrôle
+static size_t echapper(char *dst, const char *src, size_t max) {
+    size_t n = 0;
+    for (size_t i = 0; src[i] != '\0' && i < max; i++) {
+        unsigned char c = src[i];
+        if (c == '"' || c == '\\') {
+            dst[n++] = '\\';
+            dst[n++] = c;
+        } else if (c < 0x20) {
+            n += sprintf(dst + n, "\\u%04x", c);
+        } else {
+            dst[n++] = c;
+        }
+    }
+    dst[n] = '\0';
+    return n;
+}
+
+static int formater(char *dst, const EnregistrementTrace *e) {
+    char commande[6 * sizeof(e->commande) + 1];
+    echapper(commande, e->commande, sizeof(e->commande));
+    int n = sprintf(dst, "{\"empreinte\":\"%016llx\",\"commande\":\"%s\",\"debut_ns\":%lld,"
+                    "\"fin_ns\":%lld,\"pids\":[", (unsigned long long)e->empreinte, commande,
+                    (long long)e->debut_ns, (long long)e->fin_ns);
+    int nb = e->nb_etapes < TRACE_MAX_ETAPES ? e->nb_etapes : TRACE_MAX_ETAPES;
+    for (int i = 0; i < nb; i++) {
+        n += sprintf(dst + n, "%s%d", i ? "," : "", e->pids[i]);
+    }
+    n += sprintf(dst + n, "],\"etapes\":%d,\"statut\":%d,\"user_us\":%lld,\"sys_us\":%lld,"
+                 "\"maxrss_ko\":%lld,\"minflt\":%lld,\"majflt\":%lld,\"nvcsw\":%lld,"
+                 "\"nivcsw\":%lld,\"inblock\":%lld,\"oublock\":%lld,\"octets_entree\":%lld,"
+                 "\"octets_sortie\":%lld}\n", e->nb_etapes, e->statut,
+                 (long long)e->user_us, (long long)e->sys_us, (long long)e->maxrss_ko,
+                 (long long)e->minflt, (long long)e->majflt, (long long)e->nvcsw,
+                 (long long)e->nivcsw, (long long)e->inblock, (long long)e->oublock,
+                 (long long)e->octets_entree, (long long)e->octets_sortie);
+    return n;
+}
+
+// Écrit tout ce qui est dans l'anneau, par blocs de TAILLE_TAMPON
+static void vider_anneau(char *tampon) {
+    unsigned long q = atomic_load_explicit(&queue, memory_order_relaxed);
+    unsigned long t = atomic_load_explicit(&tete, memory_order_acquire);
+    size_t n = 0;
+    // Une ligne JSON tient largement dans 2 Ko
+    size_t marge = binaire ? sizeof(EnregistrementTrace) : 2048;
+
+    for (; q != t; q++) {
+        const EnregistrementTrace *e = &anneau[q % TAILLE_ANNEAU];
+        if (binaire) {
+            memcpy(tampon + n, e, sizeof(*e));
+            n += sizeof(*e);
+        } else {
+            n += formater(tampon + n, e);
+        }
+        // La case est rendue au shell une fois recopiée
+        atomic_store_explicit(&queue, q + 1, memory_order_release);
+        if (n + marge > TAILLE_TAMPON) {
+            ecrire_tout(tampon, n);
+            n = 0;
+        }
+    }
+    if (n > 0) {
+        ecrire_tout(tampon, n);
+    }
+}
+
+static void *ecrivain(void *arg) {
+    (void)arg;
+    char *tampon = malloc(TAILLE_TAMPON);
+    if (tampon == NULL) {
+        return NULL;
+    }
+    while (1) {
+        struct pollfd pfd = {.fd = fd_reveil, .events = POLLIN};
+        if (poll(&pfd, 1, PERIODE_MS) > 0) {
+            uint64_t valeur;
+            if (read(fd_reveil, &valeur, sizeof(valeur)) < 0) {
+                // Déjà vidé : rien à faire
+            }
+        }
+        // Arrêt lu avant de vider : ce qui précède la demande est écrit
+        int fin = atomic_load(&arret);
+        vider_anneau(tampon);
+        if (fin) {
+            break;
+        }
+    }
+    free(tampon);
+    return NULL;
+}
+
+
+// ================================================================================================
+// Ouverture et fermeture
+
+void fermer_trace(void) {
+    if (!trace_active) {
+        return;
+    }
+    trace_active = 0;
+    atomic_store(&arret, 1);
+    uint64_t un = 1;
+    if (write(fd_reveil, &un, sizeof(un)) < 0) {
+        // Le fil s'arrêtera à la fin de sa période
+    }
+    pthread_join(fil, NULL);
+    close(fd_reveil);
+    close(fd_trace);
+    fd_reveil = fd_trace = -1;
+    unsigned long p = atomic_exchange(&perdus, 0);
+    if (p > 0) {
+        fprintf(stderr, "trace: %lu enregistrements perdus (anneau plein)\n", p);
+    }
+}
+
+int ouvrir_trace(const char *chemin, int format_binaire) {
+    static int inscrit = 0;
+
+    fermer_trace();
+    char *copie = strdup(chemin);
+    int fd = open(chemin, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (copie == NULL || fd == -1) {
+        perror(chemin);
+        free(copie);
+        if (fd != -1) {
+            close(fd);
+        }
+        return -1;
+    }
+    fd_reveil = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd_reveil == -1) {
+        perror("eventfd");
+        close(fd);
+        free(copie);
+        return -1;
+    }
+    fd_trace = fd;
+    binaire = format_binaire;
+    if (binaire && lseek(fd, 0, SEEK_END) == 0) {
+        uint64_t taille = sizeof(EnregistrementTrace);
+        char entete[16] = "ENSITRC1";
+        memcpy(entete + 8, &taille, sizeof(taille));
+        ecrire_tout(entete, sizeof(entete));
+    }
+    atomic_store(&arret, 0);
+    atomic_store(&tete, 0);
+    atomic_store(&queue, 0);
+    if (pthread_create(&fil, NULL, ecrivain, NULL) != 0) {
+        fprintf(stderr, "trace: impossible de lancer le fil d'écriture\n");
+        close(fd_reveil);
+        close(fd_trace);
+        fd_reveil = fd_trace = -1;
+        free(copie);
+        return -1;
+    }
+    free(chemin_trace);
+    chemin_trace = copie;
+    trace_active = 1;
+    if (!inscrit) {
+        // Les derniers enregistrements sont écrits à la sortie du shell
+        atexit(fermer_trace);
+        inscrit = 1;
+    }
+    return 0;
+}
+
+int commande_trace(char **cmd) {
+    if (cmd[1] == NULL) {
+        if (trace_active) {
+            printf("trace : %s (%s), %lu perdus\n", chemin_trace, binaire ? "binaire" : "json",
+                   atomic_load(&perdus));
+        } else {
+            printf("trace : inactive\n");
+        }
+        return 0;
+    }
+    if (strcmp(cmd[1], "off") == 0 && cmd[2] == NULL) {
+        fermer_trace();
+        return 0;
+    }
+    int b = strcmp(cmd[1], "-b") == 0;
+    if (cmd[1 + b] == NULL || cmd[2 + b] != NULL) {
+        fprintf(stderr, "usage : trace [-b] fichier | trace off\n");
+        return 2;
+    }
+    return ouvrir_trace(cmd[1 + b], b) == -1 ? 1 : 0;
+}
@@ -0,0 +1,56 @@
+/*****************************************************
+ * Ensishell : trace des commandes exécutées         *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAX_ETAPES 8
+
+/* Un enregistrement par pipeline, de taille fixe : c'est aussi le format
+   binaire (trace -b), précédé une fois de l'en-tête "ENSITRC1" et de la
+   taille d'un enregistrement sur 8 octets. */
+typedef struct {
+    uint64_t empreinte;         /* FNV-1a des mots de toutes les étapes */
+    int64_t debut_ns;           /* CLOCK_REALTIME */
+    int64_t fin_ns;
+    int32_t pids[TRACE_MAX_ETAPES];
+    int32_t nb_etapes;          /* Étapes lancées (pids au-delà de TRACE_MAX_ETAPES omis) */
+    int32_t statut;             /* Code de retour façon shell */
+    int64_t user_us, sys_us;    /* Cumul des processus du pipeline */
+    int64_t maxrss_ko, minflt, majflt, nvcsw, nivcsw, inblock, oublock;
+    int64_t octets_entree;      /* Taille du fichier de '<', -1 sans redirection */
+    int64_t octets_sortie;      /* Taille du fichier de '>' à la fin, -1 sans */
+    char commande[32];          /* Premier mot, tronqué */
+} EnregistrementTrace;
+
+/* Non nul quand une trace est ouverte : seul test sur le chemin des
+   commandes quand elle ne l'est pas */
+extern int trace_active;
+
+/* Ouvre (en ajout) le fichier de trace, en JSON une ligne par commande ou
+   en binaire, et démarre le fil d'écriture. Une trace déjà ouverte est
+   d'abord fermée. Renvoie -1 après un message en cas d'échec. */
+int ouvrir_trace(const char *chemin, int binaire);
+
+/* Écrit les enregistrements en attente et ferme la trace */
+void fermer_trace(void);
+
+/* Empreinte FNV-1a des mots, à chaîner d'une étape à l'autre (départ :
+   EMPREINTE_INITIALE) */
+#define EMPREINTE_INITIALE 0xcbf29ce484222325ULL
+uint64_t empreinte_mots(char **mots, uint64_t h);
+
+/* Dépose un enregistrement dans l'anneau, sans appel système ni verrou ;
+   le fil d'écriture l'écrit plus tard. Anneau plein : l'enregistrement est
+   perdu et compté. */
+void publier_trace(const EnregistrementTrace *e);
+
+/* Commande interne "trace [-b] fichier | trace off | trace" */
+int commande_trace(char **cmd);
+
+#endif
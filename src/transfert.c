@@ -0,0 +1,427 @@
+/*****************************************************
+ * Ensishell : étapes de transfert (cat, tee)        *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#define _GNU_SOURCE // Pour splice, tee, copy_file_range et pipe2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "transfert.h"
+
+// Nombre maximal d'octets demandés au noyau par appel
+#define TAILLE_BLOC (1 << 20)
+
+// Code de retour d'une commande tuée par SIGPIPE
+#define STATUT_SIGPIPE (128 + SIGPIPE)
+
+
+// ================================================================================================
+// Copies de secours en espace utilisateur
+
+static int ecrire_tout(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Recopie src dans dst avec read/write, au plus max octets (-1 : jusqu'à la fin)
+static int copier_classique(int src, int dst, ssize_t max) {
+    static char tampon[1 << 16];
+
+    while (max != 0) {
+        size_t demande = sizeof(tampon);
+        if (max > 0 && (size_t)max < demande) {
+            demande = max;
+        }
+        ssize_t n = read(src, tampon, demande);
+        if (n == 0) {
+            return 0;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (ecrire_tout(dst, tampon, n) == -1) {
+            return -1;
+        }
+        if (max > 0) {
+            max -= n;
+        }
+    }
+    return 0;
+}
+
+
+// ================================================================================================
+// Copies dans le noyau. Chaque boucle renvoie 0 à la fin des données, -1 en cas
+// d'erreur, et 1 si l'appel système n'est pas utilisable pour ces descripteurs
+// (rien n'a alors été transféré, l'appelant passe à la méthode suivante).
+
+static int boucle_copy_file_range(int src, int dst) {
+    int premier = 1;
+    while (1) {
+        ssize_t n = copy_file_range(src, NULL, dst, NULL, TAILLE_BLOC, 0);
+        if (n == 0) {
+            return 0;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // EBADF : destination en O_APPEND, ou refusée par son système de fichiers
+            if (premier && (errno == EXDEV || errno == EINVAL || errno == ENOSYS
+                            || errno == EOPNOTSUPP || errno == EBADF)) {
+                return 1;
+            }
+            return -1;
+        }
+        premier = 0;
+    }
+}
+
+// Déplace exactement len octets du pipe p vers dst, en espace utilisateur si
+// dst refuse splice (terminal, socket...)
+static int vider_pipe(int p, int dst, size_t len) {
+    while (len > 0) {
+        ssize_t n = splice(p, NULL, dst, NULL, len, SPLICE_F_MOVE);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && errno == EINVAL) {
+            return copier_classique(p, dst, len);
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        len -= n;
+    }
+    return 0;
+}
+
+// src ou dst est un pipe : splice directement de l'un à l'autre
+static int boucle_splice(int src, int dst) {
+    int premier = 1;
+    while (1) {
+        ssize_t n = splice(src, NULL, dst, NULL, TAILLE_BLOC, SPLICE_F_MOVE);
+        if (n == 0) {
+            return 0;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (premier && errno == EINVAL) {
+                return 1;
+            }
+            return -1;
+        }
+        premier = 0;
+    }
+}
+
+// Aucun des deux n'est un pipe : splice en passant par un pipe intermédiaire
+static int boucle_splice_indirect(int src, int dst) {
+    int p[2];
+    int premier = 1;
+    int ret = 0;
+
+    if (pipe2(p, O_CLOEXEC) == -1) {
+        return 1;
+    }
+    fcntl(p[1], F_SETPIPE_SZ, TAILLE_BLOC); // Échec sans importance
+
+    while (1) {
+        ssize_t n = splice(src, NULL, p[1], NULL, TAILLE_BLOC, SPLICE_F_MOVE);
+        if (n == 0) {
+            break;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ret = (premier && errno == EINVAL) ? 1 : -1;
+            break;
+        }
+        premier = 0;
+        if (vider_pipe(p[0], dst, n) == -1) {
+            ret = -1;
+            break;
+        }
+    }
+    close(p[0]);
+    close(p[1]);
+    return ret;
+}
+
+int transferer(int src, int dst) {
+    struct stat st_src, st_dst;
+    int ret = 1;
+
+    if (fstat(src, &st_src) == -1 || fstat(dst, &st_dst) == -1) {
+        return -1;
+    }
+
+    if (S_ISREG(st_src.st_mode) && S_ISREG(st_dst.st_mode)) {
+        ret = boucle_copy_file_range(src, dst);
+    }
+    if (ret == 1 && (S_ISFIFO(st_src.st_mode) || S_ISFIFO(st_dst.st_mode))) {
+        ret = boucle_splice(src, dst);
+    } else if (ret == 1) {
+        ret = boucle_splice_indirect(src, dst);
+    }
+    if (ret == 1) {
+        ret = copier_classique(src, dst, -1);
+    }
+    return ret;
+}
+
+
+// ================================================================================================
+// Duplication façon tee : chaque bloc de src est placé dans un pipe P (un splice
+// entre deux pipes ne déplace que des références de pages), tee(2) le duplique
+// dans un pipe Q vidé dans chaque fichier, puis P est vidé dans dst.
+
+// Un fichier en erreur n'est plus alimenté, les autres destinations continuent
+static void abandonner_fichier(int *fd) {
+    perror("tee");
+    close(*fd);
+    *fd = -1;
+}
+
+static int transferer_tee_classique(int src, int dst, int *fichiers, int nb) {
+    static char tampon[1 << 16];
+    ssize_t n;
+
+    while ((n = read(src, tampon, sizeof(tampon))) != 0) {
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        for (int j = 0; j < nb; j++) {
+            if (fichiers[j] != -1 && ecrire_tout(fichiers[j], tampon, n) == -1) {
+                abandonner_fichier(&fichiers[j]);
+            }
+        }
+        if (ecrire_tout(dst, tampon, n) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int transferer_tee(int src, int dst, int *fichiers, int nb) {
+    int p[2], q[2];
+    int ret = 0;
+
+    if (nb == 0) {
+        return transferer(src, dst);
+    }
+    if (pipe2(p, O_CLOEXEC) == -1) {
+        return transferer_tee_classique(src, dst, fichiers, nb);
+    }
+    if (pipe2(q, O_CLOEXEC) == -1) {
+        close(p[0]);
+        close(p[1]);
+        return transferer_tee_classique(src, dst, fichiers, nb);
+    }
+    // Q a la même capacité que P : un seul tee suffit pour tout le bloc
+    int taille = fcntl(p[1], F_GETPIPE_SZ);
+    if (taille <= 0) {
+        taille = 1 << 16;
+    }
+
+    int premier = 1;
+    while (1) {
+        ssize_t n = splice(src, NULL, p[1], NULL, taille, SPLICE_F_MOVE);
+        if (n == 0) {
+            break;
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ret = (premier && errno == EINVAL) ? transferer_tee_classique(src, dst, fichiers, nb) : -1;
+            break;
+        }
+        premier = 0;
+
+        for (int j = 0; j < nb; j++) {
+            if (fichiers[j] == -1) {
+                continue;
+            }
+            ssize_t m = tee(p[0], q[1], n, 0);
+            if (m == n && vider_pipe(q[0], fichiers[j], n) == 0) {
+                continue;
+            }
+            abandonner_fichier(&fichiers[j]);
+            // Q peut contenir des restes de ce bloc : on le remplace
+            close(q[0]);
+            close(q[1]);
+            if (pipe2(q, O_CLOEXEC) == -1) {
+                q[0] = q[1] = -1;
+                ret = -1;
+                break;
+            }
+        }
+        if (ret == -1 || vider_pipe(p[0], dst, n) == -1) {
+            ret = -1;
+            break;
+        }
+    }
+
+    if (q[0] != -1) {
+        close(q[0]);
+        close(q[1]);
+    }
+    close(p[0]);
+    close(p[1]);
+    return ret;
+}
+
+
+// ================================================================================================
+// Reconnaissance et exécution des étapes de transfert
+
+// Vrai si aucun argument n'est une option : le comportement est alors
+// entièrement décrit par la liste des fichiers
+static int arguments_fichiers(char **cmd) {
+    for (int j = 1; cmd[j] != NULL; j++) {
+        if (cmd[j][0] == '-') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int chercher_etape_transfert(struct cmdline *l, char ***cmds, int n) {
+    for (int i = 0; i < n; i++) {
+        char **cmd = cmds[i];
+        if (cmd == NULL || cmd[0] == NULL || !arguments_fichiers(cmd)) {
+            continue;
+        }
+        // La première étape sans '<' lirait l'entrée du shell lui-même
+        int lit_shell = (i == 0 && l->in == NULL);
+        // Les messages d'erreur du shell ne suivent pas 2> ni 2>&1
+        if (i == l->errcmd && (l->errout != NULL || l->errdup)) {
+            continue;
+        }
+
+        if (strcmp(cmd[0], "cat") == 0 && !(cmd[1] == NULL && lit_shell)) {
+            return i;
+        }
+        if (strcmp(cmd[0], "tee") == 0 && !lit_shell) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int executer_etape_transfert(char **cmd, int input_fd, int output_fd) {
+    int entree = input_fd;
+    int sortie = output_fd;
+    int statut = 0;
+
+    if (sortie == -1) {
+        fflush(stdout);
+        sortie = STDOUT_FILENO;
+    }
+
+    // Si l'étape suivante se termine avant la fin (head), écrire donne EPIPE
+    // au lieu de tuer le shell avec SIGPIPE
+    struct sigaction ignorer, ancien;
+    memset(&ignorer, 0, sizeof(ignorer));
+    ignorer.sa_handler = SIG_IGN;
+    sigemptyset(&ignorer.sa_mask);
+    sigaction(SIGPIPE, &ignorer, &ancien);
+
+    if (strcmp(cmd[0], "cat") == 0 && cmd[1] == NULL) {
+        if (entree != -1 && transferer(entree, sortie) == -1) {
+            statut = (errno == EPIPE) ? STATUT_SIGPIPE : 1;
+            if (errno != EPIPE) {
+                perror("cat");
+            }
+        }
+    } else if (strcmp(cmd[0], "cat") == 0) {
+        for (int j = 1; cmd[j] != NULL; j++) {
+            int fd = open(cmd[j], O_RDONLY | O_CLOEXEC);
+            if (fd == -1) {
+                fprintf(stderr, "cat: %s: %s\n", cmd[j], strerror(errno));
+                statut = 1;
+                continue;
+            }
+            int ret = transferer(fd, sortie);
+            int err = errno;
+            close(fd);
+            if (ret == -1 && err == EPIPE) {
+                statut = STATUT_SIGPIPE;
+                break;
+            }
+            if (ret == -1) {
+                fprintf(stderr, "cat: %s: %s\n", cmd[j], strerror(err));
+                statut = 1;
+            }
+        }
+    } else {
+        int nb = 0;
+        while (cmd[nb + 1] != NULL) {
+            nb++;
+        }
+        int *fichiers = malloc((nb > 0 ? nb : 1) * sizeof(int));
+        if (fichiers == NULL) {
+            perror("malloc");
+            statut = 1;
+        } else {
+            for (int j = 0; j < nb; j++) {
+                fichiers[j] = open(cmd[j + 1], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (fichiers[j] == -1) {
+                    fprintf(stderr, "tee: %s: %s\n", cmd[j + 1], strerror(errno));
+                    statut = 1;
+                }
+            }
+            if (entree != -1 && transferer_tee(entree, sortie, fichiers, nb) == -1) {
+                statut = (errno == EPIPE) ? STATUT_SIGPIPE : 1;
+                if (errno != EPIPE) {
+                    perror("tee");
+                }
+            }
+            for (int j = 0; j < nb; j++) {
+                if (fichiers[j] != -1) {
+                    close(fichiers[j]);
+                }
+            }
+            free(fichiers);
+        }
+    }
+
+    sigaction(SIGPIPE, &ancien, NULL);
+
+    if (entree != -1) {
+        close(entree);
+    }
+    if (sortie != -1 && sortie != STDOUT_FILENO) {
+        close(sortie);
+    }
+    return statut;
+}
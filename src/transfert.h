@@ -0,0 +1,30 @@
+/*****************************************************
+ * Ensishell : étapes de transfert (cat, tee)        *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __TRANSFERT_H
+#define __TRANSFERT_H
+
+#include "readcmd.h"
+
+/* Cherche dans le pipeline l (n étapes, arguments déjà expansés dans cmds)
+   une étape qui ne fait que recopier des données : "cat fichiers..." ou
+   "tee fichiers...". Le shell peut alors assurer cette étape lui-même, sans
+   processus, en déplaçant les données dans le noyau.
+   Renvoie l'indice de l'étape, ou -1 s'il n'y en a pas. */
+int chercher_etape_transfert(struct cmdline *l, char ***cmds, int n);
+
+/* Exécute dans le shell l'étape cmd du pipeline (trouvée par la fonction
+   précédente). input_fd et output_fd sont son entrée et sa sortie : pipes
+   ou fichiers des redirections, -1 pour celles du shell. Les deux
+   descripteurs sont fermés au retour.
+   Renvoie le code de retour qu'aurait eu la commande. */
+int executer_etape_transfert(char **cmd, int input_fd, int output_fd);
+
+/* Recopie tout src dans dst avec copy_file_range ou splice quand c'est
+   possible, read/write sinon. Renvoie 0, ou -1 en cas d'erreur (errno). */
+int transferer(int src, int dst);
+
+#endif
@@ -0,0 +1,53 @@
+/*****************************************************
+ * Ensishell : variables du shell                    *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "variables.h"
+
+// Nom et valeur d'un seul bloc
+typedef struct Variable {
+    struct Variable *suivante;
+    const char *valeur;         // Après le nom
+    char nom[];
+} Variable;
+
+static Variable *variables = NULL;
+
+// Lien vers la variable nom, ou vers le NULL final si elle n'existe pas
+static Variable **lien_variable(const char *nom) {
+    Variable **lien = &variables;
+    while (*lien != NULL && strcmp((*lien)->nom, nom) != 0) {
+        lien = &(*lien)->suivante;
+    }
+    return lien;
+}
+
+int definir_variable(const char *nom, const char *valeur) {
+    Variable **lien = lien_variable(nom);
+    if (*lien == NULL && getenv(nom) != NULL) {
+        return setenv(nom, valeur, 1);
+    }
+    // Le nouveau bloc remplace l'ancien à sa place dans la liste
+    size_t ln = strlen(nom) + 1, lv = strlen(valeur) + 1;
+    Variable *v = malloc(sizeof(Variable) + ln + lv);
+    if (v == NULL) {
+        return -1;
+    }
+    memcpy(v->nom, nom, ln);
+    v->valeur = memcpy(v->nom + ln, valeur, lv);
+    Variable *ancienne = *lien;
+    v->suivante = ancienne ? ancienne->suivante : NULL;
+    *lien = v;
+    free(ancienne);
+    return 0;
+}
+
+const char *valeur_variable(const char *nom) {
+    const Variable *v = *lien_variable(nom);
+    return v ? v->valeur : getenv(nom);
+}
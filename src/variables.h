@@ -0,0 +1,21 @@
+/*****************************************************
+ * Ensishell : variables du shell                    *
+ * This code is distributed under the GLPv3 licence. *
+ * Ce code est distribué sous la licence GPLv3+.     *
+ *****************************************************/
+
+#ifndef __VARIABLES_H
+#define __VARIABLES_H
+
+/* Variables données par for : elles restent dans le shell, comme $?, et ne
+   sont pas transmises aux commandes. */
+
+/* Donne valeur à la variable nom. Une variable déjà exportée (HOME, PATH...)
+   est modifiée dans l'environnement. Renvoie -1 si la mémoire manque. */
+int definir_variable(const char *nom, const char *valeur);
+
+/* Valeur de la variable du shell nom, sinon de la variable d'environnement ;
+   NULL si aucune n'existe */
+const char *valeur_variable(const char *nom);
+
+#endif
@@ -19,3 +19,4 @@ require '../tests/testPrompt'
 require '../tests/testForkExec'
 require '../tests/testInOut'
 require '../tests/testJobs'
+require '../tests/testScript'
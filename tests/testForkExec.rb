@@ -49,6 +49,30 @@ class Test1ForkExec < Minitest::Test
     refute_nil(a, "Sortie incohérente pour 'seq 0 3'")
   end
 
+  def test_lanceur_fork
+    @pipe_write.puts("option lanceur fork")
+    @pipe_write.puts("seq 4 6 | wc -l")
+    a = @pty_read.expect(/^3\r\n/, DELAI)
+    refute_nil(a, "Sortie incohérente pour 'seq 4 6 | wc -l' avec le lanceur fork")
+  end
+
+  def test_hash
+    @pipe_write.puts("seq 7 7")
+    @pipe_write.puts("seq 8 8")
+    @pipe_write.puts("hash")
+    a = @pty_read.expect(/^ +2\t\/\S*\/seq\r\n/, DELAI)
+    refute_nil(a, "'hash' doit afficher seq avec 2 utilisations")
+    @pipe_write.puts("hash -r")
+    @pipe_write.puts("hash")
+    a = @pty_read.expect(/table vide/, DELAI)
+    refute_nil(a, "'hash -r' doit vider la table")
+    @pipe_write.puts("hash | cat")
+    @pipe_write.puts("echo fin")
+    a = @pty_read.expect(/^fin\r\n/, DELAI)
+    refute_nil(a, "'hash | cat' ne doit pas arrêter le shell")
+    refute_match(/succès|table vide/, a[0], "'hash' dans un pipeline ne doit pas écrire la table du shell")
+  end
+
   def test_all
     test_seq
     test_printf
@@ -63,6 +63,15 @@ class Test2InOut < Minitest::Test
       assert_equal(nbfichierpipe, nbfichier, "le nombre de fichier n'est pas le même suivant que la liste est passé dans votre pipe+redirection ou pas")
     end
 
+    def test_tee
+      @pipe_write.puts("seq 1 3 | tee totoExpect.txt | wc -l")
+      a = @pty_read.expect(/^3\r\n/, DELAI)
+      refute_nil(a, "sortie incohérente pour seq 1 3 | tee totoExpect.txt | wc -l")
+      @pipe_write.puts("cat totoExpect.txt totoExpect.txt | wc -l")
+      a = @pty_read.expect(/^6\r\n/, DELAI)
+      refute_nil(a, "tee n'a pas recopié les données dans totoExpect.txt")
+    end
+
     def test_parallelisme
       @pipe_write.puts("time -p sleep 3 | echo toto")
       a = @pty_read.expect(/^toto\r\n/, DELAI)
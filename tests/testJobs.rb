@@ -32,4 +32,72 @@ class Test3Jobs < Minitest::Test
     a = @pty_read.expect(/sleep/, DELAI)
     refute_nil(a, "jobs n'affiche pas le nom de la commande sleep")
   end
+
+  def test_numeros
+    @pipe_write.puts("sleep 10 &")
+    @pipe_write.puts("sleep 10 &")
+    @pipe_write.puts("jobs")
+    a = @pty_read.expect(/^\[1\] PID: \d+, Commande: sleep.*\r\n\[2\] PID: \d+, Commande: sleep/, DELAI)
+    refute_nil(a, "jobs n'affiche pas les numéros %1 et %2")
+  end
+  def test_terminaison_asynchrone
+    @pipe_write.puts("sleep 0.2 &")
+    a = @pty_read.expect(/\[1\] Processus \d+ terminé/, DELAI)
+    refute_nil(a, "la fin de la tâche n'est pas signalée sans nouvelle commande")
+  end
+  def test_bilan
+    @pipe_write.puts("sh -c 'exit 3' &")
+    a = @pty_read.expect(/terminé \(code 3\) user [\d.]+s sys [\d.]+s maxrss \d+ Ko durée [\d.]+s/, DELAI)
+    refute_nil(a, "le bilan de la tâche (code, temps CPU, mémoire, durée) n'est pas affiché")
+  end
+  def test_kill
+    @pipe_write.puts("sleep 10 | sleep 10 &")
+    @pipe_write.puts("kill %1")
+    a = @pty_read.expect(/\[1\] Processus \d+ terminé \(signal 15.*: sleep 10 \| sleep 10/, DELAI)
+    refute_nil(a, "kill %1 n'a pas terminé tout le pipeline")
+  end
+  def test_arret_reprise
+    @pipe_write.puts("sleep 0.5 &")
+    @pipe_write.puts("kill -STOP %1")
+    a = @pty_read.expect(/\[1\] Arrêté/, DELAI)
+    refute_nil(a, "l'arrêt de la tâche n'est pas signalé")
+    @pipe_write.puts("bg %1")
+    a = @pty_read.expect(/\[1\] Processus \d+ terminé \(code 0\)/, DELAI)
+    refute_nil(a, "la tâche n'a pas repris après bg")
+  end
+  def test_fg
+    @pipe_write.puts("sleep 0.3 &")
+    @pipe_write.puts("fg")
+    @pipe_write.puts("echo apres fg")
+    a = @pty_read.expect(/^sleep 0.3\r\n((?!terminé).)*apres fg/m, DELAI)
+    refute_nil(a, "fg n'a pas attendu la tâche au premier plan")
+  end
+  def test_history
+    fichier = "historiqueExpect.bin"
+    File.delete(fichier) if File.exist?(fichier)
+    # Première session : les commandes sont ajoutées au fichier
+    pid = spawn({"ENSISHELL_HISTORIQUE"=>fichier}, COMMANDESHELL, :in=>["/dev/null"], :out=>"/dev/null")
+    Process.wait(pid)
+    lecture, ecriture = IO.pipe
+    pid = spawn({"ENSISHELL_HISTORIQUE"=>fichier}, COMMANDESHELL, :in=>lecture, :out=>"/dev/null")
+    lecture.close
+    ecriture.puts("echo premiere")
+    ecriture.puts("echo seconde")
+    ecriture.close
+    Process.wait(pid)
+    # Seconde session : l'historique de la première est relu
+    @pipe_write.close
+    @pty_read.close
+    @pty_read, pty_write = PTY.open
+    @pipe_read, @pipe_write = IO.pipe
+    @pid = spawn({"ENSISHELL_HISTORIQUE"=>fichier}, COMMANDESHELL, :in=>@pipe_read, :out=>pty_write)
+    @pipe_read.close
+    pty_write.close
+    @pipe_write.puts("history -s premi")
+    @pipe_write.puts("history 2")
+    a = @pty_read.expect(/^ +1  echo premiere\r\n +3  history -s premi\r\n.* +3  history -s premi\r\n +4  history 2\r\n/m, DELAI)
+    refute_nil(a, "history ne retrouve pas les commandes de la session précédente")
+  ensure
+    File.delete(fichier) if File.exist?(fichier)
+  end
 end
@@ -0,0 +1,211 @@
+#!/usr/bin/ruby
+# -*- coding: utf-8 -*-
+
+# Copyright (C) 2013 Gregory Mounie
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or (at
+# your option) any later version.
+ 
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+ 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+require "minitest/autorun"
+require "open3"
+require "tempfile"
+require "tmpdir"
+
+require "../tests/testConstantes"
+
+class Test4Script < Minitest::Test
+  test_order=:defined
+
+  def test_commande
+    sortie, statut = Open3.capture2(COMMANDESHELL, "-c", "seq 1 2\necho toto | wc -c")
+    assert_equal("1\n2\n5\n", sortie, "Sortie incohérente pour -c")
+    assert_equal(0, statut.exitstatus)
+  end
+
+  def test_fichier
+    script = Tempfile.new("ensishell")
+    script.write("# commentaire\n\nprintf 'a%db\\n' 1\nsh -c 'exit 4'")
+    script.close
+    sortie, statut = Open3.capture2(COMMANDESHELL, script.path)
+    assert_equal("a1b\n", sortie, "Le script ne doit afficher que la sortie des commandes")
+    assert_equal(4, statut.exitstatus, "Code de retour de la dernière commande attendu")
+    script.unlink
+  end
+
+  def test_exit
+    sortie, statut = Open3.capture2(COMMANDESHELL, "-c", "echo a\nexit 3\necho b")
+    assert_equal("a\n", sortie)
+    assert_equal(3, statut.exitstatus)
+  end
+
+  def test_accolades
+    sortie, _ = Open3.capture2(COMMANDESHELL, "-c", "echo a{b,c{1..3}}d {08..10} {c..a} x{,y}")
+    assert_equal("abd ac1d ac2d ac3d 08 09 10 c b a x xy\n", sortie, "Expansion des accolades incohérente")
+  end
+
+  def test_decoupage
+    sortie = Tempfile.new("ensishell")
+    sortie.close
+    _, erreur, statut = Open3.capture3(COMMANDESHELL, "-c", "/usr/bin/printf '%s\\n' {1..300000} > #{sortie.path}")
+    assert_match(/trop longue/, erreur)
+    assert_equal(126, statut.exitstatus)
+    _, statut = Open3.capture2(COMMANDESHELL, "-c", "option decoupage on\n/usr/bin/printf '%s\\n' {1..300000} > #{sortie.path}")
+    assert_equal(0, statut.exitstatus)
+    assert_equal((1..300000).map(&:to_s), File.read(sortie.path).split("\n"), "Lots incomplets ou dans le désordre")
+    sortie.unlink
+  end
+
+  def test_parallel
+    sortie, erreur, statut = Open3.capture3(COMMANDESHELL, "-c", "parallel -j 2 sh -c 'echo x{}; exit {}' ::: 0 1 0")
+    assert_equal(["x0", "x0", "x1"], sortie.split.sort)
+    assert_match(/3 tâches, 1 en échec/, erreur.force_encoding("UTF-8"))
+    assert_equal(1, statut.exitstatus)
+  end
+
+  def test_jokers
+    Dir.mktmpdir do |rep|
+      Dir.mkdir(File.join(rep, "d1"))
+      ["a.c", "b.c", "c.h", ".cache", "d1/e.c"].each { |f| File.write(File.join(rep, f), "") }
+      sortie, _ = Open3.capture2(File.expand_path(COMMANDESHELL), "-c",
+                                 "echo *.c *.h\necho */*.c d*/\necho *.z\necho **/*.c", :chdir=>rep)
+      assert_equal("a.c b.c c.h\nd1/e.c d1/\n*.z\na.c b.c d1/e.c\n", sortie, "Expansion des jokers incohérente")
+    end
+  end
+
+  def test_limites
+    debut = Time.now
+    _, statut = Open3.capture2(COMMANDESHELL, "-c", "timeout 0.3 sleep 5")
+    assert_equal(124, statut.exitstatus, "Code 124 attendu à l'échéance")
+    assert_operator(Time.now - debut, :<, 2, "timeout n'a pas interrompu la commande")
+    debut = Time.now
+    _, statut = Open3.capture2(COMMANDESHELL, "-c", "timeout 0.3 cat /dev/zero > /dev/null")
+    assert_equal(124, statut.exitstatus, "timeout ignoré pour une étape recopiée par le shell")
+    assert_operator(Time.now - debut, :<, 2)
+    _, statut = Open3.capture2(COMMANDESHELL, "-c", "limit cpu=1 sh -c 'while :; do :; done'")
+    assert_equal(128 + 24, statut.exitstatus, "SIGXCPU attendu")
+    sortie, _ = Open3.capture2(COMMANDESHELL, "-c", "ulimit -n 64\nsh -c 'ulimit -n'\nlimit nofile=32 sh -c 'ulimit -n'")
+    assert_equal("64\n32\n", sortie, "Limites non transmises aux commandes")
+    _, erreur, statut = Open3.capture3(COMMANDESHELL, "-c", "limit foo=1 true")
+    assert_match(/limite invalide/, erreur)
+    assert_equal(2, statut.exitstatus)
+  end
+
+  def test_time
+    sortie, erreur, statut = Open3.capture3(COMMANDESHELL, "-c", "time -j sh -c 'echo x; exit 3'\ntime -p true")
+    assert_equal("x\n", sortie, "time ne doit écrire que sur la sortie d'erreur")
+    assert_match(/^\{"reel":[\d.]+,"user":[\d.]+,"sys":[\d.]+,"maxrss_ko":\d+,.*"code":3,"phases_us":\{"analyse":[\d.]+,"expansion":[\d.]+,"pipes":[\d.]+,"lancement":[\d.]+,"exec":[\d.]+,"attente":[\d.]+\}\}$/, erreur)
+    assert_match(/^real [\d.]+\nuser [\d.]+\nsys [\d.]+$/, erreur)
+    assert_equal(0, statut.exitstatus)
+  end
+
+  def test_trace
+    Dir.mktmpdir do |rep|
+      trace = File.join(rep, "trace.jsonl")
+      sortie, statut = Open3.capture2({"ENSISHELL_TRACE"=>trace}, COMMANDESHELL, "-c",
+                                      "/bin/echo abc > #{rep}/f\nsh -c 'exit 3' | cat\ntrace off\ntrue")
+      assert_equal("", sortie)
+      assert_equal(0, statut.exitstatus)
+      lignes = File.readlines(trace)
+      assert_equal(2, lignes.size, "Un enregistrement par commande tracée attendu")
+      assert_match(/"commande":"\/bin\/echo".*"pids":\[\d+\],"etapes":1,"statut":0,.*"octets_sortie":4\}/, lignes[0])
+      assert_match(/"commande":"sh".*"statut":0,"user_us":\d+/, lignes[1])
+    end
+  end
+
+  def test_pool
+    Dir.mktmpdir do |rep|
+      sortie, erreur, statut = Open3.capture3(COMMANDESHELL, "-c",
+                                              "pool 2\n/bin/echo abc | tr a-c A-C > #{rep}/f\nsort < #{rep}/f\n" +
+                                              "introuvable\nsh -c 'exit 5'\npool\npool off")
+      # Les remplaçants sont créés sans attendre : le nombre de prêts peut varier
+      assert_match(/\AABC\npool : [0-2] processus prêts sur 2, 5 lancements\n\z/, sortie)
+      assert_match(/introuvable/, erreur)
+      assert_equal(0, statut.exitstatus)
+      sortie, statut = Open3.capture2(COMMANDESHELL, "-c", "pool 1\nsh -c 'exit 5'")
+      assert_equal(5, statut.exitstatus, "Code de retour perdu par la réserve")
+      sortie, _ = Open3.capture2(COMMANDESHELL, "-c",
+                                 "pool 2\nfor HOME in a b; do printenv HOME; done\nfor HOME in c d; do printenv HOME; done\n" +
+                                 "ulimit -n 77\nsh -c 'ulimit -n'\npool")
+      assert_match(/\Aa\nb\nc\nd\n77\npool : .*, 5 lancements\n\z/, sortie,
+                   "Environnement ou limites figés par la réserve")
+    end
+  end
+
+  def test_internes
+    Dir.mktmpdir do |rep|
+      sortie, statut = Open3.capture2(COMMANDESHELL, "-c",
+                                      "echo -n a\necho -e 'b\\tc'\nprintf '%s=%03d\\n' x 7 y 42\n" +
+                                      "cd #{rep}\npwd\necho abc > f\ncat f\necho x | tr x y\nfalse")
+      assert_equal("ab\tc\nx=007\ny=042\n#{File.realpath(rep)}\nabc\ny\n", sortie)
+      assert_equal(1, statut.exitstatus)
+    end
+    { "test 3 -lt 10 -a ! -d /etc/passwd" => 0, "[ a = b ]" => 1, "[ -n ]" => 0,
+      "test ! \\( a -o '' \\)" => 1, "[ 1 -eq z ]" => 2, "[ a" => 2 }.each do |cmd, code|
+      _, _, statut = Open3.capture3(COMMANDESHELL, "-c", cmd)
+      assert_equal(code, statut.exitstatus, cmd)
+    end
+  end
+
+  def test_controle
+    script = "echo a; false && echo non || echo oui\n" +
+             "for x in 1 2 3 4; do\n  if [ $x = 2 ]; then continue; elif [ $x = 4 ]; then break; fi\n" +
+             "  echo x$x\ndone\nif false; then echo non; fi; echo $?\n" +
+             "until test -n \"$HOME\"; do echo non; done; until false; do echo tour; break; done\n" +
+             "while false; do :; done\n"
+    sortie, statut = Open3.capture2(COMMANDESHELL, "-c", script)
+    assert_equal("a\noui\nx1\nx3\n0\ntour\n", sortie)
+    assert_equal(0, statut.exitstatus)
+    sortie, _ = Open3.capture2(COMMANDESHELL, "-c",
+                               "for x in 1 '$x'; do echo $x '$x' \\$x \"$x\"; printenv x; done; echo \"$x\"")
+    assert_equal("1 $x $x 1\n$x $x $x $x\n$x\n", sortie, "'...' et \\$ ne sont pas développés")
+    _, erreur, statut = Open3.capture3(COMMANDESHELL, "-c", "if true; then echo a; fi fi")
+    assert_match(/fi/, erreur)
+    assert_equal(2, statut.exitstatus)
+  end
+
+  def test_redirections
+    Dir.mktmpdir do |rep|
+      sortie, erreur, statut = Open3.capture3(COMMANDESHELL, "-c",
+                                              "echo a > #{rep}/f\necho b >> #{rep}/f\n" +
+                                              "sh -c 'echo o; echo e >&2' 2> #{rep}/e\n" +
+                                              "sh -c 'echo o; echo e >&2' &> #{rep}/t\n" +
+                                              "sh -c 'echo x >&2' 2>&1 | tr x y")
+      assert_equal("o\ny\n", sortie)
+      assert_equal("", erreur)
+      assert_equal(0, statut.exitstatus)
+      assert_equal("a\nb\n", File.read("#{rep}/f"))
+      assert_equal("e\n", File.read("#{rep}/e"))
+      assert_equal("o\ne\n", File.read("#{rep}/t"))
+      sortie, erreur, _ = Open3.capture3(COMMANDESHELL, "-c",
+                                         "sh -c 'echo o; echo e >&2' 2>&1 > #{rep}/o\n" +
+                                         "sh -c 'echo o; echo e >&2' > #{rep}/p 2>&1")
+      assert_equal("e\n", sortie, "2>&1 avant > : la sortie d'erreur suit l'ancienne sortie")
+      assert_equal("", erreur)
+      assert_equal("o\n", File.read("#{rep}/o"))
+      assert_equal("o\ne\n", File.read("#{rep}/p"))
+    end
+  end
+
+  def test_atomique
+    Dir.mktmpdir do |rep|
+      File.write("#{rep}/f", "ancien\n")
+      sortie, erreur, statut = Open3.capture3(COMMANDESHELL, "-c",
+                                              "option atomique on\nsh -c 'echo rate; exit 3' > #{rep}/f\n" +
+                                              "cat #{rep}/f\nseq 3 > #{rep}/f")
+      assert_equal("ancien\n", sortie, "Une commande en échec ne doit pas remplacer le fichier")
+      assert_match(/non remplacé \(code de retour 3\)/, erreur)
+      assert_equal(0, statut.exitstatus)
+      assert_equal("1\n2\n3\n", File.read("#{rep}/f"))
+      assert_equal(["f"], Dir.children(rep), "Fichier temporaire laissé")
+    end
+  end
+end